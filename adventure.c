@@ -34,20 +34,27 @@
  *	SL	3	Wed Sep 14 20:57:22 2011
  *		Cleaned up code for distribution.
  */
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "assert.h"
 #include "input.h"
 #include "modex.h"
 #include "photo.h"
+#include "prefetch.h"
 #include "text.h"
+#include "tick.h"
+#include "timer.h"
+#include "words.h"
 #include "world.h"
 
 
@@ -64,8 +71,22 @@ static int sanity_check (void);
 
 /* a few constants */
 #define TICK_USEC      50000 /* tick length in microseconds          */
+#define TICK_FAST_USEC 16667 /* tick length while scrolling (60 Hz)  */
+#define TICK_IDLE_USEC 100000 /* tick length while idle              */
+#define FAST_HOLD_USEC 250000 /* fast ticks continue after motion    */
+#define IDLE_WAIT_USEC 1000000 /* idle after no activity this long   */
+#define FADE_STEP_USEC 50000 /* time between palette fade steps      */
+#define TUX_QUEUE_LEN  16    /* Tux command queue size (power of 2)  */
 #define STATUS_MSG_LEN 40    /* maximum length of status message     */
+#define STATUS_MSG_USEC 1500000 /* time for which a message is shown  */
 #define MOTION_SPEED   2     /* pixels moved per command             */
+#define USE_ROOM_FADE  0     /* fade in photo colors on room entry   */
+#define MARGIN_SPARE_USEC 2000 /* idle time kept free before a tick  */
+#define LOAD_PHOTOS_LATER 1  /* show first room before loading rest  */
+#define SAVE_ON_ENTER  0     /* save the game whenever a room is entered */
+
+/* sources of events for the event loop */
+enum {EV_KEYBOARD, EV_TUX, EV_TICK, N_EVENT_SRCS};
 
 /* outcome of the game */
 typedef enum {GAME_WON, GAME_QUIT} game_condition_t;
@@ -97,6 +118,8 @@ typedef enum { /* TC = typed command */
     TC_GO,
     TC_INSTALL,
     TC_INVENTORY,
+    TC_RESTORE,
+    TC_SAVE,
     TC_SIGH,
     TC_USE,
     TC_WEAR,
@@ -123,6 +146,8 @@ static const typed_cmd_t cmd_list[] = {
     {"grab",      2, TC_GET},
     {"install",   3, TC_INSTALL},
     {"inventory", 1, TC_INVENTORY},
+    {"restore",   7, TC_RESTORE},
+    {"save",      4, TC_SAVE},
     {"sigh",      4, TC_SIGH},
     {"use",       3, TC_USE},
     {"wear",      4, TC_WEAR},
@@ -131,88 +156,135 @@ static const typed_cmd_t cmd_list[] = {
 
 
 /* local functions--see function headers for details */
-static void cancel_tux_thread (void* ignore);
-
-static void cancel_status_thread (void* ignore);
+static void clear_status (void* ignore);
 static game_condition_t game_loop (void);
+static int32_t handle_command (cmd_t cmd);
+static int32_t handle_keyboard (int64_t* last_motion, int64_t* last_active);
 static int32_t handle_typing (void);
+static int32_t add_typed_verbs (void);
+static const char* typed_with_hint (void);
+static int32_t is_motion_command (cmd_t cmd);
 static void init_game (void);
+static int32_t save_checkpoint (void);
+static tc_action_t restore_checkpoint (void);
 static void move_photo_down (void);
 static void move_photo_left (void);
 static void move_photo_right (void);
 static void move_photo_up (void);
 static void redraw_room (void);
-static void* status_thread (void* ignore);
-
+static void scroll_view (cmd_t cmd);
+static void show_view_move (void);
+static void show_tux_clock (void* ignore);
+static void step_fade (void* ignore);
+#if (USE_ROOM_FADE == 1)
+static void fade_out_room (void);
+#endif
+static void draw_margin (void);
+static int64_t usec_since_start (void);
+static int32_t handle_tux (int64_t* last_motion, int64_t* last_active);
+static int32_t start_tux_thread (void);
+static void cancel_tux_thread (void* ignore);
 static void* t_thread (void* ignore);
-static int time_is_after (struct timeval* t1, struct timeval* t2);
+static int32_t tux_queue_push (cmd_t cmd);
+static int32_t tux_queue_pop (cmd_t* cmd);
+
+static int32_t watch_fd (int epoll_fd, int fd, uint32_t id);
 
 /* file-scope variables */
 
 static game_info_t game_info; /* game information */
 
-unsigned int b_pressed;
-static cmd_t button;
 static int32_t enter_room;      /* player has changed rooms        */
- //sus need to do it in game loop before og switch
-/* 
- * The variables below are used to keep track of the status message helper
- * thread, with Posix thread id recorded in status_thread_id.  
- *
- * The status_msg records the current status message: when the
- * string recorded there is empty, no status message need be displayed, and
- * the status bar should instead reflect the name of the current room and the
- * player's typing (for typed commands).
- *
- * The status_msg is protected by the msg_lock mutex, which should be
- * acquired before reading or writing the message.  Further, if the message
- * is changed, the helper thread must be notified by signaling it with the 
- * condition variable msg_cv (while holding the msg_lock).
- */
-static pthread_t status_thread_id;
-static pthread_mutex_t msg_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  msg_cv = PTHREAD_COND_INITIALIZER;
-static char status_msg[STATUS_MSG_LEN + 1] = {'\0'};
+static int32_t keep_view;       /* keep view window on entry       */
 
-static pthread_t tux_thread_id;
-static pthread_mutex_t tux_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  tux_cv = PTHREAD_COND_INITIALIZER;
+/* 
+ * The side of the view window toward which the view last scrolled.  The 
+ * margin beyond that side is drawn in time left over before each tick.
+ */
+static int32_t margin_dir;
 
 /* 
- * cancel_status_thread
- *   DESCRIPTION: Terminates the status message helper thread.  Used as
- *                a cleanup method to ensure proper shutdown.
- *   INPUTS: none (ignored)
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ * Counts of passes through the event loop on which the screen was shown,
+ * and of those on which nothing had changed, so that showing the screen 
+ * was skipped.
+ */
+static uint32_t frames_shown;
+static uint32_t frames_elided;
 
- 
+/* 
+ * Counts of scrolling commands, and of the moves of the view window that
+ * showed them: a run of keystrokes scrolling along the same axis that 
+ * arrive together is shown with one move.
  */
+static uint32_t scroll_cmds;
+static uint32_t scroll_moves;
 
+/* 
+ * The count of keyboard bytes read as of the start of the last tick, and
+ * the most read during any one tick.
+ */
+static uint32_t key_bytes_seen;
+static uint32_t key_bytes_max;
 
-static void
-cancel_status_thread (void* ignore)
-{
-    (void)pthread_cancel (status_thread_id);
-}
+/* 
+ * Time spent by the event loop handling events and drawing into the build
+ * buffer (the logic stage, which precedes composing and presenting each
+ * frame), and the number of passes over which it was measured.
+ */
+static uint64_t logic_usec;
+static uint32_t logic_passes;
 
-/*
- * cancel_tux_thread
- *   DESCRIPTION: Cancel the Tux Controller thread by calling pthread_cancel.
- *   INPUTS:
- *     ignore - A pointer to the ignored data 
- *   OUTPUTS: None
- *   RETURN VALUE: None
- *   SIDE EFFECTS: Cancels the Tux Controller thread.
+/* 
+ * The time at which the program started, and the time from then until the
+ * first frame was shown (-1 until it has been shown).
+ */
+static struct timespec program_start;
+static int64_t first_frame_usec = -1;
+ //sus need to do it in game loop before og switch
+/* 
+ * The status_msg records the current status message: when the
+ * string recorded there is empty, no status message need be displayed, and
+ * the status bar should instead reflect the name of the current room and the
+ * player's typing (for typed commands).  The status_timer clears the 
+ * message STATUS_MSG_USEC after it is posted.  Only the game loop thread
+ * reads or writes the message, so it needs no lock.
  */
+static char status_msg[STATUS_MSG_LEN + 1] = {'\0'};
+static game_timer_t status_timer;
 
-static void
-cancel_tux_thread (void* ignore)
-{
-    (void)pthread_cancel (tux_thread_id);
-}
+/* 
+ * The Tux controller thread (tux_thread_id) waits for the controller's
+ * buttons to change, reads them, and passes the resulting command to the
+ * game loop through the queue below, so that only the game loop ever
+ * changes the game state or draws.  The queue is a ring with one producer
+ * (the Tux thread), which alone writes tux_head, and one consumer (the
+ * game loop), which alone writes tux_tail; the head and tail count 
+ * commands pushed and popped, and need no lock.  After pushing, the 
+ * thread wakes the game loop through an eventfd (tux_event_fd, -1 when
+ * the controller is not in use).  If the queue is full, the command is 
+ * dropped and counted in tux_dropped.
+ *
+ * The controller reports only changes to its buttons, so the game loop 
+ * records the direction button held down (tux_held) and repeats its 
+ * motion once every TICK_USEC (tux_repeated is the time of the last
+ * motion), however fast the ticks run while the photo scrolls.
+ */
+static pthread_t tux_thread_id;
+static int       tux_event_fd = -1;
+static cmd_t     tux_queue[TUX_QUEUE_LEN];
+static uint32_t  tux_head;
+static uint32_t  tux_tail;
+static uint32_t  tux_dropped;
+static cmd_t     tux_held = CMD_NONE;
+static int64_t   tux_repeated;
 
+/* 
+ * Timers for other timed effects: clock_timer updates the elapsed time 
+ * on the Tux controller at the start of each second, and fade_timer steps
+ * the room photo colors through a fade-in after the player enters a room.
+ */
+static game_timer_t clock_timer;
+static game_timer_t fade_timer;
 
 
 /* 
@@ -231,23 +303,68 @@ game_loop ()
      * initialization below for explanations of purpose.
      */
  
-    struct timeval start_time, tick_time;
-
-    struct timeval cur_time; /* current time (during tick)      */
     cmd_t cmd;               /* command issued by input control */
+    int64_t now;             /* usec elapsed (during event)     */
+    int64_t woke;            /* time at which events arrived    */
+    int64_t last_motion;     /* time of last scrolling command  */
+    int64_t last_active;     /* time of last screen change, etc */
+    int32_t period;          /* length of the next tick         */
+    int32_t started;         /* did a tick start?               */
+    int epoll_fd;            /* descriptor for waiting on events */
+    struct epoll_event ev[N_EVENT_SRCS]; /* events ready to handle */
+    int32_t n_ev;            /* number of events ready          */
+    int32_t idx;             /* index over ready events         */
+    int32_t keys;            /* keyboard input arrived?         */
+    uint64_t tux_events;     /* count read from Tux eventfd     */
+    input_stats_t in_stats;  /* keyboard bytes read so far      */
+    const prefetch_frame_t* frame; /* room drawn ahead of time  */
 
-    /* Record the starting time--assume success. */
-    (void)gettimeofday (&start_time, NULL);
+    /* 
+     * Start the tick clock; the first event loop tick occurs one tick 
+     * length from now.
+     */
+    if (0 != tick_start (TICK_USEC)) {
+	PANIC ("cannot start tick timer");
+    }
 
-    /* Calculate the time at which the first event loop tick should occur. */
-    tick_time = start_time;
-    if ((tick_time.tv_usec += TICK_USEC) > 1000000) {
-	tick_time.tv_sec++;
-	tick_time.tv_usec -= 1000000;
+    /* 
+     * Everything that the event loop reacts to arrives through a file
+     * descriptor: keystrokes, Tux controller commands (queued by the Tux
+     * thread), and the start of each tick (which runs timed events).  We
+     * wait for any of them at once, and handle input as soon as it 
+     * arrives rather than at the next tick.
+     */
+    if (0 > (epoll_fd = epoll_create1 (EPOLL_CLOEXEC)) ||
+	0 != watch_fd (epoll_fd, get_keyboard_fd (), EV_KEYBOARD) ||
+	0 != watch_fd (epoll_fd, tick_get_fd (), EV_TICK) ||
+	(0 <= tux_event_fd && 
+	 0 != watch_fd (epoll_fd, tux_event_fd, EV_TUX))) {
+	PANIC ("cannot set up event polling");
     }
 
     /* The player has just entered the first room. */
     enter_room = 1;
+    woke = tick_elapsed_usec ();
+
+    /* 
+     * Set up timed events, which the timer wheel runs on each tick.  The
+     * Tux clock is shown now, and then at the start of each second.
+     */
+    timer_setup (&status_timer, clear_status, NULL);
+    timer_setup (&fade_timer, step_fade, NULL);
+    timer_setup (&clock_timer, show_tux_clock, NULL);
+    show_tux_clock (NULL);
+
+    /* 
+     * The tick length adapts to what the player is doing: ticks are fast
+     * while the photo is scrolling (and for a short time afterward, to
+     * ride over gaps between key repeats), normal while anything else is
+     * happening, and slow once nothing has happened for a while.  All
+     * timing of asynchronous events uses elapsed time rather than tick
+     * counts, so it is unaffected by the tick length.
+     */
+    last_motion = -FAST_HOLD_USEC;
+    last_active = 0;
 
     /* The main event loop. */
     while (1) {
@@ -259,117 +376,214 @@ game_loop ()
 	 */
 	
 	if (enter_room) {
-	    /* Reset the view window to (0,0). */
-	    game_info.map_x = game_info.map_y = 0;
+	    /* 
+	     * Reset the view window to (0,0), unless a restored game put 
+	     * it elsewhere.
+	     */
+	    if (!keep_view) {
+		game_info.map_x = game_info.map_y = 0;
+	    }
+	    keep_view = 0;
 	    set_view_window (game_info.map_x, game_info.map_y);
 
+#if (SAVE_ON_ENTER == 1)
+	    /* Checkpoint the game; a failure is noticed at the next save. */
+	    (void)save_checkpoint ();
+#endif
+
 	    /* Discard any partially-typed command. */
 	    reset_typed_command ();
+
+#if (USE_ROOM_FADE == 1)
+	    /* 
+	     * Fade the old photo colors out to black.  The new room's colors
+	     * are then installed at the same (black) step of their fade 
+	     * ramp, which costs no further palette writes, and fade in over 
+	     * the next few ticks.  Each step rewrites most of the photo
+	     * colors, so the fade is off by default; without it, only the
+	     * colors that differ from the old room's are written.
+	     */
+	    fade_out_room ();
+	    timer_schedule (&fade_timer, FADE_STEP_USEC);
+#endif
 	    
-	    /* Adjust colors and photo drawing for the current room photo. */
-	    prep_room (game_info.where);
+	    /* 
+	     * Adjust colors and photo drawing for the current room photo,
+	     * and draw the room.  If the room was drawn ahead of time in 
+	     * the background, its image and palette are simply copied.
+	     */
+	    if (NULL != (frame = prefetch_claim (game_info.where))) {
+		prep_room_ramp (game_info.where, frame->ramp);
+		draw_full_image (frame->img);
+	    } else {
+		prep_room (game_info.where);
+		redraw_room ();
+	    }
+
+	    /* Start drawing the rooms that the player may enter next. */
+	    prefetch_neighbours (game_info.where);
 
-	    /* Draw the room (calls show. */
-	    redraw_room ();
+	    /* The view can only scroll down or right from (0,0). */
+	    margin_dir = MARGIN_DOWN;
 
 		
 	    /* Only draw once on entry. */
 	    enter_room = 0;
 	}
 
-	show_screen ();
+	now = tick_elapsed_usec ();
+	logic_usec += now - woke;
+	logic_passes++;
 
-	display_time_on_tux(cur_time.tv_sec -  start_time.tv_sec); // calculating the time difference between two time values and display it on the tux 
-
-	(void)pthread_mutex_lock (&msg_lock);
-		show_status_bar(status_msg, room_name(game_info.where) , get_typed_command()); // calling show_status_bar to display the status bar, room info and status message.
-	(void)pthread_mutex_unlock (&msg_lock);
-	
-	
-
-	/*
-	 * Wait for tick.  The tick defines the basic timing of our
-	 * event loop, and is the minimum amount of time between events.
+	/* 
+	 * Show the status bar and the screen.  Each is drawn only if it
+	 * changed since it was last shown, so events that change nothing
+	 * cost almost nothing.  Showing the screen hands the frame to the
+	 * present thread, so we need not wait for it to reach the monitor.
 	 */
-	do {
-	    if (gettimeofday (&cur_time, NULL) != 0) {
-		/* Panic!  (should never happen) */
-		clear_mode_X ();
-		shutdown_input ();
-		perror ("gettimeofday");
-		exit (3);
+	if (show_status_bar(status_msg, room_name(game_info.where) , typed_with_hint())) { // calling show_status_bar to display the status bar, room info and status message.
+	    last_active = now;
+	}
+
+	if (show_screen ()) {
+	    frames_shown++;
+	    last_active = now;
+	    if (0 > first_frame_usec) {
+		first_frame_usec = usec_since_start ();
 	    }
-	} while (!time_is_after (&cur_time, &tick_time));
+	} else {
+	    frames_elided++;
+	}
+
+	/* Draw ahead in the direction of scrolling while time allows. */
+	draw_margin ();
 
-	/*
-	 * Advance the tick time.  If we missed one or more ticks completely, 
-	 * i.e., if the current time is already after the time for the next 
-	 * tick, just skip the extra ticks and advance the clock to the one
-	 * that we haven't missed.
+	/* 
+	 * Wait for something to happen.  Keystrokes or Tux commands left 
+	 * waiting by a room change do not make their descriptors readable,
+	 * so if there are any, we only check for other events.
 	 */
-	do {
-	    if ((tick_time.tv_usec += TICK_USEC) > 1000000) {
-		tick_time.tv_sec++;
-		tick_time.tv_usec -= 1000000;
+	keys = input_pending ();
+	if (0 > (n_ev = epoll_wait (epoll_fd, ev, N_EVENT_SRCS,
+				    (keys || tux_tail != 
+				     __atomic_load_n (&tux_head, 
+						      __ATOMIC_ACQUIRE) ?
+				     0 : -1)))) {
+	    if (EINTR == errno) {
+		continue;
 	    }
-	} while (time_is_after (&cur_time, &tick_time));
+	    /* Panic!  (should never happen) */
+	    clear_mode_X ();
+	    shutdown_input ();
+	    perror ("epoll_wait");
+	    exit (3);
+	}
+	woke = tick_elapsed_usec ();
 
-	/*
-	 * Handle asynchronous events.  These events use real time rather
-	 * than tick counts for timing, although the real time is rounded
-	 * off to the nearest tick by definition.
+	/* 
+	 * Handle each event that is ready.  After a room change, any
+	 * remaining events wait (they stay ready) until the new room
+	 * has been drawn, so that they apply to the new room.  Note that 
+	 * typed commands that move objects may cause the room to be 
+	 * redrawn.
 	 */
-	/* (none right now...) */
-	button = get_tux_cmd();
-	if(button != CMD_NONE)
-	{
-		b_pressed =1;
-	}else{
-		b_pressed =0;
-	}
+	for (idx = 0; n_ev > idx && !enter_room; idx++) {
+	    cmd = CMD_NONE;
+	    switch (ev[idx].data.u32) {
+		case EV_KEYBOARD:
+		    /* Handled below, with any keystrokes left waiting. */
+		    keys = 1;
+		    break;
+
+		case EV_TUX:
+		    /* Handled below, with any commands left waiting. */
+		    (void)read (tux_event_fd, &tux_events, sizeof (tux_events));
+		    break;
+
+		case EV_TICK:
+		    if (0 > (started = tick_expired ())) {
+			/* Panic!  (should never happen) */
+			clear_mode_X ();
+			shutdown_input ();
+			perror ("timerfd");
+			exit (3);
+		    }
+		    if (!started) {
+			break;
+		    }
+		    now = tick_elapsed_usec ();
+
+		    /*
+		     * Handle asynchronous events.  These events use real 
+		     * time rather than tick counts for timing, although the
+		     * real time is rounded off to the nearest tick by 
+		     * definition.  A fade in progress counts as activity.
+		     */
+		    timer_run (now);
+		    if (timer_pending (&fade_timer)) {
+			last_active = now;
+		    }
+
+		    /* Note the keyboard input read during the last tick. */
+		    get_input_stats (&in_stats);
+		    if (key_bytes_max < in_stats.bytes - key_bytes_seen) {
+			key_bytes_max = in_stats.bytes - key_bytes_seen;
+		    }
+		    key_bytes_seen = in_stats.bytes;
+
+		    /* Choose the length of the next tick (see above). */
+		    if (FAST_HOLD_USEC > now - last_motion) {
+			period = TICK_FAST_USEC;
+		    } else if (IDLE_WAIT_USEC > now - last_active) {
+			period = TICK_USEC;
+		    } else {
+			period = TICK_IDLE_USEC;
+		    }
+		    if (0 != tick_set_period (period)) {
+			/* Panic!  (should never happen) */
+			clear_mode_X ();
+			shutdown_input ();
+			perror ("timerfd_settime");
+			exit (3);
+		    }
+
+		    /* 
+		     * Repeat any held Tux controller motion (see above), 
+		     * allowing for the tick boundaries to fall a little 
+		     * short of TICK_USEC apart.
+		     */
+		    if (CMD_NONE != tux_held && 
+			TICK_USEC - TICK_FAST_USEC / 2 <= now - tux_repeated) {
+			cmd = tux_held;
+			tux_repeated = now;
+		    }
+		    break;
+	    }
 
-	
-	(void)pthread_mutex_lock (&tux_lock);
-	if(b_pressed){
-		pthread_cond_signal(&tux_cv);
+	    /* Handle any player command. */
+	    if (is_motion_command (cmd)) {
+		last_motion = last_active = tick_elapsed_usec ();
+	    } else if (CMD_NONE != cmd) {
+		last_active = tick_elapsed_usec ();
+	    }
+	    if (handle_command (cmd)) {
+		return GAME_QUIT;
+	    }
 	}
 
-	(void)pthread_mutex_unlock (&tux_lock);
 	/* 
-	 * Handle synchronous events--in this case, only player commands. 
-	 * Note that typed commands that move objects may cause the room
-	 * to be redrawn.
+	 * Handle Tux commands, then keystrokes, in the order in which they
+	 * arrived.  Any that follow a room change wait in their queues 
+	 * until the new room has been drawn.
 	 */
-	if(!b_pressed){
-	cmd = get_command ();
-	switch (cmd) {
-	    case CMD_UP:    move_photo_down ();  break;
-	    case CMD_RIGHT: move_photo_left ();  break;
-	    case CMD_DOWN:  move_photo_up ();    break;
-	    case CMD_LEFT:  move_photo_right (); break;
-	    case CMD_MOVE_LEFT:   
-		enter_room = (TC_CHANGE_ROOM == 
-			      try_to_move_left (&game_info.where));
-		break;
-	    case CMD_ENTER:
-		enter_room = (TC_CHANGE_ROOM ==
-			      try_to_enter (&game_info.where));
-		break;
-	    case CMD_MOVE_RIGHT:
-		enter_room = (TC_CHANGE_ROOM == 
-			      try_to_move_right (&game_info.where));
-		break;
-	    case CMD_TYPED:
-		if (handle_typing ()) {
-		    enter_room = 1;
-		}
-		break;
-	    case CMD_QUIT: return GAME_QUIT;
-	    default: break;
+	if (!enter_room && handle_tux (&last_motion, &last_active)) {
+	    return GAME_QUIT;
 	}
+	if (keys && !enter_room && 
+	    handle_keyboard (&last_motion, &last_active)) {
+	    return GAME_QUIT;
 	}
-	
-	
+
 	/* If player wins the game, their room becomes NULL. */
 	if (NULL == game_info.where) {
 	    return GAME_WON;
@@ -378,6 +592,311 @@ game_loop ()
 }
 
 
+/* 
+ * watch_fd
+ *   DESCRIPTION: Add a file descriptor to the set watched by the event
+ *                loop, waiting for it to become readable.
+ *   INPUTS: epoll_fd -- epoll descriptor for the event loop
+ *           fd -- descriptor to watch
+ *           id -- event source identifier (EV_*) reported when ready
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+watch_fd (int epoll_fd, int fd, uint32_t id)
+{
+    struct epoll_event ev; /* event to watch for */
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = id;
+    return epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+
+/* 
+ * is_motion_command
+ *   DESCRIPTION: Check whether a command scrolls the room photo.
+ *   INPUTS: cmd -- the command
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if cmd is a direction, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+is_motion_command (cmd_t cmd)
+{
+    return (CMD_UP == cmd || CMD_RIGHT == cmd || 
+	    CMD_DOWN == cmd || CMD_LEFT == cmd);
+}
+
+
+/* 
+ * handle_tux
+ *   DESCRIPTION: Handle the commands queued by the Tux controller thread,
+ *                in the order in which the buttons changed, until the
+ *                player's room changes.  Records the direction button
+ *                held down, if any, so that its motion repeats.
+ *   INPUTS: none
+ *   OUTPUTS: *last_motion -- time of the last scrolling command (if any)
+ *            *last_active -- time of the last command (if any)
+ *   RETURN VALUE: 1 if the player quits, 0 otherwise
+ *   SIDE EFFECTS: see handle_command
+ */
+static int32_t
+handle_tux (int64_t* last_motion, int64_t* last_active)
+{
+    cmd_t cmd; /* command from controller */
+
+    while (!enter_room && tux_queue_pop (&cmd)) {
+	tux_held = (is_motion_command (cmd) ? cmd : CMD_NONE);
+	if (CMD_NONE == cmd) {
+	    continue;
+	}
+	*last_active = tick_elapsed_usec ();
+	if (is_motion_command (cmd)) {
+	    *last_motion = tux_repeated = *last_active;
+	}
+	if (handle_command (cmd)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+
+/* 
+ * start_tux_thread
+ *   DESCRIPTION: Start the Tux controller thread, if the controller is in
+ *                use (see above).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: creates a thread and an eventfd
+ */
+static int32_t
+start_tux_thread ()
+{
+    if (0 > get_tux_fd ()) {
+	return 0;
+    }
+    if (0 > (tux_event_fd = eventfd (0, EFD_CLOEXEC))) {
+	return -1;
+    }
+    if (0 != pthread_create (&tux_thread_id, NULL, t_thread, NULL)) {
+	(void)close (tux_event_fd);
+	tux_event_fd = -1;
+	return -1;
+    }
+    return 0;
+}
+
+
+/* 
+ * cancel_tux_thread
+ *   DESCRIPTION: Stop the Tux controller thread, if it was started, and
+ *                wait for it to end.  Used as a cleanup method.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: ends a thread; closes its eventfd
+ */
+static void
+cancel_tux_thread (void* ignore)
+{
+    if (0 > tux_event_fd) {
+	return;
+    }
+    (void)pthread_cancel (tux_thread_id);
+    (void)pthread_join (tux_thread_id, NULL);
+    (void)close (tux_event_fd);
+    tux_event_fd = -1;
+}
+
+
+/*
+ * t_thread
+ *   DESCRIPTION: Tux Controller thread function.  Waits for the controller
+ *                buttons to change, then reads them and queues the 
+ *                resulting command (CMD_NONE when all are released) for
+ *                the game loop, waking it through tux_event_fd.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL (normally the thread is cancelled instead)
+ *   SIDE EFFECTS: pushes commands into the Tux command queue
+ */
+static void*
+t_thread (void* ignore)
+{
+    struct pollfd pfd;     /* the controller to wait for      */
+    uint64_t      one = 1; /* count added to the eventfd      */
+
+    pfd.fd = get_tux_fd ();
+    pfd.events = POLLIN;
+    while (1) {
+	if (0 > poll (&pfd, 1, -1)) {
+	    if (EINTR == errno) {
+		continue;
+	    }
+	    perror ("poll Tux controller");
+	    break;
+	}
+	if (0 == tux_queue_push (get_tux_cmd ())) {
+	    (void)write (tux_event_fd, &one, sizeof (one));
+	}
+    }
+    return NULL;
+}
+
+
+/*
+ * tux_queue_push
+ *   DESCRIPTION: Add a command to the Tux command queue.  Called only by
+ *                the Tux controller thread.
+ *   INPUTS: cmd -- the command
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the queue is full (the command is
+ *                 dropped)
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+tux_queue_push (cmd_t cmd)
+{
+    uint32_t head; /* commands pushed so far */
+
+    head = __atomic_load_n (&tux_head, __ATOMIC_RELAXED);
+    if (TUX_QUEUE_LEN == 
+	head - __atomic_load_n (&tux_tail, __ATOMIC_ACQUIRE)) {
+	__atomic_add_fetch (&tux_dropped, 1, __ATOMIC_RELAXED);
+	return -1;
+    }
+    tux_queue[head & (TUX_QUEUE_LEN - 1)] = cmd;
+
+    /* Publish the command only after it has been written. */
+    __atomic_store_n (&tux_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+
+/*
+ * tux_queue_pop
+ *   DESCRIPTION: Remove the oldest command from the Tux command queue.
+ *                Called only by the game loop.
+ *   INPUTS: none
+ *   OUTPUTS: *cmd -- the command (if any)
+ *   RETURN VALUE: 1 if a command was removed, 0 if the queue was empty
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+tux_queue_pop (cmd_t* cmd)
+{
+    uint32_t tail; /* commands popped so far */
+
+    tail = __atomic_load_n (&tux_tail, __ATOMIC_RELAXED);
+    if (tail == __atomic_load_n (&tux_head, __ATOMIC_ACQUIRE)) {
+	return 0;
+    }
+    *cmd = tux_queue[tail & (TUX_QUEUE_LEN - 1)];
+
+    /* Release the slot only after the command has been read. */
+    __atomic_store_n (&tux_tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+/* 
+ * handle_command
+ *   DESCRIPTION: Carry out a command from the keyboard or Tux controller.
+ *   INPUTS: cmd -- the command
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the player quits, 0 otherwise
+ *   SIDE EFFECTS: may move the view window or the player (setting 
+ *                 enter_room if the player's room changes), move objects,
+ *                 and/or redraw the screen
+ */
+static int32_t
+handle_command (cmd_t cmd)
+{
+    switch (cmd) {
+	case CMD_UP: case CMD_RIGHT: case CMD_DOWN: case CMD_LEFT:
+	    scroll_view (cmd);
+	    show_view_move ();
+	    break;
+	case CMD_MOVE_LEFT:   
+	    enter_room = (TC_CHANGE_ROOM == 
+			  try_to_move_left (&game_info.where));
+	    break;
+	case CMD_ENTER:
+	    enter_room = (TC_CHANGE_ROOM ==
+			  try_to_enter (&game_info.where));
+	    break;
+	case CMD_MOVE_RIGHT:
+	    enter_room = (TC_CHANGE_ROOM == 
+			  try_to_move_right (&game_info.where));
+	    break;
+	case CMD_TYPED:
+	    if (handle_typing ()) {
+		enter_room = 1;
+	    }
+	    break;
+	case CMD_QUIT: return 1;
+	default: break;
+    }
+    return 0;
+}
+
+
+/* 
+ * handle_keyboard
+ *   DESCRIPTION: Carry out the commands waiting from the keyboard, in the
+ *                order in which they were typed, stopping early if the
+ *                player's room changes.  Scrolling is applied to the 
+ *                view position one command at a time, but consecutive 
+ *                commands scrolling along the same axis are shown with
+ *                a single move of the view window, so that only the 
+ *                lines exposed by the whole run are drawn.  Any move
+ *                due is shown before another kind of command is handled.
+ *   INPUTS: none
+ *   OUTPUTS: *last_motion -- set to the current time if the view scrolled
+ *            *last_active -- set to the current time if any command was
+ *                            handled
+ *   RETURN VALUE: 1 if the player quits, 0 otherwise
+ *   SIDE EFFECTS: drains keyboard input; see handle_command
+ */
+static int32_t
+handle_keyboard (int64_t* last_motion, int64_t* last_active)
+{
+    cmd_t cmd;		    /* command typed                      */
+    cmd_t moved = CMD_NONE; /* last scrolling command not yet shown */
+
+    while (!enter_room && CMD_NONE != (cmd = get_command ())) {
+	*last_active = tick_elapsed_usec ();
+	if (is_motion_command (cmd)) {
+	    /* Show the run so far if this one scrolls the other way. */
+	    if (CMD_NONE != moved &&
+		(CMD_UP == moved || CMD_DOWN == moved) != 
+		(CMD_UP == cmd || CMD_DOWN == cmd)) {
+		show_view_move ();
+	    }
+	    scroll_view (cmd);
+	    *last_motion = *last_active;
+	    moved = cmd;
+	    continue;
+	}
+	if (CMD_NONE != moved) {
+	    show_view_move ();
+	    moved = CMD_NONE;
+	}
+	if (handle_command (cmd)) {
+	    return 1;
+	}
+    }
+    if (CMD_NONE != moved) {
+	show_view_move ();
+    }
+    return 0;
+}
+
+
 /* 
  * handle_typing
  *   DESCRIPTION: Parse and execute a typed command.
@@ -392,7 +911,7 @@ handle_typing ()
     const char*      cmd;     /* command verb typed                */
     int32_t          cmd_len; /* length of command verb            */
     const char*      arg;     /* argument given to command verb    */
-    int32_t          idx;     /* loop index over command list      */
+    int32_t          verb;    /* trie node reached by command verb */
     tc_action_t      result;  /* result of typed command execution */
 
     /* Read the command and strip leading spaces.  If it's empty, return. */
@@ -412,17 +931,15 @@ handle_typing ()
     arg = &cmd[cmd_len];
     while (' ' == *arg) { arg++; }
     
-	/* Compare the typed verb with each command in our list. */
-    for (idx = 0; NULL != cmd_list[idx].name; idx++) {
-
-        /* If the typed verb is not long enough, it can't match. */
-	if (cmd_list[idx].min_len > cmd_len) { continue; }
-
-	/* Compare the prefix of the command with the typed verb. */
-        if (0 != strncasecmp (cmd_list[idx].name, cmd, cmd_len)) { continue; }
+    /* 
+     * The typed verb was matched against the verbs in cmd_list as it
+     * was typed (see words.h); if it selects none, it's not a command.
+     */
+    get_typed_nodes (&verb, NULL);
+    if (0 <= word_verb (verb)) {
 
 	/* Execute the command found. */
-	switch (cmd_list[idx].cmd) {
+	switch (word_verb (verb)) {
 	    case TC_BUY:
 	        result = typed_cmd_buy (&game_info.where, arg);
 		break;
@@ -468,6 +985,17 @@ handle_typing ()
 	    case TC_INVENTORY:
 	        result = typed_cmd_inventory (&game_info.where, arg);
 		break;
+	    case TC_RESTORE:
+	        result = restore_checkpoint ();
+		break;
+	    case TC_SAVE:
+		if (0 == save_checkpoint ()) {
+		    show_status ("Game saved.");
+		} else {
+		    show_status ("Can't save the game!");
+		}
+		result = TC_DISCARD_TEXT;
+		break;
 	    case TC_SIGH:
 	        result = typed_cmd_sigh (&game_info.where, arg);
 		break;
@@ -502,6 +1030,64 @@ handle_typing ()
 }
 
 
+/* 
+ * add_typed_verbs
+ *   DESCRIPTION: Add the verbs of the typed commands to the verb trie, so
+ *                that they are matched as they are typed.  The order of
+ *                cmd_list decides between verbs with the same 
+ *                abbreviation.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the trie is full
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+add_typed_verbs ()
+{
+    int32_t idx; /* loop index over command list */
+
+    for (idx = 0; NULL != cmd_list[idx].name; idx++) {
+	if (0 != add_verb (cmd_list[idx].name, cmd_list[idx].min_len,
+			   cmd_list[idx].cmd)) {
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+
+/* 
+ * typed_with_hint
+ *   DESCRIPTION: Get the typed command as shown in the status bar: when
+ *                the word being typed can only be completed one way, the
+ *                rest of it is shown in brackets after the text typed 
+ *                (as space allows).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the text to show (valid until the next call)
+ *   SIDE EFFECTS: none
+ */
+static const char*
+typed_with_hint ()
+{
+    static char shown[MAX_TYPED_LEN + 1]; /* text to show */
+    const char* typed;	  /* text typed                   */
+    const char* hint;	  /* rest of word being typed     */
+    int32_t last;	  /* trie node reached by typing  */
+    int32_t room;	  /* characters left for the hint */
+
+    typed = get_typed_command ();
+    get_typed_nodes (NULL, &last);
+    hint = word_hint (last);
+    room = MAX_TYPED_LEN - (int32_t)strlen (typed) - 2;
+    if ('\0' == *hint || 0 >= room) {
+	return typed;
+    }
+    snprintf (shown, sizeof (shown), "%s[%.*s]", typed, room, hint);
+    return shown;
+}
+
+
 /* 
  * init_game
  *   DESCRIPTION: Initialize the game information, including the initial
@@ -522,6 +1108,66 @@ init_game ()
 }
 
 
+/* 
+ * save_checkpoint
+ *   DESCRIPTION: Save the game to SAVE_FILE.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+save_checkpoint ()
+{
+    game_view_t view; /* game information saved with world */
+
+    view.map_x = game_info.map_x;
+    view.map_y = game_info.map_y;
+    return save_game (SAVE_FILE, game_info.where, &view);
+}
+
+
+/* 
+ * restore_checkpoint
+ *   DESCRIPTION: Restore the game saved in SAVE_FILE, keeping the view 
+ *                window where it was when the game was saved (if it
+ *                still fits the room photo).  The speeds of motion are
+ *                set from the restored inventory.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: indicates types of action taken (see world.h)
+ *   SIDE EFFECTS: changes the player's room, shows a status message
+ */
+static tc_action_t
+restore_checkpoint ()
+{
+    game_view_t view;  /* game information saved with world */
+    room_t*     where; /* player's room in saved game       */
+
+    if (NULL == (where = restore_game (SAVE_FILE, &view))) {
+	show_status ("No saved game to restore.");
+	return TC_DISCARD_TEXT;
+    }
+    game_info.where = where;
+    game_info.x_speed = (player_has_board () ? 
+			 MOTION_SPEED * 3 : MOTION_SPEED);
+    game_info.y_speed = (player_has_jetpack () ? 
+			 MOTION_SPEED * 3 : MOTION_SPEED);
+
+    /* Keep the saved view only if it lies within the room photo. */
+    if (SCROLL_X_DIM <= room_photo_width (where) &&
+	SCROLL_Y_DIM <= room_photo_height (where) &&
+	room_photo_width (where) - SCROLL_X_DIM >= view.map_x &&
+	room_photo_height (where) - SCROLL_Y_DIM >= view.map_y) {
+	game_info.map_x = view.map_x;
+	game_info.map_y = view.map_y;
+	keep_view = 1;
+    }
+    show_status ("Game restored.");
+    return TC_CHANGE_ROOM;
+}
+
+
 /* 
  * move_photo_down
  *   DESCRIPTION: Move background photo down one or more pixels.  Amount of
@@ -530,13 +1176,12 @@ init_game ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts logical view (shown by show_view_move)
  */
 static void
 move_photo_down ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over rows to redraw.         */
 
     /* Calculate the number of pixels by which to move. */
     delta = (game_info.y_speed > game_info.map_y ?
@@ -544,12 +1189,9 @@ move_photo_down ()
 
     /* Shift the logical view upward. */
     game_info.map_y -= delta;
-    set_view_window (game_info.map_x, game_info.map_y);
 
-    /* Draw the newly exposed lines. */
-    for (idx = 0; delta > idx; idx++) {
-	(void)draw_horiz_line (idx);
-    }
+    /* Draw ahead further in the same direction when idle. */
+    margin_dir = MARGIN_UP;
 }
 
 
@@ -562,13 +1204,12 @@ move_photo_down ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts logical view (shown by show_view_move)
  */
 static void
 move_photo_left ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over columns to redraw.      */
 
     /* Calculate the number of pixels by which to move. */
     delta = room_photo_width (game_info.where) - SCROLL_X_DIM -
@@ -577,12 +1218,9 @@ move_photo_left ()
 
     /* Shift the logical view to the right. */
     game_info.map_x += delta;
-    set_view_window (game_info.map_x, game_info.map_y);
 
-    /* Draw the newly exposed lines. */
-    for (idx = 1; delta >= idx; idx++) {
-	(void)draw_vert_line (SCROLL_X_DIM - idx);
-    }
+    /* Draw ahead further in the same direction when idle. */
+    margin_dir = MARGIN_RIGHT;
 }
 
 
@@ -594,13 +1232,12 @@ move_photo_left ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts logical view (shown by show_view_move)
  */
 static void
 move_photo_right ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over columns to redraw.      */
 
     /* Calculate the number of pixels by which to move. */
     delta = (game_info.x_speed > game_info.map_x ?
@@ -608,12 +1245,9 @@ move_photo_right ()
 
     /* Shift the logical view to the left. */
     game_info.map_x -= delta;
-    set_view_window (game_info.map_x, game_info.map_y);
 
-    /* Draw the newly exposed lines. */
-    for (idx = 0; delta > idx; idx++) {
-	(void)draw_vert_line (idx);
-    }
+    /* Draw ahead further in the same direction when idle. */
+    margin_dir = MARGIN_LEFT;
 }
 
 
@@ -625,13 +1259,12 @@ move_photo_right ()
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: shifts view window
+ *   SIDE EFFECTS: shifts logical view (shown by show_view_move)
  */
 static void
 move_photo_up ()
 {
     int32_t delta; /* Number of pixels by which to move. */
-    int32_t idx;   /* Index over rows to redraw.         */
 
     /* Calculate the number of pixels by which to move. */
     delta = room_photo_height (game_info.where) - SCROLL_Y_DIM - 
@@ -640,12 +1273,50 @@ move_photo_up ()
 
     /* Shift the logical view upward. */
     game_info.map_y += delta;
-    set_view_window (game_info.map_x, game_info.map_y);
 
-    /* Draw the newly exposed lines. */
-    for (idx = 1; delta >= idx; idx++) {
-	(void)draw_horiz_line (SCROLL_Y_DIM - idx);
+    /* Draw ahead further in the same direction when idle. */
+    margin_dir = MARGIN_DOWN;
+}
+
+
+/* 
+ * scroll_view
+ *   DESCRIPTION: Shift the logical view for a scrolling command.
+ *   INPUTS: cmd -- the command (a direction)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: shifts logical view (shown by show_view_move)
+ */
+static void
+scroll_view (cmd_t cmd)
+{
+    switch (cmd) {
+	case CMD_UP:    move_photo_down ();  break;
+	case CMD_RIGHT: move_photo_left ();  break;
+	case CMD_DOWN:  move_photo_up ();    break;
+	case CMD_LEFT:  move_photo_right (); break;
+	default: return;
     }
+    scroll_cmds++;
+}
+
+
+/* 
+ * show_view_move
+ *   DESCRIPTION: Move the view window to the logical view position, and 
+ *                draw the newly exposed lines (unless they were drawn 
+ *                ahead of time).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: shifts view window; draws into the build buffer
+ */
+static void
+show_view_move ()
+{
+    set_view_window (game_info.map_x, game_info.map_y);
+    draw_exposed_lines ();
+    scroll_moves++;
 }
 
 
@@ -660,152 +1331,150 @@ move_photo_up ()
 static void
 redraw_room ()
 {
-    int32_t i; /* index over rows */
-
-    /* Draw all lines in the scroll region. */
-    for (i = 0; i < SCROLL_Y_DIM; i++) {
-	(void)draw_horiz_line (i);
-    }
+    /* Draw all lines in the scroll region (split across threads). */
+    draw_all_lines ();
 }
 
 
 /* 
- * status_thread
- *   DESCRIPTION: Function executed by status message helper thread.
- *                Waits for a message to be displayed, then shows the
- *                message for 1.5 seconds before deleting it.  If a
- *                new message has appeared in the meantime, restarts the
- *                clock and tries again.
+ * clear_status
+ *   DESCRIPTION: Timer function that clears the status message once it
+ *                has been shown for STATUS_MSG_USEC.
  *   INPUTS: none (ignored)
  *   OUTPUTS: none
- *   RETURN VALUE: NULL
+ *   RETURN VALUE: none
  *   SIDE EFFECTS: Changes the status message to an empty string.
  */
-static void*
-status_thread (void* ignore)
+static void
+clear_status (void* ignore)
 {
-    struct timespec ts; /* absolute wake-up time */
+    status_msg[0] = '\0';
+}
 
-    while (1) {
 
-	/* 
-	 * Wait for a message to appear.  Note that we must check the
-	 * condition after acquiring the lock, and that pthread_cond_wait
-	 * yields the lock, then reacquires the lock before returning.
-	 */
-	(void)pthread_mutex_lock (&msg_lock);
-	while ('\0' == status_msg[0]) {
-	    pthread_cond_wait (&msg_cv, &msg_lock);
-	}
+/* 
+ * show_tux_clock
+ *   DESCRIPTION: Timer function that shows the elapsed time on the Tux 
+ *                controller, then schedules itself for the start of the
+ *                next second.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the controller's display
+ */
+static void
+show_tux_clock (void* ignore)
+{
+    int32_t sec; /* seconds elapsed */
 
-	/* 
-	 * A message is present: if we stop before the timeout
-	 * passes, assume that a new one has been posted; if the
-	 * timeout passes, clear the message and wait for a new one.
-	 */
-	do {
-	    /* Get the current time. */
-	    clock_gettime (CLOCK_REALTIME, &ts);
-	    
-	    /* Add 1.5 seconds to it. */
-	    if (500000000 <= ts.tv_nsec) {
-		ts.tv_sec += 2;
-		ts.tv_nsec -= 500000000;
-	    } else {
-		ts.tv_sec += 1;
-		ts.tv_nsec += 500000000;
-	    }
+    sec = tick_elapsed_sec ();
+    display_time_on_tux (sec);
+    timer_schedule_at (&clock_timer, (sec + 1) * (int64_t)1000000);
+}
 
-	    /* 
-	     * And go to sleep.  If we wake up due to anything but a
-	     * timeout, we assume (possibly incorrectly) that a new
-	     * message has appeared and try to wait 1.5 seconds again.
-	     */
-	} while (ETIMEDOUT != 
-		 pthread_cond_timedwait (&msg_cv, &msg_lock, &ts));
 
-	/* 
-	 * Clear the message, then release the lock (remember that 
-	 * pthread_cond_timedwait reacquires the lock before returning).
-	 */
-	status_msg[0] = '\0';
-	(void)pthread_mutex_unlock (&msg_lock);
+/* 
+ * draw_margin
+ *   DESCRIPTION: Use the time left before the next tick to draw lines of
+ *                the margin beside the view window, on the side toward
+ *                which the view last scrolled, up to the edge of the 
+ *                room photo.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer (but not onto the screen)
+ */
+static void
+draw_margin ()
+{
+    int32_t limit; /* edge of photo on margin side */
+
+    switch (margin_dir) {
+	case MARGIN_DOWN: 
+	    limit = room_photo_height (game_info.where); 
+	    break;
+	case MARGIN_RIGHT: 
+	    limit = room_photo_width (game_info.where); 
+	    break;
+	default: 
+	    limit = 0; 
+	    break;
+    }
+    while (MARGIN_SPARE_USEC < tick_remaining_usec () &&
+	   draw_margin_line (margin_dir, limit)) {
     }
-
-    /* This code never executes--the thread should always be cancelled. */
-    return NULL;
 }
 
 
-/*
- * t_thread
- *   DESCRIPTION: Tux Controller thread function that listens for button presses
- *                and performs corresponding actions.
- *   INPUTS:
- *     ignore - A pointer to the ignored data 
- *   OUTPUTS: None
- *   RETURN VALUE:
- *     If the thread function exits normally, it returns NULL
- *     If the thread function exits due to an error, it returns an error code
- *   SIDE EFFECTS: Performs actions based on Tux Controller button presses.
+/* 
+ * usec_since_start
+ *   DESCRIPTION: Get the time since the program started.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: microseconds since the start of main
+ *   SIDE EFFECTS: none
  */
+static int64_t
+usec_since_start ()
+{
+    struct timespec now; /* current time */
 
-static void*
-t_thread (void* ignore){
-	
-    while (1) {
-
-		(void)pthread_mutex_lock (&tux_lock);
-		while (b_pressed == 0) {
-			pthread_cond_wait (&tux_cv, &tux_lock);
-		}
-		if(b_pressed){  // checks if a button is pressed and goes on to the if cases for the commands
-			switch (button) {
-			case CMD_UP:    move_photo_down ();  break; // if CMD_UP is button pressed go to move_photo_down
-			case CMD_RIGHT: move_photo_left ();  break; // if CMD_RIGHT is button pressed go to move_photo_left
-			case CMD_DOWN:  move_photo_up ();    break; // if CMD_DOWN is button pressed go to move_photo_up
-			case CMD_LEFT:  move_photo_right (); break; // if CMD_LEFT is button pressed go to move_photo_right
-			case CMD_MOVE_LEFT:   //check if attempting to move left results in a room change
-			enter_room = (TC_CHANGE_ROOM == 
-					try_to_move_left (&game_info.where));
-			break;
-			case CMD_ENTER:   // check if attempting to enter results in a room change
-			enter_room = (TC_CHANGE_ROOM ==
-					try_to_enter (&game_info.where));
-			break;
-			case CMD_MOVE_RIGHT: // check if attempting to move right results in a room change
-			enter_room = (TC_CHANGE_ROOM == 
-					try_to_move_right (&game_info.where));
-			break;
-			default: break;
-	}
-	}
+    (void)clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - program_start.tv_sec) * 1000000LL +
+	   (now.tv_nsec - program_start.tv_nsec) / 1000;
+}
 
 
-	b_pressed = 0 ;
-	(void)pthread_mutex_unlock (&tux_lock);
-	}
+/* 
+ * step_fade
+ *   DESCRIPTION: Timer function that steps the room photo colors one step
+ *                through a fade-in, and schedules the next step if the 
+ *                fade is not yet complete.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA palette
+ */
+static void
+step_fade (void* ignore)
+{
+    set_palette_fade (get_palette_fade () + 1);
+    if (PALETTE_FADE_STEPS > get_palette_fade ()) {
+	timer_schedule (&fade_timer, FADE_STEP_USEC);
+    }
 }
 
+
+#if (USE_ROOM_FADE == 1)
 /* 
- * time_is_after 
- *   DESCRIPTION: Check whether one time is at or after a second time.
- *   INPUTS: t1 -- the first time
- *           t2 -- the second time
+ * fade_out_room
+ *   DESCRIPTION: Steps the room photo colors down their fade ramp to black,
+ *                one step every FADE_STEP_USEC, stopping any fade-in still
+ *                in progress.  Called when the player leaves a room, before
+ *                the new room is drawn.
+ *   INPUTS: none
  *   OUTPUTS: none
- *   RETURN VALUE: 1 if t1 >= t2
- *                 0 if t1 < t2
- *   SIDE EFFECTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the VGA palette; blocks the event loop for up to
+ *                 (PALETTE_FADE_STEPS - 1) * FADE_STEP_USEC (input and 
+ *                 ticks that arrive meanwhile wait for the new room)
  */
-static int
-time_is_after (struct timeval* t1, struct timeval* t2)
+static void
+fade_out_room ()
 {
-    if (t1->tv_sec == t2->tv_sec)
-        return (t1->tv_usec >= t2->tv_usec);
-    if (t1->tv_sec > t2->tv_sec)
-        return 1;
-    return 0;
+    static const struct timespec wait = {
+	FADE_STEP_USEC / 1000000, (FADE_STEP_USEC % 1000000) * 1000
+    };                        /* time between steps */
+
+    timer_cancel (&fade_timer);
+    while (0 < get_palette_fade ()) {
+	set_palette_fade (get_palette_fade () - 1);
+	if (0 < get_palette_fade ()) {
+	    (void)nanosleep (&wait, NULL);
+	}
+    }
 }
+#endif /* USE_ROOM_FADE == 1 */
 
 
 /* 
@@ -815,40 +1484,38 @@ time_is_after (struct timeval* t1, struct timeval* t2)
  *   INPUTS: s -- the string used for the status message
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Overwrites any previous message.
+ *   SIDE EFFECTS: Overwrites any previous message; (re)starts the timer
+ *                 that clears the message.
  */
 void
 show_status (const char* s)
 {
-    /* msg_lock critical section starts here. */
-    (void)pthread_mutex_lock (&msg_lock);
-
-    /* Copy the new message under the protection of msg_lock. */
     strncpy (status_msg, s, STATUS_MSG_LEN);
     status_msg[STATUS_MSG_LEN] = '\0';
-
-    /* 
-     * Wake up the status message helper thread.  Note that we still hold
-     * the msg_lock, so the thread can't wake up until we release it.
-     */
-    (void)pthread_cond_signal (&msg_cv);
-
-    /* msg_lock critical section ends here. */
-    (void)pthread_mutex_unlock (&msg_lock);
+    timer_schedule (&status_timer, STATUS_MSG_USEC);
 }
 
 
 /* 
  * main
  *   DESCRIPTION: Play the adventure game.
- *   INPUTS: none (command line arguments are ignored)
+ *   INPUTS: argc, argv -- an optional world file (from mp2world) to play 
+ *                         in place of WORLD_FILE
  *   OUTPUTS: none
- *   RETURN VALUE: 0 on success, 3 in panic situations
+ *   RETURN VALUE: 0 on success, 2 for bad arguments, 3 in panic situations
  */
 int
-main ()
+main (int argc, char* argv[])
 {
     game_condition_t game;  /* outcome of playing */
+    tick_stats_t ticks;     /* event loop timing  */
+    prefetch_stats_t pf;    /* background drawing */
+    photo_load_stats_t load; /* background loading */
+    render_stats_t render;  /* frame timing       */
+    input_stats_t keys;     /* keyboard reading   */
+
+    /* Note the time, so as to measure the time to the first frame. */
+    (void)clock_gettime (CLOCK_MONOTONIC, &program_start);
 
     /* Randomize for more fun (remove for deterministic layout). */
     srand (time (NULL));
@@ -856,24 +1523,36 @@ main ()
     /* Provide some protection against fatal errors. */
     clean_on_signals ();
 
-    if (!build_world ()) {PANIC ("can't build world");}
+    if (2 < argc) {
+	fprintf (stderr, "usage: %s [<world file>]\n", argv[0]);
+	return 2;
+    }
+    if (!build_world (2 == argc ? argv[1] : WORLD_FILE)) {
+	PANIC ("can't build world");
+    }
+    if (0 != add_typed_verbs ()) {PANIC ("too many typed words");}
     init_game ();
 
     /* Perform sanity checks. */
     if (0 != sanity_check ()) {
 	PANIC ("failed sanity checks");
     }
-	    /* Create status message thread. */
-    if (0 != pthread_create (&tux_thread_id, NULL,t_thread, NULL)) {
-        PANIC ("failed to create button thread");
-    }
-    push_cleanup (cancel_tux_thread, NULL); {
 
-    /* Create status message thread. */
-    if (0 != pthread_create (&status_thread_id, NULL, status_thread, NULL)) {
-        PANIC ("failed to create status thread");
+#if (LOAD_PHOTOS_LATER == 1)
+    /* 
+     * Reading a photo takes time (choosing its palette), so only the 
+     * photo of the first room is read before the game starts; the rest
+     * are read in the background, and the game waits for one only if the
+     * player reaches its room first.
+     */
+    if (0 != load_photo (room_photo (game_info.where))) {
+	PANIC ("can't read first room photo");
     }
-    push_cleanup (cancel_status_thread, NULL); {
+    if (!load_world_photos (1)) {PANIC ("can't load world");}
+#else
+    if (!load_world_photos (0)) {PANIC ("can't load world");}
+#endif
+    push_cleanup ((cleanup_fn_t)stop_photo_loader, NULL); {
 
 	/* Start mode X. */
 	if (0 != set_mode_X (fill_horiz_buffer, fill_vert_buffer)) {
@@ -887,14 +1566,29 @@ main ()
 	    }
 	    push_cleanup ((cleanup_fn_t)shutdown_input, NULL); {
 
-		game = game_loop ();
+		/* Start drawing neighbouring rooms in the background. */
+		if (0 != start_prefetch ()) {
+		    PANIC ("cannot start prefetch thread");
+		}
+		push_cleanup ((cleanup_fn_t)stop_prefetch, NULL); {
+
+		    /* Start reading the Tux controller, if it is in use. */
+		    if (0 != start_tux_thread ()) {
+			PANIC ("cannot start Tux controller thread");
+		    }
+		    push_cleanup (cancel_tux_thread, NULL); {
+
+			game = game_loop ();
+
+		    } pop_cleanup (1);
+
+		} pop_cleanup (1);
 
 	    } pop_cleanup (1);
 
 	} pop_cleanup (1);
 
     } pop_cleanup (1);
-	} pop_cleanup(1);
 
     /* Print a message about the outcome. */
     switch (game) {
@@ -902,6 +1596,68 @@ main ()
 	case GAME_QUIT: printf ("Quitter!\n"); break;
     }
 
+    /* Report any Tux commands lost because the game loop fell behind. */
+    if (0 != tux_dropped) {
+	printf ("%u Tux controller commands dropped (queue full)\n", 
+		tux_dropped);
+    }
+
+    /* Report how many frames were skipped because nothing changed. */
+    printf ("%u frames shown, %u elided\n", frames_shown, frames_elided);
+
+    /* Report the time taken by each stage of drawing a frame. */
+    get_render_stats (&render);
+    printf ("logic %llu usec average; compose %llu usec average; "
+	    "present %llu usec average, %u usec worst\n",
+	    (unsigned long long)(0 == logic_passes ? 0 : 
+				 logic_usec / logic_passes),
+	    (unsigned long long)(0 == render.composed ? 0 :
+				 render.compose_usec / render.composed),
+	    (unsigned long long)(0 == render.presented ? 0 :
+				 render.present_usec / render.presented),
+	    render.present_max_usec);
+    printf ("%u frames composed, %u presented, %u dropped\n",
+	    render.composed, render.presented, render.dropped);
+    printf ("%u scrolled-in lines found in margin, %u drawn\n",
+	    render.margin_hits, render.margin_misses);
+    printf ("%u scrolling commands shown in %u view moves\n", 
+	    scroll_cmds, scroll_moves);
+
+    /* Report how quickly the game started, and any waits for photos. */
+    get_photo_load_stats (&load);
+    printf ("first frame %lld usec after start; %u photos loaded in "
+	    "background, %u failed; %u waits for photos, %llu usec\n",
+	    (long long)first_frame_usec, load.loaded, load.failed, load.waits,
+	    (unsigned long long)load.wait_usec);
+    if (0 != load.failed) {
+	fprintf (stderr, "can't read photo %s", load.first_failed);
+	if (1 < load.failed) {
+	    fprintf (stderr, " (and %u others)", load.failed - 1);
+	}
+	fputc ('\n', stderr);
+    }
+
+    /* Report how often rooms drawn in the background were used. */
+    prefetch_get_stats (&pf);
+    printf ("%u rooms entered from prefetch, %u drawn on entry; "
+	    "%u prefetched, %u cancelled\n", pf.hits, pf.misses, pf.drawn,
+	    pf.cancelled);
+
+    /* Report how well the event loop kept to its tick. */
+    tick_get_stats (&ticks);
+    printf ("%u ticks, %u missed; wake-up lateness %llu usec average, "
+	    "%u usec worst\n", ticks.ticks, ticks.missed,
+	    (unsigned long long)(0 == ticks.ticks ? 0 :
+				 ticks.late_total_usec / ticks.ticks),
+	    ticks.late_max_usec);
+
+    /* Report how much keyboard input was read, and in how many calls. */
+    get_input_stats (&keys);
+    printf ("%u keyboard bytes in %u reads; %.2f bytes per tick average, "
+	    "%u most\n", keys.bytes, keys.reads, 
+	    (0 == ticks.ticks ? 0.0 : (double)keys.bytes / ticks.ticks),
+	    key_bytes_max);
+
     /* Return success. */
     return 0;
 }
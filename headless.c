@@ -0,0 +1,62 @@
+/*									tab:8
+ *
+ * headless.c - palette functions for programs that run the game without
+ *		a display
+ *
+ * Filename:	    headless.c
+ * History:
+ *		1	Stood in for modex.c's palette functions, so that the
+ *			load tester can be built without the VGA code.
+ */
+
+
+#include <string.h>
+
+#include "modex.h"
+
+
+/*
+ * set_palette
+ *   DESCRIPTION: Install a set of room photo colors.  There is no display,
+ *                so nothing is done.
+ *   INPUTS: p -- the 192 6-bit RGB colors for the room photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+set_palette (unsigned char p[192][3])
+{
+}
+
+
+/*
+ * set_palette_ramp
+ *   DESCRIPTION: Install a set of room photo colors from a fade ramp.
+ *                There is no display, so nothing is done.
+ *   INPUTS: ramp -- the fade ramp for the room photo colors
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+set_palette_ramp (const unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+}
+
+
+/*
+ * make_fade_ramp
+ *   DESCRIPTION: Build the fade ramp for a set of room photo colors.  No
+ *                ramp is ever shown, so the ramp is simply zeroed.
+ *   INPUTS: p -- the 192 6-bit RGB colors for the room photo
+ *   OUTPUTS: ramp -- the fade ramp
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+make_fade_ramp (const unsigned char p[192][3],
+		unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+    (void)memset (ramp, 0, (PALETTE_FADE_STEPS + 1) * sizeof (ramp[0]));
+}
@@ -23,7 +23,7 @@
  * SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS."
  * 
  * Author:	    Steve Lumetta
- * Version:	    7
+ * Version:	    10
  * Creation Date:   Thu Sep  9 22:25:48 2004
  * Filename:	    input.c
  * History:
@@ -42,6 +42,12 @@
  *		Updated input control and test driver for adventure game.
  *	SL	7	Wed Sep 14 17:07:38 2011
  *		Added keyboard input support when using Tux kernel mode.
+ *		8	Queued keyboard input so that no keystrokes are lost
+ *			when several arrive together.
+ *		9	Read keystrokes in bulk and decoded key sequences 
+ *			with tables built from a list of sequences.
+ *		10	Matched typed words against the word tries as each
+ *			character is typed.
  */
 
 #include <ctype.h>
@@ -58,6 +64,7 @@
 #include "input.h"
 #include "module/tuxctl-ioctl.h"
 #include "module/mtcp.h"
+#include "words.h"
 
 /* set to 1 and compile this file by itself to test functionality */
 #define TEST_INPUT_DRIVER 0
@@ -73,6 +80,82 @@ unsigned int previous;
 
 unsigned long flag;
 
+/* 
+ * Keyboard input read from stdin but not yet returned by get_command, in
+ * the order typed: commands, and characters typed as part of a command 
+ * (recorded with cmd set to CMD_NONE).  Reading stops while the queue is
+ * full, leaving the rest of the input for the next call.
+ */
+#define INPUT_QUEUE_LEN 256
+typedef struct queued_input_t queued_input_t;
+struct queued_input_t {
+    cmd_t cmd;	/* command, or CMD_NONE for a typed character */
+    char ch;	/* character typed                            */
+};
+static queued_input_t in_queue[INPUT_QUEUE_LEN];
+static int32_t in_head;	    /* index of oldest queued input */
+static int32_t in_count;    /* number of inputs queued      */
+
+/* 
+ * Bytes read from stdin but not yet decoded, from kb_buf[kb_pos] up to 
+ * kb_buf[kb_len].  More are read (as many as are waiting, up to the size 
+ * of the buffer, in one call) only once these have all been decoded.
+ */
+#define KB_BUF_LEN 1024
+static unsigned char kb_buf[KB_BUF_LEN];
+static int32_t kb_pos;
+static int32_t kb_len;
+
+/* 
+ * Multi-byte key sequences and the single keys that produce commands.
+ * Adding a key takes one line here.  Bytes of an unrecognized sequence 
+ * are treated as typing, except for the first (ESC) byte.
+ */
+typedef struct key_seq_t key_seq_t;
+struct key_seq_t {
+    const char* seq;	/* bytes delivered by the key */
+    cmd_t cmd;		/* resulting command          */
+};
+static const key_seq_t key_seqs[] = {
+    {"`",       CMD_QUIT},	/* backquote is used to quit the game */
+    {"\n",      CMD_TYPED},
+    {"\r",      CMD_TYPED},
+#if (USE_TUX_CONTROLLER == 0) /* use keyboard control with arrow keys */
+    {"\033[A",  CMD_UP},
+    {"\033[B",  CMD_DOWN},
+    {"\033[C",  CMD_RIGHT},
+    {"\033[D",  CMD_LEFT},
+    {"\033[2~", CMD_MOVE_LEFT},	/* insert  */
+    {"\033[1~", CMD_ENTER},		/* home    */
+    {"\033[5~", CMD_MOVE_RIGHT},	/* page up */
+#endif /* USE_TUX_CONTROLLER */
+    {NULL, CMD_NONE}
+};
+
+/* 
+ * Tables for a state machine that recognizes the key sequences, built 
+ * from key_seqs by build_key_states.  State 0 is the start state; 
+ * key_next gives the next state after each byte (0 if the byte does not
+ * continue any sequence), and key_cmd gives the command for states that
+ * complete a sequence (CMD_NONE for others).
+ */
+#define KEY_STATES 32
+static uint8_t key_next[KEY_STATES][256];
+static cmd_t key_cmd[KEY_STATES];
+static int32_t n_key_states;	/* states in use (0 until built) */
+static int32_t key_state;	/* current state                 */
+
+/* 
+ * Counts of bytes read from the keyboard, and of the read calls that 
+ * returned them.
+ */
+static input_stats_t kb_stats;
+
+static int32_t build_key_states (void);
+static void decode_key (unsigned char ch);
+static void read_keyboard (void);
+static void queue_input (cmd_t cmd, char ch);
+
 /* 
  * init_input
  *   DESCRIPTION: Initializes the input controller.  As both keyboard and
@@ -94,6 +177,12 @@ init_input ()
 	ioctl(fd, TUX_INIT, 0);
     struct termios tio_new;
 
+    /* Build the tables for recognizing key sequences. */
+    if (0 != build_key_states ()) {
+	fputs ("too many key sequences\n", stderr);
+	return -1;
+    }
+
     /*
      * Set non-blocking mode so that stdin can be read without blocking
      * when no new keystrokes are available.
@@ -131,6 +220,14 @@ init_input ()
 
 static char typing[MAX_TYPED_LEN + 1] = {'\0'};
 
+/* 
+ * The word trie node reached by the first len characters typed, for each
+ * len: a space starts a new word at the root of the verb trie (if no word
+ * has been typed yet) or of the noun trie.  Deleting a character needs no
+ * work, as the node for the shorter text is already known.
+ */
+static int32_t typed_node[MAX_TYPED_LEN + 1] = {VERB_ROOT};
+
 const char*
 get_typed_command ()
 {
@@ -162,6 +259,43 @@ typed_a_char (char c)
     } else if (MAX_TYPED_LEN > len) {
 	typing[len] = c;
 	typing[len + 1] = '\0';
+	if (' ' != c) {
+	    typed_node[len + 1] = word_step (typed_node[len], c);
+	} else if (VERB_ROOT == typed_node[len]) {
+	    typed_node[len + 1] = VERB_ROOT; /* still before any word */
+	} else {
+	    typed_node[len + 1] = NOUN_ROOT;
+	}
+    }
+}
+
+/* 
+ * get_typed_nodes
+ *   DESCRIPTION: Get the word trie nodes reached by the typed command: the
+ *                node at the end of the first word (the verb), and the 
+ *                node at the end of the word being typed.
+ *   INPUTS: none
+ *   OUTPUTS: *verb -- node reached by the first word, or VERB_ROOT if 
+ *                     nothing but spaces has been typed
+ *            *last -- node reached by the last word
+ *            (either pointer may be NULL if the node is not needed)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+get_typed_nodes (int32_t* verb, int32_t* last)
+{
+    int32_t len;  /* length of typed command */
+    int32_t end;  /* end of first word       */
+
+    len = strlen (typing);
+    for (end = 0; len > end && ' ' == typing[end]; end++);
+    for (; len > end && ' ' != typing[end]; end++);
+    if (NULL != verb) {
+	*verb = typed_node[end];
+    }
+    if (NULL != last) {
+	*last = typed_node[len];
     }
 }
 
@@ -230,127 +364,199 @@ get_tux_cmd()
 	}
 }
 /* 
- * get_command
- *   DESCRIPTION: Reads a command from the input controller.  As some
- *                controllers provide only absolute input (e.g., go
- *                right), the current direction is needed as an input
- *                to this routine.
- *   INPUTS: cur_dir -- current direction of motion
+ * queue_input
+ *   DESCRIPTION: Add a command or a typed character to the end of the
+ *                keyboard input queue.  The caller must check that the 
+ *                queue has room.
+ *   INPUTS: cmd -- the command, or CMD_NONE for a typed character
+ *           ch -- the character typed (ignored for commands)
  *   OUTPUTS: none
- *   RETURN VALUE: command issued by the input controller
- *   SIDE EFFECTS: drains any keyboard input
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: adds to the input queue
  */
-cmd_t 
-get_command ()
+static void
+queue_input (cmd_t cmd, char ch)
 {
-#if (USE_TUX_CONTROLLER == 0) /* use keyboard control with arrow keys */
-    static int state = 0;             /* small FSM for arrow keys */
-#endif
-    static cmd_t command = CMD_NONE;
-    cmd_t pushed = CMD_NONE;
-    int ch;
+    queued_input_t* in = &in_queue[(in_head + in_count) % INPUT_QUEUE_LEN];
 
-    /* Read all characters from stdin. */
-    while ((ch = getc (stdin)) != EOF) {
+    in->cmd = cmd;
+    in->ch = ch;
+    in_count++;
+}
 
-	/* Backquote is used to quit the game. */
-	if (ch == '`')
-	    return CMD_QUIT;
-	
-#if (USE_TUX_CONTROLLER == 0) /* use keyboard control with arrow keys */
+/* 
+ * build_key_states
+ *   DESCRIPTION: Build the state machine tables for recognizing the key
+ *                sequences in key_seqs.  The states form a tree with a
+ *                state for each distinct prefix of the sequences.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 if KEY_STATES is too small
+ *   SIDE EFFECTS: fills in key_next and key_cmd
+ */
+static int32_t
+build_key_states ()
+{
+    const key_seq_t* k;		/* sequence being added      */
+    const unsigned char* b;	/* byte of sequence          */
+    int32_t st;			/* state reached by prefix   */
+
+    memset (key_next, 0, sizeof (key_next));
+    for (st = 0; KEY_STATES > st; st++) {
+	key_cmd[st] = CMD_NONE;
+    }
+    n_key_states = 1;
+    key_state = 0;
+    for (k = key_seqs; NULL != k->seq; k++) {
+	for (st = 0, b = (const unsigned char*)k->seq; '\0' != *b; b++) {
+	    if (0 == key_next[st][*b]) {
+		if (KEY_STATES == n_key_states) {
+		    return -1;
+		}
+		key_next[st][*b] = n_key_states++;
+	    }
+	    st = key_next[st][*b];
+	}
+	key_cmd[st] = k->cmd;
+    }
+    return 0;
+}
+
+/* 
+ * decode_key
+ *   DESCRIPTION: Advance the key sequence state machine by one byte read
+ *                from the keyboard, queueing a command when a sequence is
+ *                complete, or the byte itself if it is valid typing and
+ *                not part of a sequence.  A byte that breaks off a 
+ *                sequence is handled as if no sequence had started.  The
+ *                caller must check that the queue has room.
+ *   INPUTS: ch -- the byte
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may add to the input queue
+ */
+static void
+decode_key (unsigned char ch)
+{
+    int32_t st; /* next state */
+
+    if (0 != key_state && 0 == key_next[key_state][ch]) {
 	/*
-	 * Arrow keys deliver the byte sequence 27, 91, and 'A' to 'D';
-	 * we use a small finite state machine to identify them.
-	 *
-	 * Insert, home, and page up keys deliver 27, 91, '2'/'1'/'5' and
-	 * then a tilde.  We recognize the digits and don't check for the
-	 * tilde.
+	 * Note that we may be discarding an ESC (27) and a bracket (91),
+	 * but we don't use either as typed input anyway.
 	 */
-	switch (state) {
-	    case 0:
-	        if (27 == ch) {
-		    state = 1;
-		} else if (valid_typing (ch)) {
-		    typed_a_char (ch);
-		} else if (10 == ch || 13 == ch) {
-		    pushed = CMD_TYPED;
-		}
-		break;
-	    case 1:
-		if (91 == ch) {
-		    state = 2;
-		} else {
-		    state = 0;
-		    if (valid_typing (ch)) {
-			/*
-			 * Note that we may be discarding an ESC (27), but
-			 * we don't use that as typed input anyway.
-			 */
-			typed_a_char (ch);
-		    } else if (10 == ch || 13 == ch) {
-			pushed = CMD_TYPED;
-		    }
-		}
-		break;
-	    case 2:
-	        if (ch >= 'A' && ch <= 'D') {
-		    switch (ch) {
-			case 'A': pushed = CMD_UP; break;
-			case 'B': pushed = CMD_DOWN; break;
-			case 'C': pushed = CMD_RIGHT; break;
-			case 'D': pushed = CMD_LEFT; break;
-		    }
-		    state = 0;
-		} else if (ch == '1' || ch == '2' || ch == '5') {
-		    switch (ch) {
-			case '2': pushed = CMD_MOVE_LEFT; break;
-			case '1': pushed = CMD_ENTER; break;
-			case '5': pushed = CMD_MOVE_RIGHT; break;
-		    }
-		    state = 3; /* Consume a '~'. */
-		} else {
-		    state = 0;
-		    if (valid_typing (ch)) {
-			/*
-			 * Note that we may be discarding an ESC (27) and 
-			 * a bracket (91), but we don't use either as 
-			 * typed input anyway.
-			 */
-			typed_a_char (ch);
-		    } else if (10 == ch || 13 == ch) {
-			pushed = CMD_TYPED;
-		    }
-		}
-		break;
-	    case 3:
-		state = 0;
-	        if ('~' == ch) {
-		    /* Consume it silently. */
-		} else if (valid_typing (ch)) {
-		    typed_a_char (ch);
-		} else if (10 == ch || 13 == ch) {
-		    pushed = CMD_TYPED;
-		}
-		break;
+        key_state = 0;
+    }
+    if (0 != (st = key_next[key_state][ch])) {
+	if (CMD_NONE != key_cmd[st]) {
+	    queue_input (key_cmd[st], 0);
+	    st = 0;
 	}
-#else /* USE_TUX_CONTROLLER */
-	/* Tux controller mode; still need to support typed commands. */
-	if (valid_typing (ch)) {
-	    typed_a_char (ch);
-	} else if (10 == ch || 13 == ch) {
-	    pushed = CMD_TYPED;
+	key_state = st;
+    } else if (valid_typing (ch)) {
+	queue_input (CMD_NONE, ch);
+    }
+}
+
+/* 
+ * read_keyboard
+ *   DESCRIPTION: Decode the bytes read from the keyboard into the input
+ *                queue until none are left or the queue is full.  When
+ *                all are decoded, reads all waiting bytes from stdin 
+ *                (up to the buffer size) with one call.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drains keyboard input
+ */
+static void
+read_keyboard ()
+{
+    ssize_t got; /* bytes read */
+
+    while (INPUT_QUEUE_LEN > in_count) {
+	if (kb_len == kb_pos) {
+	    if (0 >= (got = read (fileno (stdin), kb_buf, KB_BUF_LEN))) {
+		return;
+	    }
+	    kb_pos = 0;
+	    kb_len = got;
+	    kb_stats.bytes += got;
+	    kb_stats.reads++;
 	}
-#endif /* USE_TUX_CONTROLLER */
+	decode_key (kb_buf[kb_pos++]);
     }
+}
 
-    /*
-     * Once a direction is pushed, that command remains active
-     * until a turn is taken.
-     */
-    if (pushed == CMD_NONE) {
-        command = CMD_NONE;
+/* 
+ * get_command
+ *   DESCRIPTION: Reads the next command from the keyboard, in the order
+ *                in which commands were typed.  Characters typed before
+ *                the command are added to the typed command on the way, 
+ *                so when CMD_TYPED is returned, the typed command holds
+ *                exactly the characters typed before the Enter key.  
+ *                Input after the command stays queued until the next 
+ *                call, so the caller should call again until CMD_NONE is
+ *                returned (or until the command has taken effect, such 
+ *                as after a room change).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: command issued by the keyboard, or CMD_NONE if no
+ *                 commands are waiting
+ *   SIDE EFFECTS: drains keyboard input; changes the typed command
+ */
+cmd_t 
+get_command ()
+{
+    queued_input_t* in; /* oldest queued input */
+
+    while (1) {
+	/* Decode (or read) more input only once the queue is empty. */
+	if (0 == in_count) {
+	    read_keyboard ();
+	    if (0 == in_count) {
+		return CMD_NONE;
+	    }
+	}
+	in = &in_queue[in_head];
+	in_head = (in_head + 1) % INPUT_QUEUE_LEN;
+	in_count--;
+	if (CMD_NONE != in->cmd) {
+	    return in->cmd;
+	}
+	typed_a_char (in->ch);
     }
-    return pushed;
+}
+
+/* 
+ * input_pending
+ *   DESCRIPTION: Check whether keyboard input has been read but not yet
+ *                returned by get_command.  Such input does not make the
+ *                keyboard descriptor readable.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if input is waiting to be decoded or in the queue,
+ *                 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int
+input_pending ()
+{
+    return (0 < in_count || kb_len > kb_pos);
+}
+
+/* 
+ * get_input_stats
+ *   DESCRIPTION: Get counts of bytes read from the keyboard.
+ *   INPUTS: none
+ *   OUTPUTS: stats -- the counts
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+get_input_stats (input_stats_t* stats)
+{
+    *stats = kb_stats;
 }
 
 /* 
@@ -368,6 +574,38 @@ shutdown_input ()
     (void)tcsetattr (fileno (stdin), TCSANOW, &tio_orig);
 }
 
+/* 
+ * get_keyboard_fd
+ *   DESCRIPTION: Get the file descriptor from which keystrokes are read,
+ *                so that the caller can wait for it to become readable
+ *                before calling get_command.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor
+ *   SIDE EFFECTS: none
+ */
+int
+get_keyboard_fd ()
+{
+    return fileno (stdin);
+}
+
+/* 
+ * get_tux_fd
+ *   DESCRIPTION: Get the file descriptor for the Tux controller, which
+ *                becomes readable when the controller's buttons change
+ *                (until get_tux_cmd is next called).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, or -1 if the controller is not open
+ *   SIDE EFFECTS: none
+ */
+int
+get_tux_fd ()
+{
+    return fd;
+}
+
 /* 
  * display_time_on_tux
  *   DESCRIPTION: Show number of elapsed seconds as minutes:seconds
@@ -38,6 +38,8 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <stdint.h>
+
 /* possible commands from input device, whether keyboard or game controller */
 typedef enum {
     CMD_NONE, CMD_RIGHT, CMD_LEFT, CMD_UP, CMD_DOWN,
@@ -49,18 +51,37 @@ typedef enum {
 
 #define MAX_TYPED_LEN 20
 
+/* counts of bytes read from the keyboard, and of the reads returning them */
+typedef struct input_stats_t input_stats_t;
+struct input_stats_t {
+    uint32_t bytes;	/* bytes read             */
+    uint32_t reads;	/* reads returning bytes  */
+};
+
 /* Initialize the input device. */
 extern int init_input ();
 
-/* Read a command from the input device. */
+/* Read the next command typed on the keyboard (CMD_NONE if none). */
 extern cmd_t get_command ();
 
+/* Check whether keyboard input read earlier is waiting for get_command. */
+extern int input_pending ();
+
+/* Get counts of bytes read from the keyboard. */
+extern void get_input_stats (input_stats_t* stats);
+
 /* Get currently typed command string. */
 extern const char* get_typed_command ();
 
 /* Reset typed command. */
 extern void reset_typed_command ();
 
+/* 
+ * Get the word trie nodes (see words.h) reached by the first word and by
+ * the last word of the typed command.
+ */
+extern void get_typed_nodes (int32_t* verb, int32_t* last);
+
 /* Shut down the input device. */
 extern void shutdown_input ();
 
@@ -71,5 +92,12 @@ extern void shutdown_input ();
 extern void display_time_on_tux (int num_seconds);
 
 extern cmd_t get_tux_cmd(); 
+
+/* 
+ * Get descriptors that become readable when keystrokes or Tux controller
+ * button changes are waiting; the latter is -1 if there is no controller.
+ */
+extern int get_keyboard_fd ();
+extern int get_tux_fd ();
 //extern cmd_t get_buttton();
 #endif /* INPUT_H */
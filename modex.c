@@ -41,10 +41,15 @@
  */
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/io.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "modex.h"
@@ -53,8 +58,14 @@
 
 /* 
  * Calculate the image build buffer parameters.  SCROLL_SIZE is the space
- * needed for one plane of an image.  SCREEN_SIZE is the space needed for
- * all four planes.  The extra +1 supports logical view x coordinates that 
+ * needed for one plane of an image on the display.  In the build buffer,
+ * the logical view window is surrounded by a margin of MARGIN_ROWS rows 
+ * above and below and MARGIN_COLS addresses (four pixels each) to the
+ * left and right, which can be drawn ahead of time so that scrolling 
+ * into them needs no drawing (see draw_margin_line).  Each row of the 
+ * build buffer is thus BUILD_X_WIDTH addresses wide, and each plane 
+ * takes BUILD_PLANE_SIZE addresses.  SCREEN_SIZE is the space needed for
+ * all four planes.  The extra +1s support logical view x coordinates that 
  * are not multiples of four.  In these cases, some plane addresses are 
  * shifted by 1 byte forward.  The planes are stored in the build buffer 
  * in reverse order to allow those planes that shift forward to do so 
@@ -69,10 +80,15 @@
  * BUILD_BASE_INIT places initial (or transferred) logical view in the
  * middle of the available buffer area.
  */
-#define SCROLL_SIZE     (SCROLL_X_WIDTH * SCROLL_Y_DIM)
-#define SCREEN_SIZE	(SCROLL_SIZE * 4 + 1)
-#define BUILD_BUF_SIZE  (SCREEN_SIZE + 20000) 
-#define BUILD_BASE_INIT ((BUILD_BUF_SIZE - SCREEN_SIZE) / 2)
+#define SCROLL_SIZE      (SCROLL_X_WIDTH * SCROLL_Y_DIM)
+#define MARGIN_ROWS      16
+#define MARGIN_COLS      4
+#define BUILD_X_WIDTH    (SCROLL_X_WIDTH + 2 * MARGIN_COLS + 1)
+#define BUILD_PLANE_SIZE (BUILD_X_WIDTH * (SCROLL_Y_DIM + 2 * MARGIN_ROWS))
+#define SCREEN_SIZE	 (BUILD_PLANE_SIZE * 4 + 1)
+#define BUILD_BUF_SIZE   (SCREEN_SIZE + 20000) 
+#define BUILD_BASE_INIT  ((BUILD_BUF_SIZE - SCREEN_SIZE) / 2 + \
+			  MARGIN_ROWS * BUILD_X_WIDTH + MARGIN_COLS)
 
 /* Mode X and general VGA parameters */
 #define VID_MEM_SIZE       131072
@@ -143,6 +159,23 @@ static void write_font_data ();
 static void set_text_mode_3 (int clear_scr);
 static void copy_image (unsigned char* img, unsigned short scr_addr);
 static void copy_status_bar (unsigned char* img, unsigned short scr_addr);
+static int start_present_thread ();
+static void stop_present_thread ();
+static void* present_thread (void* ignore);
+static uint64_t usec_now ();
+static void clip_valid (int x0, int y0, int x1, int y1);
+#if !defined(TEXT_RESTORE_PROGRAM)
+static void fill_row (int y);
+static void fill_col (int x);
+static void set_valid_window ();
+static void put_row (int y, const unsigned char* buf);
+static void draw_rows (int part);
+static void start_draw_helpers ();
+static void stop_draw_helpers ();
+static void* draw_helper (void* arg);
+#endif /* !defined(TEXT_RESTORE_PROGRAM) */
+static void write_palette_delta (int first, int count, 
+				 unsigned char rgb[][3]);
 
 
 /* 
@@ -182,11 +215,106 @@ static int img3_off;		    /* offset of upper left pixel   */
 static unsigned char* img3;	    /* pointer to upper left pixel  */
 static int show_x, show_y;          /* logical view coordinates     */
 
+/* 
+ * Set whenever the logical view window moves or new data are drawn into
+ * the build buffer, and cleared by show_screen.  While it is clear, the
+ * screen being displayed is already up to date.
+ */
+static int screen_dirty = 1;        /* build differs from display?  */
+
+/*
+ * The part of the map, in map pixel coordinates (x0 <= x < x1 and 
+ * y0 <= y < y1), for which the build buffer holds correct pixels: the 
+ * logical view window and any margin drawn around it.  The area is 
+ * empty when x0 >= x1, and is clipped whenever the window moves so that
+ * it never extends past the margin.  drawn_x and drawn_y are the window
+ * position when draw_exposed_lines last completed the window (not used by
+ * the text restore program).
+ */
+static int valid_x0, valid_y0, valid_x1, valid_y1;
+#if !defined(TEXT_RESTORE_PROGRAM)
+static int drawn_x, drawn_y;
+#endif /* !defined(TEXT_RESTORE_PROGRAM) */
+
 /* displayed video memory variables */
 static unsigned char* mem_image;    /* pointer to start of video memory */
 static unsigned short target_img;   /* offset of displayed screen image */
 
 
+/* 
+ * Palette management.  The shadow records the colors most recently 
+ * written to the VGA DAC, so that installing a new room palette only
+ * writes those colors that differ from the previous room's.  The shadow
+ * is marked invalid whenever the VGA mode is set, since the mode change
+ * rewrites (some of) the DAC behind our backs.
+ *
+ * The fade ramp holds the room photo colors scaled from black (step 0)
+ * up to full intensity (step PALETTE_FADE_STEPS).  It is rebuilt only 
+ * when a new palette is installed, so stepping through a fade costs
+ * nothing but DAC writes.
+ */
+static unsigned char dac_shadow[256][3];  /* colors last written to DAC */
+static int dac_shadow_valid = 0;          /* is the shadow trustworthy? */
+static unsigned char fade_ramp[PALETTE_FADE_STEPS + 1][192][3];
+static int fade_step = PALETTE_FADE_STEPS; /* current step in ramp      */
+
+
+/* 
+ * Frames are composed by the caller's thread (in show_screen) and put on
+ * the monitor by a separate present thread, which does all writes to
+ * video memory and to the VGA write mask and display start registers 
+ * while in mode X.  Composing a frame copies the logical view window and
+ * the status bar image out of the build buffer, so the caller can go on
+ * drawing the next frame while the present thread uploads this one.
+ *
+ * The frames are passed through a lock-free triple buffer: the composer
+ * owns frame_back and the present thread owns frame_front, while
+ * frame_mid holds the most recently completed frame (with FRAME_FRESH set
+ * if that frame has not yet been taken).  Each side exchanges its frame
+ * for the middle one atomically.  If the present thread falls behind, 
+ * older frames are replaced by newer ones (and counted as dropped) rather
+ * than delaying the composer.  The composer posts frame_sem after each
+ * frame so that the present thread can sleep while there is nothing new.
+ *
+ * Each frame records the versions (screen_seq and status_seq) of the 
+ * screen and status bar images that it holds.  Only images that have
+ * changed since a frame was last used need be copied into it, and only
+ * images that differ from those on the monitor need be uploaded.
+ */
+#define FRAME_FRESH 4
+typedef struct frame_t frame_t;
+struct frame_t {
+    unsigned char planes[4][SCROLL_SIZE];     /* screen, in display planes */
+    unsigned char status[STATUS_BAR_SIZE];    /* status bar image          */
+    uint32_t      screen_seq;                 /* version of planes         */
+    uint32_t      status_seq;                 /* version of status         */
+};
+static frame_t   frames[3];
+static int       frame_back, frame_mid, frame_front;
+static sem_t     frame_sem;
+static pthread_t present_thread_id;
+static int       present_running = 0;     /* present thread started?   */
+static int       present_stop;            /* tells present thread to end */
+static uint32_t  screen_seq, status_seq;  /* current image versions    */
+static uint32_t  sent_screen_seq, sent_status_seq; /* versions composed */
+static render_stats_t render_stats;       /* see get_render_stats      */
+
+
+/* 
+ * Status bar cache.  The image of the status bar is kept between calls,
+ * along with the line of characters it shows and the strings from which
+ * that line was laid out (the cache key).  When the key matches, the bar
+ * on the screen is already up to date.  The cache is marked invalid when
+ * the VGA mode is set, since video memory is cleared.
+ */
+static unsigned char status_buf[STATUS_BAR_SIZE];   /* status bar image */
+static unsigned char status_line[STATUS_BAR_CHARS]; /* characters shown */
+static char status_key_msg[STATUS_BAR_CHARS + 1];   /* key: message     */
+static char status_key_room[STATUS_BAR_CHARS + 1];  /* key: room name   */
+static char status_key_typed[STATUS_BAR_CHARS + 1]; /* key: typed text  */
+static int status_valid = 0;                        /* is cache valid?  */
+
+
 /* 
  * functions provided by the caller to set_mode_X() and used to obtain  
  * graphic images of lines (pixels) to be mapped into the build buffer
@@ -298,6 +426,7 @@ set_mode_X (void (*horiz_fill_fn) (int, int, unsigned char[SCROLL_X_DIM]),
     show_x = show_y = 0;
     img3_off = BUILD_BASE_INIT;
     img3 = build + img3_off + MEM_FENCE_WIDTH;
+    valid_x0 = valid_x1 = 0;
 
     /* Set up the memory fence on the build buffer. */
     for (i = 0; i < MEM_FENCE_WIDTH; i++) {
@@ -330,11 +459,14 @@ set_mode_X (void (*horiz_fill_fn) (int, int, unsigned char[SCROLL_X_DIM]),
     set_attr_registers (mode_X_attr);            /* attribute registers   */
     set_graphics_registers (mode_X_graphics);    /* graphics registers    */
     fill_palette_mode_x ();			 /* palette colors        */
+    dac_shadow_valid = 0;			 /* shadow now unknown    */
+    status_valid = 0;				 /* status bar cleared    */
     clear_screens ();				 /* zero video memory     */
+    screen_dirty = 1;				 /* screen must be shown  */
     VGA_blank (0);			         /* unblank the screen    */
 
-    /* Return success. */
-    return 0;
+    /* Start putting frames on the monitor. */
+    return start_present_thread ();
 }
 
 
@@ -352,6 +484,12 @@ clear_mode_X ()
 {
     int i;   /* loop index for checking memory fence */
     
+    /* Stop putting frames on the monitor and drawing. */
+    stop_present_thread ();
+#if !defined(TEXT_RESTORE_PROGRAM)
+    stop_draw_helpers ();
+#endif /* !defined(TEXT_RESTORE_PROGRAM) */
+
     /* Put VGA into text mode, restore font data, and clear screens. */
     set_text_mode_3 (1);
 
@@ -387,7 +525,7 @@ clear_mode_X ()
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: may shift position of logical view window within build 
- *                 buffer
+ *                 buffer; marks the screen for showing if the window moved
  */   
 void
 set_view_window (int scr_x, int scr_y)
@@ -409,16 +547,25 @@ set_view_window (int scr_x, int scr_y)
     /* Keep track of the new view window. */
     show_x = scr_x;
     show_y = scr_y;
+    if (scr_x != old_x || scr_y != old_y)
+	screen_dirty = 1;
 
     /*
-     * If the new view window fits within the boundaries of the build 
-     * buffer, we need move nothing around.
+     * If the new view window and its margin fit within the boundaries of 
+     * the build buffer, we need move nothing around.  Anything drawn 
+     * beyond the new margin may be overwritten, and so is no longer valid.
     */
-    if (img3_off + (scr_x >> 2) + scr_y * SCROLL_X_WIDTH >= 0 &&
-        img3_off + 3 * SCROLL_SIZE +
-	    ((scr_x + SCROLL_X_DIM - 1) >> 2) + 
-	    (scr_y + SCROLL_Y_DIM - 1) * SCROLL_X_WIDTH < BUILD_BUF_SIZE)
+    if (img3_off + (scr_x >> 2) - MARGIN_COLS + 
+	    (scr_y - MARGIN_ROWS) * BUILD_X_WIDTH >= 0 &&
+        img3_off + 3 * BUILD_PLANE_SIZE +
+	    ((scr_x + SCROLL_X_DIM - 1) >> 2) + MARGIN_COLS + 
+	    (scr_y + SCROLL_Y_DIM - 1 + MARGIN_ROWS) * BUILD_X_WIDTH < 
+	    BUILD_BUF_SIZE) {
+	clip_valid (scr_x - 4 * MARGIN_COLS, scr_y - MARGIN_ROWS,
+		    scr_x + SCROLL_X_DIM + 4 * MARGIN_COLS, 
+		    scr_y + SCROLL_Y_DIM + MARGIN_ROWS);
 	return;
+    }
 
     /*
      * If the new screen does not overlap at all with the old screen, none
@@ -427,8 +574,9 @@ set_view_window (int scr_x, int scr_y)
      */
     if (scr_x <= old_x - SCROLL_X_DIM || scr_x >= old_x + SCROLL_X_DIM ||
 	scr_y <= old_y - SCROLL_Y_DIM || scr_y >= old_y + SCROLL_Y_DIM) {
-	img3_off = BUILD_BASE_INIT - (scr_x >> 2) - scr_y * SCROLL_X_WIDTH;
+	img3_off = BUILD_BASE_INIT - (scr_x >> 2) - scr_y * BUILD_X_WIDTH;
 	img3 = build + img3_off + MEM_FENCE_WIDTH;
+	valid_x0 = valid_x1 = 0;
 	return;
     }
 
@@ -466,14 +614,17 @@ set_view_window (int scr_x, int scr_y)
      * length to be copied is basically the ending offset minus the starting
      * offset plus one (plus the three screens in between planes 3 and 0).
      */
-    start_off = (start_x >> 2) + start_y * SCROLL_X_WIDTH;
+    start_off = (start_x >> 2) + start_y * BUILD_X_WIDTH;
     start_addr = img3 + start_off;
-    length = (end_x >> 2) + end_y * SCROLL_X_WIDTH + 1 - start_off + 
-	     3 * SCROLL_SIZE;
-    img3_off = BUILD_BASE_INIT - (show_x >> 2) - show_y * SCROLL_X_WIDTH;
+    length = (end_x >> 2) + end_y * BUILD_X_WIDTH + 1 - start_off + 
+	     3 * BUILD_PLANE_SIZE;
+    img3_off = BUILD_BASE_INIT - (show_x >> 2) - show_y * BUILD_X_WIDTH;
     img3 = build + img3_off + MEM_FENCE_WIDTH;
     target_addr = img3 + start_off;
 
+    /* Only the part of both screens that was valid is kept. */
+    clip_valid (start_x, start_y, end_x + 1, end_y + 1);
+
     /* 
      * Copy the relevant portion of the screen from the old location to the
      * new one.  The areas may overlap, so copy direction is important. 
@@ -490,89 +641,357 @@ set_view_window (int scr_x, int scr_y)
 
 /*
  * show_screen
- *   DESCRIPTION: Show the logical view window on the video display
+ *   DESCRIPTION: Show the logical view window and the status bar on the 
+ *                video display.  The images are copied into a frame, which
+ *                is handed to the present thread to be put on the monitor.
+ *                If the window has not moved, nothing has been drawn, and
+ *                the status bar has not changed since the last call, the
+ *                last frame is still correct, and nothing is done.
  *   INPUTS: none
  *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: copies from the build buffer to video memory;
- *                 shifts the VGA display source to point to the new image
+ *   RETURN VALUE: 1 if a new frame was composed, 0 if nothing was done
+ *   SIDE EFFECTS: copies from the build buffer into a frame; wakes the
+ *                 present thread
  */   
-void
+int
 show_screen ()
 {
     unsigned char* addr;  /* source address for copy             */
+    unsigned char* src;   /* source address of plane             */
     int p_off;            /* plane offset of first display plane */
     int i;		  /* loop index over video planes        */
+    int y;		  /* loop index over rows                */
+    frame_t* f;           /* frame being composed                */
+    uint64_t start;       /* time at which composition started   */
+    int old;              /* frame given back by triple buffer   */
+
+    /* Skip the frame if the display is already up to date. */
+    if (screen_dirty) {
+	screen_seq++;
+	screen_dirty = 0;
+    }
+    if (screen_seq == sent_screen_seq && status_seq == sent_status_seq)
+	return 0;
+    start = usec_now ();
+    f = &frames[frame_back];
+
+    if (f->screen_seq != screen_seq) {
+	/* 
+	 * Calculate offset of build buffer plane to be mapped into plane 0 
+	 * of display.
+	 */
+	p_off = (3 - (show_x & 3));
+
+	/* Calculate the source address. */
+	addr = img3 + (show_x >> 2) + show_y * BUILD_X_WIDTH;
+
+	/* Copy each plane in display order, skipping the margins. */
+	for (i = 0; i < 4; i++) {
+	    src = addr + ((p_off - i + 4) & 3) * BUILD_PLANE_SIZE + (p_off < i);
+	    for (y = 0; y < SCROLL_Y_DIM; y++) {
+		memcpy (f->planes[i] + y * SCROLL_X_WIDTH, 
+			src + y * BUILD_X_WIDTH, SCROLL_X_WIDTH);
+	    }
+	}
+	f->screen_seq = screen_seq;
+    }
+    if (f->status_seq != status_seq) {
+	memcpy (f->status, status_buf, STATUS_BAR_SIZE);
+	f->status_seq = status_seq;
+    }
+    sent_screen_seq = screen_seq;
+    sent_status_seq = status_seq;
 
     /* 
-     * Calculate offset of build buffer plane to be mapped into plane 0 
-     * of display.
+     * Publish the frame, taking back the middle one.  If that one was 
+     * never presented, it has been dropped.
      */
-    p_off = (3 - (show_x & 3));
+    old = __atomic_exchange_n (&frame_mid, frame_back | FRAME_FRESH, 
+			       __ATOMIC_ACQ_REL);
+    if (old & FRAME_FRESH)
+	render_stats.dropped++;
+    frame_back = (old & ~FRAME_FRESH);
+    (void)sem_post (&frame_sem);
+
+    render_stats.composed++;
+    render_stats.compose_usec += usec_now () - start;
+    return 1;
+}
 
-    /* Switch to the other target screen in video memory. */
-    target_img ^= 0x4000;
 
-    /* Calculate the source address. */
-    addr = img3 + (show_x >> 2) + show_y * SCROLL_X_WIDTH;
+/*
+ * get_render_stats
+ *   DESCRIPTION: Get counts and timings for frame composition and 
+ *                presentation.  Presentation figures are only stable once
+ *                mode X has been cleared (stopping the present thread).
+ *   INPUTS: none
+ *   OUTPUTS: *stats -- the statistics
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+void
+get_render_stats (render_stats_t* stats)
+{
+    *stats = render_stats;
+}
 
-    /* Draw to each plane in the video memory. */
-    for (i = 0; i < 4; i++) {
-	SET_WRITE_MASK (1 << (i + 8));
-	copy_image (addr + ((p_off - i + 4) & 3) * SCROLL_SIZE + (p_off < i), 
-	            target_img);
-    }
+
+/*
+ * start_present_thread
+ *   DESCRIPTION: Reset the frames and start the present thread.  Must be
+ *                called after obtaining port permissions, which the new
+ *                thread inherits.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: prints an error message to stdout on failure
+ */   
+static int
+start_present_thread ()
+{
+    int i; /* loop index over frames */
 
     /* 
-     * Change the VGA registers to point the top left of the screen
-     * to the video memory that we just filled.
+     * Video memory was just cleared, so mark every frame as holding no 
+     * image, and force the first frame to be shown.
      */
-    OUTW (0x03D4, (target_img & 0xFF00) | 0x0C);
-    OUTW (0x03D4, ((target_img & 0x00FF) << 8) | 0x0D);
+    for (i = 0; i < 3; i++) {
+	frames[i].screen_seq = frames[i].status_seq = 0;
+    }
+    screen_seq = status_seq = 1;
+    sent_screen_seq = sent_status_seq = 0;
+    frame_back = 0;
+    frame_mid = 1;
+    frame_front = 2;
+    present_stop = 0;
+
+    if (present_running)
+	return 0;
+    if (0 != sem_init (&frame_sem, 0, 0)) {
+	perror ("sem_init");
+	return -1;
+    }
+    if (0 != pthread_create (&present_thread_id, NULL, present_thread, NULL)) {
+	puts ("cannot create present thread");
+	(void)sem_destroy (&frame_sem);
+	return -1;
+    }
+    present_running = 1;
+    return 0;
+}
+
+
+/*
+ * stop_present_thread
+ *   DESCRIPTION: Stop the present thread and wait for it to finish.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+stop_present_thread ()
+{
+    if (!present_running)
+	return;
+    __atomic_store_n (&present_stop, 1, __ATOMIC_RELEASE);
+    (void)sem_post (&frame_sem);
+    (void)pthread_join (present_thread_id, NULL);
+    (void)sem_destroy (&frame_sem);
+    present_running = 0;
+}
+
+
+/*
+ * present_thread
+ *   DESCRIPTION: Thread function that puts frames on the monitor.  Waits
+ *                for a new frame, takes the newest one from the triple
+ *                buffer, and uploads whichever of its screen and status
+ *                bar images differ from those already on the monitor.  The
+ *                screen goes to the video memory page not being displayed,
+ *                after which the display is switched to that page.
+ *   INPUTS: none (ignored)
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: writes to video memory and VGA registers
+ */   
+static void*
+present_thread (void* ignore)
+{
+    uint32_t shown_screen = 0; /* screen version on the monitor */
+    uint32_t shown_status = 0; /* status version on the monitor */
+    frame_t* f;                /* frame being presented         */
+    uint64_t start;            /* time at which upload started  */
+    uint64_t took;             /* time taken by upload          */
+    int i;		       /* loop index over video planes  */
+
+    while (1) {
+	while (0 != sem_wait (&frame_sem)) {
+	    /* interrupted by a signal; wait again */
+	}
+	if (__atomic_load_n (&present_stop, __ATOMIC_ACQUIRE))
+	    break;
+	if (!(__atomic_load_n (&frame_mid, __ATOMIC_ACQUIRE) & FRAME_FRESH))
+	    continue;
+	frame_front = (__atomic_exchange_n (&frame_mid, frame_front, 
+					    __ATOMIC_ACQ_REL) & ~FRAME_FRESH);
+	f = &frames[frame_front];
+	start = usec_now ();
+
+	if (f->screen_seq != shown_screen) {
+	    /* Switch to the other target screen in video memory. */
+	    target_img ^= 0x4000;
+
+	    /* Draw to each plane in the video memory. */
+	    for (i = 0; i < 4; i++) {
+		SET_WRITE_MASK (1 << (i + 8));
+		copy_image (f->planes[i], target_img);
+	    }
+
+	    /* 
+	     * Change the VGA registers to point the top left of the screen
+	     * to the video memory that we just filled.
+	     */
+	    OUTW (0x03D4, (target_img & 0xFF00) | 0x0C);
+	    OUTW (0x03D4, ((target_img & 0x00FF) << 8) | 0x0D);
+	    shown_screen = f->screen_seq;
+	}
+
+	if (f->status_seq != shown_status) {
+	    /* Draw the status bar on each plane of the video memory. */
+	    for (i = 0; i < 4; i++) {
+		SET_WRITE_MASK (1 << (i + 8));
+		copy_status_bar (f->status + STATUS_BAR_SIZE / 4 * i, 0);
+	    }
+	    shown_status = f->status_seq;
+	}
+
+	took = usec_now () - start;
+	render_stats.presented++;
+	render_stats.present_usec += took;
+	if (render_stats.present_max_usec < took)
+	    render_stats.present_max_usec = took;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * usec_now
+ *   DESCRIPTION: Read the monotonic clock (for timing).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: current time in microseconds
+ *   SIDE EFFECTS: none
+ */   
+static uint64_t
+usec_now ()
+{
+    struct timespec ts; /* current time */
+
+    (void)clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/*
+ * clip_valid
+ *   DESCRIPTION: Reduce the part of the map held correctly in the build
+ *                buffer to its intersection with a rectangle.
+ *   INPUTS: (x0,y0) -- upper left corner of rectangle (map pixels)
+ *           (x1,y1) -- lower right corner (exclusive) of rectangle
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+clip_valid (int x0, int y0, int x1, int y1)
+{
+    if (valid_x0 < x0)
+	valid_x0 = x0;
+    if (valid_y0 < y0)
+	valid_y0 = y0;
+    if (valid_x1 > x1)
+	valid_x1 = x1;
+    if (valid_y1 > y1)
+	valid_y1 = y1;
+    if (valid_x0 >= valid_x1 || valid_y0 >= valid_y1)
+	valid_x0 = valid_x1 = valid_y0 = valid_y1 = 0;
 }
 
 /*
  * show_status_bar
- *   DESCRIPTION: displays a colored status bar on the screen with a message on it 
+ *   DESCRIPTION: displays a colored status bar on the screen with a message on it.
+ *                The image of the bar is cached along with the text that produced it:
+ *                when nothing changed since the last call, nothing is drawn or copied,
+ *                and otherwise only the character cells that changed are redrawn.
+ *                The new image goes to the monitor with the next show_screen.
  *   INPUTS:message: the status message to be displayed (if not NULL)
             room_info: the room name of the current vi
             srtual room we are in - has to be printed
             ptr: the data that is being typed onto the screen by the user  
  *   OUTPUTS: none
- *   RETURN VALUE: none
+ *   RETURN VALUE: 1 if the image of the bar changed, 0 if not
  *   SIDE EFFECTS: displays the status bar, and fills all the 5740m pixels in it will color 
  *                 
  */   
-void
+int
 show_status_bar(const char* message, const char* room_info, const char *ptr )
 {
-    int c;
-    int status_pixels = 5760; 
-    int plane_no = 4;
+    unsigned char line[STATUS_BAR_CHARS]; /* characters now in the bar */
+    int changed; 
     int i;		  
-    unsigned char buff[status_pixels];
-    for(i=0 ; i< status_pixels; i++){
-        buff[i] = 11; // pusing the buffer, it colors all the pixels o the status bar 
+
+    /* 
+     * If the text is the same as last time, the bar on the screen is 
+     * already correct.
+     */
+    if (status_valid && 0 == strcmp (message, status_key_msg) &&
+	0 == strcmp (room_info, status_key_room) &&
+	0 == strcmp (ptr, status_key_typed)) {
+	return 0;
     }
-    
+    strncpy (status_key_msg, message, STATUS_BAR_CHARS);
+    strncpy (status_key_room, room_info, STATUS_BAR_CHARS);
+    strncpy (status_key_typed, ptr, STATUS_BAR_CHARS);
+
     if(strlen(message) == 0){
-        c = 1; 
-        print_text(room_info, buff, c, ptr); // calls print_text to print out the room name      
+        layout_status_text(room_info, 1, ptr, line); // lays out the room name and typed text 
     }
 
     else{
-        c = 0; 
-        print_text(message, buff, c, ptr); // calls print_text to print out the status message
+        layout_status_text(message, 0, ptr, line); // lays out the status message
 
     }
 
-    //draws the status bar on each plane of the video memory 
-    for (i = 0; i < plane_no; i++) {
-	SET_WRITE_MASK (1 << (i + 8));
-	copy_status_bar (buff + status_pixels/plane_no*i , 0);
+    /* After a mode change, the whole bar must be redrawn. */
+    if (!status_valid) {
+        memset (status_buf, STATUS_BG_COLOR, STATUS_BAR_SIZE); // colors all the pixels of the status bar 
+	for (i = 0; STATUS_BAR_CHARS > i; i++) {
+	    print_char_cell (status_buf, i, line[i]);
+	}
+	memcpy (status_line, line, STATUS_BAR_CHARS);
+	status_valid = 1;
+	changed = 1;
+    } else {
+	/* Redraw only the character cells that changed. */
+	changed = 0;
+	for (i = 0; STATUS_BAR_CHARS > i; i++) {
+	    if (line[i] != status_line[i]) {
+		print_char_cell (status_buf, i, line[i]);
+		status_line[i] = line[i];
+		changed = 1;
+	    }
+	}
+    }
+    if (!changed) {
+        return 0;
     }
 
-
+    /* A new version of the status bar image must be shown. */
+    status_seq++;
+    return 1;
 }
 
 
@@ -595,6 +1014,25 @@ clear_screens ()
 }
 
 
+/* 
+ * The helper threads used by draw_all_lines to redraw the whole view 
+ * window in parallel.  Helpers wait on draw_cv for draw_gen to change,
+ * each draws its band of rows, and the last one to finish signals 
+ * draw_done_cv.  All of these variables are protected by draw_lock.
+ */
+#if !defined(TEXT_RESTORE_PROGRAM)
+#define N_DRAW_THREADS 4   /* threads drawing a full redraw (with caller) */
+static pthread_t       draw_thread_id[N_DRAW_THREADS - 1];
+static int             n_draw_helpers = -1; /* helpers running (-1: none) */
+static pthread_mutex_t draw_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  draw_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  draw_done_cv = PTHREAD_COND_INITIALIZER;
+static unsigned int    draw_gen;    /* count of redraws started       */
+static int             draw_busy;   /* helpers still drawing          */
+static int             draw_stop;   /* tells helpers to end           */
+#endif /* !defined(TEXT_RESTORE_PROGRAM) */
+
+
 /* 
  * The functions inside the preprocessor block below rely on functions
  * in maze.c to generate graphical images of the maze.  These functions
@@ -621,39 +1059,16 @@ clear_screens ()
 int
 draw_vert_line (int x)
 {
-    /* to be written... */
-    unsigned char buf[SCROLL_Y_DIM]; /* buffer for graphical image of line */
-    unsigned char* addr;             /* address of first pixel in build    */
-   				     /*     buffer (without plane offset)  */
-    int p_off;                       /* offset of plane of first pixel     */
-    int i;			     /* loop index over pixels             */
-
     /* Check whether requested line falls in the logical view window. */
     if (x < 0 || x >= SCROLL_X_DIM)
 	return -1;
 
-    /* Adjust y to the logical row value. */
+    /* Adjust x to the logical column value. */
     x += show_x;
 
-    /* Get the image of the line. */
-    (*vert_line_fn) (x, show_y, buf);
-
-    /* Calculate starting address in build buffer. */
-    addr = img3 + (x >> 2) + show_y * SCROLL_X_WIDTH;
-
-    /* Calculate plane offset of first pixel. */
-    p_off = (3 - (x & 3));
-
-    /* Copy image data into appropriate planes in build buffer. */
-    for (i = 0; i < SCROLL_Y_DIM; i++) {
-        addr[p_off * SCROLL_SIZE] = buf[i];
-        addr += SCROLL_X_WIDTH; 
-
-	// if (--p_off < 0) {
-	//     p_off = 3;
-	//     addr++;
-	// }
-    }
+    /* Draw the line. */
+    fill_col (x);
+    screen_dirty = 1;
 
     /* Return success. */
     return 0;
@@ -676,12 +1091,6 @@ draw_vert_line (int x)
 int
 draw_horiz_line (int y)
 {
-    unsigned char buf[SCROLL_X_DIM]; /* buffer for graphical image of line */
-    unsigned char* addr;             /* address of first pixel in build    */
-   				     /*     buffer (without plane offset)  */
-    int p_off;                       /* offset of plane of first pixel     */
-    int i;			     /* loop index over pixels             */
-
     /* Check whether requested line falls in the logical view window. */
     if (y < 0 || y >= SCROLL_Y_DIM)
 	return -1;
@@ -689,26 +1098,441 @@ draw_horiz_line (int y)
     /* Adjust y to the logical row value. */
     y += show_y;
 
-    /* Get the image of the line. */
+    /* Draw the line. */
+    fill_row (y);
+    screen_dirty = 1;
+
+    /* Return success. */
+    return 0;
+}
+
+
+/*
+ * draw_all_lines
+ *   DESCRIPTION: Draw every horizontal line of the logical view window 
+ *                into the build buffer.  The lines are split into bands
+ *                that are drawn at the same time by the caller and by a 
+ *                small pool of helper threads (started on first use), so
+ *                the line image function must be safe to call from several
+ *                threads at once.  Returns once all lines are drawn.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+void
+draw_all_lines ()
+{
+    if (0 > n_draw_helpers)
+	start_draw_helpers ();
+
+    /* Hand a band of lines to each helper... */
+    (void)pthread_mutex_lock (&draw_lock);
+    draw_gen++;
+    draw_busy = n_draw_helpers;
+    (void)pthread_cond_broadcast (&draw_cv);
+    (void)pthread_mutex_unlock (&draw_lock);
+
+    /* ...draw the first band ourselves... */
+    draw_rows (0);
+
+    /* ...and wait for the helpers to finish. */
+    (void)pthread_mutex_lock (&draw_lock);
+    while (0 != draw_busy) {
+	(void)pthread_cond_wait (&draw_done_cv, &draw_lock);
+    }
+    (void)pthread_mutex_unlock (&draw_lock);
+
+    screen_dirty = 1;
+    set_valid_window ();
+}
+
+
+/*
+ * draw_full_image
+ *   DESCRIPTION: Draw a ready-made image of the whole logical view window
+ *                into the build buffer, in place of calling the line 
+ *                image function for each line.
+ *   INPUTS: img -- SCROLL_Y_DIM rows of SCROLL_X_DIM pixels each, showing
+ *                  the view window at its current position
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+void
+draw_full_image (const unsigned char* img)
+{
+    int y; /* index over rows */
+
+    for (y = 0; SCROLL_Y_DIM > y; y++) {
+	put_row (show_y + y, img + y * SCROLL_X_DIM);
+    }
+    screen_dirty = 1;
+    set_valid_window ();
+}
+
+
+/*
+ * draw_exposed_lines
+ *   DESCRIPTION: Complete the logical view window after it has moved, by 
+ *                drawing those lines of it that are not already held in 
+ *                the build buffer (because they were on the screen or in
+ *                the margin before the move).  Lines exposed by the move
+ *                that were found in the margin count as margin hits, and 
+ *                those that had to be drawn count as misses.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+void
+draw_exposed_lines ()
+{
+    int exposed; /* number of lines exposed by moves */
+    int drawn;   /* number of lines drawn            */
+    int i;       /* index over lines                 */
+
+    exposed = abs (show_x - drawn_x) + abs (show_y - drawn_y);
+    if (valid_x0 <= show_x && valid_x1 >= show_x + SCROLL_X_DIM &&
+	valid_y0 < show_y + SCROLL_Y_DIM && valid_y1 > show_y) {
+	/* Draw any rows missing above or below the valid area. */
+	drawn = 0;
+	for (i = show_y; valid_y0 > i; i++, drawn++) {
+	    fill_row (i);
+	}
+	for (i = valid_y1; show_y + SCROLL_Y_DIM > i; i++, drawn++) {
+	    fill_row (i);
+	}
+	if (valid_y0 > show_y) {
+	    valid_y0 = show_y;
+	}
+	if (valid_y1 < show_y + SCROLL_Y_DIM) {
+	    valid_y1 = show_y + SCROLL_Y_DIM;
+	}
+	valid_x0 = show_x;
+	valid_x1 = show_x + SCROLL_X_DIM;
+    } else if (valid_y0 <= show_y && valid_y1 >= show_y + SCROLL_Y_DIM &&
+	       valid_x0 < show_x + SCROLL_X_DIM && valid_x1 > show_x) {
+	/* Draw any columns missing to the left or right. */
+	drawn = 0;
+	for (i = show_x; valid_x0 > i; i++, drawn++) {
+	    fill_col (i);
+	}
+	for (i = valid_x1; show_x + SCROLL_X_DIM > i; i++, drawn++) {
+	    fill_col (i);
+	}
+	if (valid_x0 > show_x) {
+	    valid_x0 = show_x;
+	}
+	if (valid_x1 < show_x + SCROLL_X_DIM) {
+	    valid_x1 = show_x + SCROLL_X_DIM;
+	}
+	valid_y0 = show_y;
+	valid_y1 = show_y + SCROLL_Y_DIM;
+    } else {
+	/* Too little is left to be worth keeping. */
+	draw_all_lines ();
+	drawn = SCROLL_Y_DIM;
+    }
+
+    if (exposed < drawn) {
+	exposed = drawn;
+    }
+    render_stats.margin_hits += exposed - drawn;
+    render_stats.margin_misses += drawn;
+    if (0 != drawn) {
+	screen_dirty = 1;
+    }
+    drawn_x = show_x;
+    drawn_y = show_y;
+}
+
+
+/*
+ * draw_margin_line
+ *   DESCRIPTION: Draw one more line of the margin around the logical view
+ *                window, on the given side, so that a later move in that
+ *                direction finds the line already drawn.  Only a margin on
+ *                one side is kept at a time: drawing above or below gives
+ *                up any margin to the left or right, and vice versa.  
+ *                Nothing is drawn unless the window is complete (see
+ *                draw_exposed_lines).  The screen is not changed.
+ *   INPUTS: dir -- side of window on which to draw (MARGIN_*)
+ *           limit -- map coordinate of edge of photo on that side; lines
+ *                    at or past the limit are not drawn (the top and left 
+ *                    edges are always at 0)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a line was drawn, 0 if the margin is full
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+int
+draw_margin_line (int dir, int limit)
+{
+    /* The window itself must be complete. */
+    if (valid_x0 > show_x || valid_x1 < show_x + SCROLL_X_DIM ||
+	valid_y0 > show_y || valid_y1 < show_y + SCROLL_Y_DIM)
+	return 0;
+
+    switch (dir) {
+	case MARGIN_UP:
+	    if (valid_y0 <= show_y - MARGIN_ROWS || valid_y0 <= 0)
+		return 0;
+	    valid_x0 = show_x;
+	    valid_x1 = show_x + SCROLL_X_DIM;
+	    fill_row (--valid_y0);
+	    return 1;
+	case MARGIN_DOWN:
+	    if (valid_y1 >= show_y + SCROLL_Y_DIM + MARGIN_ROWS || 
+		valid_y1 >= limit)
+		return 0;
+	    valid_x0 = show_x;
+	    valid_x1 = show_x + SCROLL_X_DIM;
+	    fill_row (valid_y1++);
+	    return 1;
+	case MARGIN_LEFT:
+	    if (valid_x0 <= show_x - 4 * MARGIN_COLS || valid_x0 <= 0)
+		return 0;
+	    valid_y0 = show_y;
+	    valid_y1 = show_y + SCROLL_Y_DIM;
+	    fill_col (--valid_x0);
+	    return 1;
+	case MARGIN_RIGHT:
+	    if (valid_x1 >= show_x + SCROLL_X_DIM + 4 * MARGIN_COLS || 
+		valid_x1 >= limit)
+		return 0;
+	    valid_y0 = show_y;
+	    valid_y1 = show_y + SCROLL_Y_DIM;
+	    fill_col (valid_x1++);
+	    return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * fill_row
+ *   DESCRIPTION: Draw one logical row of the view window into the build
+ *                buffer.  Different rows write disjoint bytes of the build
+ *                buffer (where consecutive rows share a byte address, they
+ *                use different planes), so rows may be drawn in parallel.
+ *   INPUTS: y -- the logical row (map pixel y coordinate) to be drawn
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+static void
+fill_row (int y)
+{
+    unsigned char buf[SCROLL_X_DIM]; /* buffer for graphical image of line */
+
+    /* Get the image of the line and copy it into the build buffer. */
     (*horiz_line_fn) (show_x, y, buf);
+    put_row (y, buf);
+}
+
+
+/*
+ * put_row
+ *   DESCRIPTION: Copy the image of one logical row of the view window 
+ *                into the appropriate planes of the build buffer.
+ *   INPUTS: y -- the logical row (map pixel y coordinate) to be copied
+ *           buf -- image of the row (SCROLL_X_DIM pixels)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+static void
+put_row (int y, const unsigned char* buf)
+{
+    unsigned char* addr;             /* address of first pixel in build    */
+   				     /*     buffer (without plane offset)  */
+    int p_off;                       /* offset of plane of first pixel     */
+    int i;			     /* loop index over pixels             */
 
     /* Calculate starting address in build buffer. */
-    addr = img3 + (show_x >> 2) + y * SCROLL_X_WIDTH;
+    addr = img3 + (show_x >> 2) + y * BUILD_X_WIDTH;
 
     /* Calculate plane offset of first pixel. */
     p_off = (3 - (show_x & 3));
 
     /* Copy image data into appropriate planes in build buffer. */
     for (i = 0; i < SCROLL_X_DIM; i++) {
-        addr[p_off * SCROLL_SIZE] = buf[i];
+        addr[p_off * BUILD_PLANE_SIZE] = buf[i];
 	if (--p_off < 0) {
 	    p_off = 3;
 	    addr++;
 	}
     }
+}
 
-    /* Return success. */
-    return 0;
+
+/*
+ * set_valid_window
+ *   DESCRIPTION: Record that the build buffer holds the whole logical view
+ *                window (and nothing drawn around it).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+set_valid_window ()
+{
+    valid_x0 = drawn_x = show_x;
+    valid_y0 = drawn_y = show_y;
+    valid_x1 = show_x + SCROLL_X_DIM;
+    valid_y1 = show_y + SCROLL_Y_DIM;
+}
+
+
+/*
+ * fill_col
+ *   DESCRIPTION: Draw one logical column of the view window into the 
+ *                build buffer.
+ *   INPUTS: x -- the logical column (map pixel x coordinate) to be drawn
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+static void
+fill_col (int x)
+{
+    unsigned char buf[SCROLL_Y_DIM]; /* buffer for graphical image of line */
+    unsigned char* addr;             /* address of first pixel in build    */
+   				     /*     buffer (with plane offset)     */
+    int i;			     /* loop index over pixels             */
+
+    /* Get the image of the line. */
+    (*vert_line_fn) (x, show_y, buf);
+
+    /* Calculate starting address in build buffer. */
+    addr = img3 + (x >> 2) + show_y * BUILD_X_WIDTH + 
+	   (3 - (x & 3)) * BUILD_PLANE_SIZE;
+
+    /* Copy image data into the pixel's plane in build buffer. */
+    for (i = 0; i < SCROLL_Y_DIM; i++) {
+        *addr = buf[i];
+        addr += BUILD_X_WIDTH; 
+    }
+}
+
+
+/*
+ * draw_rows
+ *   DESCRIPTION: Draw one band of rows of the view window for 
+ *                draw_all_lines.  The rows are split into one contiguous
+ *                band for the caller and each helper thread.
+ *   INPUTS: part -- band number (0 for the caller, 1... for helpers)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+static void
+draw_rows (int part)
+{
+    int n_parts; /* number of bands          */
+    int y;       /* index over rows in band  */
+    int end;     /* row after end of band    */
+
+    n_parts = n_draw_helpers + 1;
+    end = (part + 1) * SCROLL_Y_DIM / n_parts;
+    for (y = part * SCROLL_Y_DIM / n_parts; y < end; y++) {
+	fill_row (show_y + y);
+    }
+}
+
+
+/*
+ * start_draw_helpers
+ *   DESCRIPTION: Start the helper threads for draw_all_lines.  If some 
+ *                cannot be started, the work is shared among those that 
+ *                could (if none, the caller draws all lines).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+start_draw_helpers ()
+{
+    int i; /* index over helpers */
+
+    draw_gen = 0;
+    draw_stop = 0;
+    for (i = 0; N_DRAW_THREADS - 1 > i; i++) {
+	if (0 != pthread_create (&draw_thread_id[i], NULL, draw_helper,
+				 (void*)(long)(i + 1))) {
+	    break;
+	}
+    }
+    n_draw_helpers = i;
+}
+
+
+/*
+ * stop_draw_helpers
+ *   DESCRIPTION: Stop the helper threads for draw_all_lines and wait for 
+ *                them to finish.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+static void
+stop_draw_helpers ()
+{
+    int i; /* index over helpers */
+
+    if (0 > n_draw_helpers)
+	return;
+    (void)pthread_mutex_lock (&draw_lock);
+    draw_stop = 1;
+    (void)pthread_cond_broadcast (&draw_cv);
+    (void)pthread_mutex_unlock (&draw_lock);
+    for (i = 0; n_draw_helpers > i; i++) {
+	(void)pthread_join (draw_thread_id[i], NULL);
+    }
+    n_draw_helpers = -1;
+}
+
+
+/*
+ * draw_helper
+ *   DESCRIPTION: Thread function for a draw_all_lines helper.  Waits for
+ *                each new redraw, draws its band of rows, and reports back.
+ *   INPUTS: arg -- band number of this helper (1 or more)
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: draws into the build buffer
+ */   
+static void*
+draw_helper (void* arg)
+{
+    int part = (int)(long)arg; /* band drawn by this helper */
+    unsigned int seen = 0;     /* last redraw handled       */
+
+    while (1) {
+	(void)pthread_mutex_lock (&draw_lock);
+	while (seen == draw_gen && !draw_stop) {
+	    (void)pthread_cond_wait (&draw_cv, &draw_lock);
+	}
+	if (draw_stop) {
+	    (void)pthread_mutex_unlock (&draw_lock);
+	    break;
+	}
+	seen = draw_gen;
+	(void)pthread_mutex_unlock (&draw_lock);
+
+	draw_rows (part);
+
+	(void)pthread_mutex_lock (&draw_lock);
+	if (0 == --draw_busy) {
+	    (void)pthread_cond_signal (&draw_done_cv);
+	}
+	(void)pthread_mutex_unlock (&draw_lock);
+    }
+
+    return NULL;
 }
 
 #endif /* !defined(TEXT_RESTORE_PROGRAM) */
@@ -975,20 +1799,157 @@ fill_palette_text ()
 
 /*
  * set_palette
- *   DESCRIPTION: Set the VGA palette with an array of RGB color values.
- *   INPUTS:
- *     p - Pointer to a 2D array containing RGB color values (192 colors).
- *   OUTPUTS: Changes the VGA palette colors.
- *   RETURN VALUE: None
- *   SIDE EFFECTS: Updates the VGA palette with the specified RGB values.
+ *   DESCRIPTION: Install a new set of room photo colors (palette entries
+ *                64 to 255).  The fade ramp for the colors is rebuilt,
+ *                and the step of the ramp currently in effect (normally
+ *                full intensity) is written to the VGA.  Only colors that
+ *                differ from those already in the DAC are written.
+ *   INPUTS: p -- the 192 6-bit RGB colors for the room photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors 64 to 255; rebuilds fade ramp
+ */
+void
+set_palette (unsigned char p[192][3])
+{
+    /* Scale the colors for each step of the fade ramp. */
+    make_fade_ramp ((const unsigned char (*)[3])p, fade_ramp);
+
+    /* Write whatever changed at the current fade step. */
+    write_palette_delta (64, 192, fade_ramp[fade_step]);
+}
+
+
+/*
+ * set_palette_ramp
+ *   DESCRIPTION: Install a new set of room photo colors (palette entries
+ *                64 to 255) from a fade ramp already built by 
+ *                make_fade_ramp.  Otherwise the same as set_palette.
+ *   INPUTS: ramp -- the fade ramp for the room photo colors
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors 64 to 255; replaces fade ramp
  */
+void
+set_palette_ramp (const unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+    (void)memcpy (fade_ramp, ramp, sizeof (fade_ramp));
+    write_palette_delta (64, 192, fade_ramp[fade_step]);
+}
 
-void set_palette(unsigned char p[192][3]){
-        OUTB (0x03C8 , 0x40);
-        REP_OUTSB(0x03C9 , p, 193*3);
+
+/*
+ * make_fade_ramp
+ *   DESCRIPTION: Build the fade ramp for a set of room photo colors: step
+ *                0 is black, and step PALETTE_FADE_STEPS is the colors
+ *                themselves.  Touches no VGA or module state, so it may be
+ *                called from any thread.
+ *   INPUTS: p -- the 192 6-bit RGB colors for the room photo
+ *   OUTPUTS: ramp -- the fade ramp
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+make_fade_ramp (const unsigned char p[192][3], 
+		unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+    int step; /* loop index over fade ramp steps */
+    int i;    /* loop index over colors          */
+    int c;    /* loop index over RGB components  */
+
+    for (step = 0; PALETTE_FADE_STEPS >= step; step++) {
+	for (i = 0; 192 > i; i++) {
+	    for (c = 0; 3 > c; c++) {
+		ramp[step][i][c] = (p[i][c] * step) / PALETTE_FADE_STEPS;
+	    }
+	}
     }
+}
 
 
+/*
+ * set_palette_fade
+ *   DESCRIPTION: Move the room photo colors to a given step of the fade
+ *                ramp built by the last call to set_palette.  Only colors
+ *                that change are written.
+ *   INPUTS: step -- fade step, from 0 (black) to PALETTE_FADE_STEPS (full
+ *                   intensity); out-of-range values are clipped
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors 64 to 255
+ */
+void
+set_palette_fade (int step)
+{
+    if (0 > step) {
+	step = 0;
+    } else if (PALETTE_FADE_STEPS < step) {
+	step = PALETTE_FADE_STEPS;
+    }
+    fade_step = step;
+    write_palette_delta (64, 192, fade_ramp[fade_step]);
+}
+
+
+/*
+ * get_palette_fade
+ *   DESCRIPTION: Get the step of the fade ramp currently in effect.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: fade step, from 0 (black) to PALETTE_FADE_STEPS
+ *   SIDE EFFECTS: none
+ */
+int
+get_palette_fade ()
+{
+    return fade_step;
+}
+
+
+/*
+ * write_palette_delta
+ *   DESCRIPTION: Write a range of palette colors to the VGA DAC, skipping
+ *                colors that already match the DAC shadow.  Each run of
+ *                changed colors costs one index write followed by the
+ *                color data.  If the shadow is not valid, the whole
+ *                range is written.
+ *   INPUTS: first -- first palette index in the range
+ *           count -- number of colors in the range
+ *           rgb -- the 6-bit RGB colors for the range
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes palette colors; updates DAC shadow
+ */
+static void
+write_palette_delta (int first, int count, unsigned char rgb[][3])
+{
+    int i;     /* loop index over colors         */
+    int start; /* first color in a changed run   */
+
+    /* Without a valid shadow, everything must be written. */
+    if (!dac_shadow_valid) {
+	OUTB (0x03C8, first);
+	REP_OUTSB (0x03C9, rgb, count * 3);
+	memcpy (dac_shadow[first], rgb, count * 3);
+	if (64 == first && 192 == count) {
+	    dac_shadow_valid = 1;
+	}
+	return;
+    }
+
+    /* Find runs of changed colors and write each run. */
+    for (i = 0; count > i; ) {
+	if (0 == memcmp (dac_shadow[first + i], rgb[i], 3)) {
+	    i++;
+	    continue;
+	}
+	for (start = i++; count > i && 
+	     0 != memcmp (dac_shadow[first + i], rgb[i], 3); i++);
+	OUTB (0x03C8, first + start);
+	REP_OUTSB (0x03C9, rgb[start], (i - start) * 3);
+	memcpy (dac_shadow[first + start], rgb[start], (i - start) * 3);
+    }
+}
 
 
 /*
@@ -1055,6 +2016,7 @@ set_text_mode_3 (int clear_scr)
     set_attr_registers (text_attr);              /* attribute registers     */
     set_graphics_registers (text_graphics);      /* graphics registers      */
     fill_palette_text ();			 /* palette colors          */
+    dac_shadow_valid = 0;			 /* shadow now unknown      */
     if (clear_scr) {				 /* clear screens if needed */
 	txt_scr = (unsigned long*)(mem_image + 0x18000); 
 	for (i = 0; i < 8192; i++)
@@ -60,6 +60,7 @@
 #define SCROLL_Y_DIM    (IMAGE_Y_DIM-18)               /* full image width      */
 #define SCROLL_X_WIDTH  (IMAGE_X_DIM / 4)          /* addresses (bytes)     */
 
+#include <stdint.h>
 #include <string.h>
 
 /*
@@ -125,20 +126,96 @@ extern void clear_mode_X ();
 /* set logical view window coordinates */
 extern void set_view_window (int scr_x, int scr_y);
 
-/* show the logical view window on the monitor */
-extern void show_screen ();
+/* 
+ * show the logical view window (and status bar) on the monitor; returns 0
+ * without doing anything if the frame shown last is still up to date
+ */
+extern int show_screen ();
+
+/* 
+ * draw the status bar, which appears with the next show_screen; returns 0
+ * if the bar was already up to date 
+ */
+extern int show_status_bar(const char* message, const char* room_info, const char *ptr);
 
-extern void show_status_bar(const char* message, const char* room_info, const char *ptr);
+/* 
+ * Frames are put on the monitor by a separate present thread while the
+ * caller goes on with the next frame.  These statistics count the frames
+ * composed by show_screen, those put on the monitor, and those dropped
+ * because a newer frame arrived first, along with the time spent on each
+ * stage.  Margin hits and misses count the lines brought into view by
+ * scrolling that were already drawn in the margin, and those that were
+ * not and had to be drawn (see draw_exposed_lines).
+ */
+typedef struct render_stats_t render_stats_t;
+struct render_stats_t {
+    uint32_t composed;         /* frames composed by show_screen     */
+    uint32_t presented;        /* frames put on the monitor          */
+    uint32_t dropped;          /* frames replaced before presenting  */
+    uint64_t compose_usec;     /* total time composing frames        */
+    uint64_t present_usec;     /* total time uploading frames        */
+    uint32_t present_max_usec; /* longest frame upload               */
+    uint32_t margin_hits;      /* scrolled-in lines found in margin  */
+    uint32_t margin_misses;    /* scrolled-in lines drawn on demand  */
+};
+
+/* get frame statistics (stable only after clear_mode_X) */
+extern void get_render_stats (render_stats_t* stats);
 /* clear the video memory in mode X */
 extern void clear_screens ();
 
 /* draw a horizontal line at vertical pixel y within the logical view window */
 extern int draw_horiz_line (int y);
 
+/* draw every line of the logical view window (in parallel) */
+extern void draw_all_lines ();
+
+/* draw a ready-made image of the whole logical view window */
+extern void draw_full_image (const unsigned char* img);
+
+/* draw the lines of the logical view window exposed by moving it */
+extern void draw_exposed_lines ();
+
+/* 
+ * Sides of the logical view window on which a margin can be drawn ahead 
+ * of time by draw_margin_line.
+ */
+enum {MARGIN_UP, MARGIN_DOWN, MARGIN_LEFT, MARGIN_RIGHT};
+
+/* draw one more line of margin beside the window (returns 0 when full) */
+extern int draw_margin_line (int dir, int limit);
+
 /* draw a vertical line at horizontal pixel x within the logical view window */
 extern int draw_vert_line (int x);
 
 // extern void copy_status_bar ( char* img,  short scr_addr);
 
-void set_palette(unsigned char p[192][3]);
+/* 
+ * The 192 palette colors above the 64 fixed game colors belong to the
+ * current room photo.  A shadow copy of the VGA DAC is kept so that only
+ * colors that actually change are written to the hardware.
+ *
+ * PALETTE_FADE_STEPS is the number of steps in the precomputed fade ramp
+ * built whenever a new photo palette is installed: step 0 is black, and
+ * step PALETTE_FADE_STEPS is the photo palette itself.
+ */
+#define PALETTE_FADE_STEPS 4
+
+/* install a room photo palette (uploads only changed colors) */
+extern void set_palette (unsigned char p[192][3]);
+
+/* install a room photo palette from a fade ramp built by make_fade_ramp */
+extern void set_palette_ramp 
+		(const unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3]);
+
+/* build the fade ramp for a room photo palette (safe in any thread) */
+extern void make_fade_ramp (const unsigned char p[192][3], 
+			    unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3]);
+
+/* move the room photo colors to a step of the fade ramp */
+extern void set_palette_fade (int step);
+
+/* get the current step of the fade ramp */
+extern int get_palette_fade ();
+
 #endif /* MODEX_H */
@@ -21,6 +21,8 @@
 #include <linux/kdev_t.h>
 #include <linux/tty.h>
 #include <linux/spinlock.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
 
 #include "tuxctl-ld.h"
 #include "tuxctl-ioctl.h"
@@ -39,6 +41,16 @@ int flag;
 unsigned char setting_val(unsigned long number);
 unsigned long restore; 
 
+/* 
+ * Button events counts the button change packets received from the 
+ * controller; buttons_seen is its value when the buttons were last read
+ * with TUX_BUTTONS.  While they differ, the controller polls as readable.
+ * Processes waiting for a change sleep on button_wait.
+ */
+static DECLARE_WAIT_QUEUE_HEAD(button_wait);
+static unsigned long button_events;
+static unsigned long buttons_seen;
+
 #define debug(str, ...) \
 	printk(KERN_DEBUG "%s: " str, __FUNCTION__, ## __VA_ARGS__)
 
@@ -76,6 +88,9 @@ void tuxctl_handle_packet (struct tty_struct* tty, unsigned char* packet)
 			break; 
 		case MTCP_BIOC_EVENT: 
 			tux_button_calc(b ,c); // calls the button helper function 
+			button_events++;
+			wake_up_interruptible(&button_wait); // wakes up anyone polling for a button change
+			break;
 		case MTCP_RESET:
 			tux_innit(tty);// initializes tux for reset 
 			tux_set_led(tty , restore); // calls set led and passes the restored led vals for displaying 
@@ -313,6 +328,31 @@ int tux_set_button (struct tty_struct* tty, unsigned long arg){
 	if(&arg == NULL){
 		return -EINVAL; // return -EINVAL is arg is null
 	}
+	buttons_seen = button_events; // the current buttons have now been read
 	copy_to_user((int*)arg, &b_c, 1); // calling cop to user- copies 1 byte of data to the user space  
 	return 0;
 }
+
+/*
+ * tuxctl_poll
+ *   DESCRIPTION: Poll method for the line discipline.  Reports the controller
+ *                as readable when its buttons have changed since they were last
+ *                read with TUX_BUTTONS.
+ *   INPUTS:
+ *     tty  - Pointer to the TTY structure 
+ *     file - Pointer to the file structure
+ *     wait - poll table to which our wait queue is added
+ *   OUTPUTS: none
+ *   RETURN VALUE: POLLIN | POLLRDNORM if the buttons changed, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+
+unsigned int tuxctl_poll (struct tty_struct* tty, struct file* file, 
+			  struct poll_table_struct* wait){
+
+	poll_wait(file, &button_wait, wait); 
+	if(buttons_seen != button_events){
+		return POLLIN | POLLRDNORM;
+	}
+	return 0;
+}
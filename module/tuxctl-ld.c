@@ -70,6 +70,7 @@ static struct tty_ldisc tuxctl_ldisc  = {
 	.open = tuxctl_ldisc_open,
 	.close = tuxctl_ldisc_close,
         .ioctl = tuxctl_ioctl,
+	.poll = tuxctl_poll,
 	.receive_buf = tuxctl_ldisc_rcv_buf,
 	.write_wakeup = tuxctl_ldisc_write_wakeup,
 };
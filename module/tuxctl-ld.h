@@ -5,6 +5,7 @@
 #include <linux/kernel.h>
 #include <linux/fs.h>
 #include <linux/tty.h>
+#include <linux/poll.h>
 
 /* tuxctl-ld.h
  * Interface between line discipline and driver */
@@ -36,4 +37,9 @@ void tuxctl_handle_packet(struct tty_struct *tty, unsigned char *packet);
  * Located in tuxctl.c
  */
 extern int tuxctl_ioctl(struct tty_struct * tty, struct file *, unsigned int cmd, unsigned long arg);
+
+/* poll for the line discipline; readable when the buttons have changed.
+ * Located in tuxctl.c
+ */
+extern unsigned int tuxctl_poll(struct tty_struct * tty, struct file *, struct poll_table_struct *);
 #endif
@@ -0,0 +1,313 @@
+/*									tab:8
+ *
+ * mp2gen.c - utility program for generating large adventure game worlds
+ *
+ * Filename:	    mp2gen.c
+ * History:
+ *		1	Generated synthetic worlds of configurable size for
+ *			measuring how the game scales.
+ */
+
+
+/*
+ * This file is a standalone utility program that generates a synthetic
+ * world for testing the game at scale.  It writes a world description
+ * (see world.txt) holding a base description, such as the campus, and the
+ * generated rooms and objects, together with the room photos and object
+ * images that they use (in the formats written by mp2photo and mp2object).
+ * Compile the description with mp2world, and give the world file to the
+ * game.
+ *
+ * The generated rooms form a chain, linked both ways by "left" and
+ * "right"; some also have an "enter" link to a random generated room.
+ * The player starts in the first generated room, whose "left" leads to
+ * the base world's starting room.  Objects are given names from a small
+ * set, so that many objects share each name, and are placed at random.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "photo.h"
+
+
+#define MAX_LINE_LEN 1024	/* longest line in the base description */
+#define N_OBJ_IMAGES 4		/* number of object images generated    */
+
+/* names given to generated objects */
+static const char* const obj_names[] = {
+    "crate", "lamp", "chair", "plant", "sign", "cone",
+    "box", "bench", "poster", "mug", "bag", "hat"
+};
+#define N_OBJ_NAMES (sizeof (obj_names) / sizeof (obj_names[0]))
+
+/* the options, with their defaults */
+static int32_t n_rooms = 1000;	/* -r: number of rooms generated        */
+static int32_t objs_per_room = 2; /* -o: objects placed in each room    */
+static int32_t photo_w = 320;	/* -p: room photo width                 */
+static int32_t photo_h = 200;	/*     and height                       */
+static int32_t n_photos = 16;	/* -n: number of room photos generated  */
+static int32_t enter_pct = 50;	/* -l: percentage of rooms with "enter" */
+static uint32_t seed = 1;	/* -s: seed for the random choices      */
+
+
+/*
+ * write_photo
+ *   DESCRIPTION: Write a room photo of the chosen size: colour gradients
+ *                with noise, so that choosing its palette takes about as
+ *                much work as for a real photo.
+ *   INPUTS: fname -- name of the photo file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+write_photo (const char* fname)
+{
+    FILE*          out;	/* photo file          */
+    photo_header_t hdr;	/* photo file header   */
+    uint16_t       pix;	/* pixel (5:6:5 RGB)   */
+    int32_t        x;	/* index over columns  */
+    int32_t        y;	/* index over rows     */
+    int32_t        tint = rand () % 32; /* base blue level */
+    int            ok;	/* all writes worked   */
+
+    if (NULL == (out = fopen (fname, "w+b"))) {
+	perror ("open photo file");
+	return 0;
+    }
+    hdr.width = photo_w;
+    hdr.height = photo_h;
+    ok = (1 == fwrite (&hdr, sizeof (hdr), 1, out));
+    for (y = 0; ok && photo_h > y; y++) {
+	for (x = 0; ok && photo_w > x; x++) {
+	    pix = (((x * 32 / photo_w) << 11) | ((y * 64 / photo_h) << 5) |
+		   ((tint + rand () % 4) & 0x1F));
+	    ok = (1 == fwrite (&pix, sizeof (pix), 1, out));
+	}
+    }
+    if (EOF == fclose (out) || !ok) {
+	perror ("write photo file");
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * write_object_image
+ *   DESCRIPTION: Write an object image: a filled ellipse on a transparent
+ *                background.
+ *   INPUTS: fname -- name of the image file
+ *           w -- image width
+ *           h -- image height
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+write_object_image (const char* fname, int32_t w, int32_t h)
+{
+    FILE*          out;	/* image file             */
+    photo_header_t hdr;	/* image file header      */
+    uint8_t        pix;	/* pixel (2:2:2 RGB)      */
+    uint8_t        colour = 1 + rand () % 0x3E; /* ellipse colour */
+    int32_t        x;	/* index over columns     */
+    int32_t        y;	/* index over rows        */
+    int32_t        dx;	/* twice x from centre    */
+    int32_t        dy;	/* twice y from centre    */
+    int            ok;	/* all writes worked      */
+
+    if (NULL == (out = fopen (fname, "w+b"))) {
+	perror ("open object image file");
+	return 0;
+    }
+    hdr.width = w;
+    hdr.height = h;
+    ok = (1 == fwrite (&hdr, sizeof (hdr), 1, out));
+    for (y = 0; ok && h > y; y++) {
+	for (x = 0; ok && w > x; x++) {
+	    dx = 2 * x + 1 - w;
+	    dy = 2 * y + 1 - h;
+	    pix = ((int64_t)dx * dx * h * h + (int64_t)dy * dy * w * w <=
+		   (int64_t)w * w * h * h ? colour : OBJ_CLR_TRANSP);
+	    ok = (1 == fwrite (&pix, sizeof (pix), 1, out));
+	}
+    }
+    if (EOF == fclose (out) || !ok) {
+	perror ("write object image file");
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * copy_base
+ *   DESCRIPTION: Copy a base world description, except its starting room,
+ *                which is found instead.
+ *   INPUTS: in -- the base description
+ *           out -- the description being written
+ *   OUTPUTS: start -- key of the base world's starting room
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+copy_base (FILE* in, FILE* out, char start[MAX_LINE_LEN])
+{
+    char line[MAX_LINE_LEN]; /* line being copied */
+
+    start[0] = '\0';
+    while (NULL != fgets (line, sizeof (line), in)) {
+	if (1 == sscanf (line, " start %s", start)) {
+	    continue;
+	}
+	if (EOF == fputs (line, out)) {
+	    perror ("write world description");
+	    return 0;
+	}
+    }
+    if (ferror (in) || '\0' == start[0]) {
+	fputs ("can't read starting room of base world.\n", stderr);
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * generate_world
+ *   DESCRIPTION: Write the generated rooms and objects, and the photos and
+ *                images that they use.
+ *   INPUTS: out -- the description being written
+ *           dir -- directory for photos and images
+ *           base_start -- key of the base world's starting room
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+generate_world (FILE* out, const char* dir, const char* base_start)
+{
+    char    fname[MAX_LINE_LEN]; /* photo or image file name       */
+    char    left[32];            /* key of room to the left        */
+    char    enter[32];           /* key of room reached by "enter" */
+    char    right[32];           /* key of room to the right       */
+    int32_t i;                   /* index over rooms and images    */
+    int32_t k;                   /* index over a room's objects    */
+    int32_t n_objs = 0;          /* number of objects so far       */
+
+    /* Write the photos and images. */
+    for (i = 0; n_photos > i; i++) {
+	(void)snprintf (fname, sizeof (fname), "%s/room%d.photo", dir, i);
+	if (!write_photo (fname)) {
+	    return 0;
+	}
+    }
+    for (i = 0; N_OBJ_IMAGES > i; i++) {
+	(void)snprintf (fname, sizeof (fname), "%s/thing%d.obj", dir, i);
+	if (!write_object_image (fname, 24 + 16 * i, 16 + 8 * i)) {
+	    return 0;
+	}
+    }
+
+    /* Write the rooms and their objects. */
+    fprintf (out, "\n# %d generated rooms with %d objects each\n"
+	     "start gen_0\n", n_rooms, objs_per_room);
+    for (i = 0; n_rooms > i; i++) {
+	if (0 == i) {
+	    (void)snprintf (left, sizeof (left), "%.31s", base_start);
+	} else {
+	    (void)snprintf (left, sizeof (left), "gen_%d", i - 1);
+	}
+	if (rand () % 100 < enter_pct) {
+	    (void)snprintf (enter, sizeof (enter), "gen_%d", rand () % n_rooms);
+	} else {
+	    (void)strcpy (enter, "-");
+	}
+	if (n_rooms - 1 == i) {
+	    (void)strcpy (right, "-");
+	} else {
+	    (void)snprintf (right, sizeof (right), "gen_%d", i + 1);
+	}
+	fprintf (out, "room gen_%d \"Room %d\" %s/room%d.photo %s %s %s\n",
+		 i, i, dir, rand () % n_photos, left, enter, right);
+	for (k = 0; objs_per_room > k; k++, n_objs++) {
+	    fprintf (out, "object gen_obj_%d %s %s/thing%d.obj gen_%d\n",
+		     n_objs, obj_names[rand () % N_OBJ_NAMES], dir,
+		     rand () % N_OBJ_IMAGES, i);
+	}
+    }
+    if (ferror (out)) {
+	perror ("write world description");
+	return 0;
+    }
+    return 1;
+}
+
+
+int
+main (int argc, char* argv[])
+{
+    FILE*   in;
+    FILE*   out;
+    char    start[MAX_LINE_LEN];
+    char    fname[MAX_LINE_LEN];
+    int     opt;
+    int32_t written;
+
+    /* Check syntax of invocation. */
+    while (-1 != (opt = getopt (argc, argv, "r:o:p:n:l:s:"))) {
+	switch (opt) {
+	    case 'r': n_rooms = atoi (optarg); break;
+	    case 'o': objs_per_room = atoi (optarg); break;
+	    case 'p':
+		if (2 != sscanf (optarg, "%dx%d", &photo_w, &photo_h)) {
+		    photo_w = 0;
+		}
+		break;
+	    case 'n': n_photos = atoi (optarg); break;
+	    case 'l': enter_pct = atoi (optarg); break;
+	    case 's': seed = strtoul (optarg, NULL, 0); break;
+	    default: photo_w = 0; break;
+	}
+    }
+    if (2 != argc - optind || 1 > n_rooms || 0 > objs_per_room ||
+	SCROLL_X_DIM > photo_w || MAX_PHOTO_WIDTH < photo_w ||
+	SCROLL_Y_DIM > photo_h || MAX_PHOTO_HEIGHT < photo_h ||
+	1 > n_photos || 0 > enter_pct || 100 < enter_pct) {
+    	fprintf (stderr, "usage: %s [-r <rooms>] [-o <objects per room>] "
+		 "[-p <width>x<height>]\n"
+		 "\t[-n <photos>] [-l <percent of rooms with enter>] "
+		 "[-s <seed>]\n"
+		 "\t<base world description> <output directory>\n", argv[0]);
+	return 2;
+    }
+    srand (seed);
+
+    /* Open the base description and the generated description. */
+    if (NULL == (in = fopen (argv[optind], "r"))) {
+        perror ("open base world description");
+	return 2;
+    }
+    (void)snprintf (fname, sizeof (fname), "%s/world.txt", argv[optind + 1]);
+    if (NULL == (out = fopen (fname, "w"))) {
+	fclose (in);
+        perror ("open output world description");
+	return 2;
+    }
+
+    /* Copy the base world, then add the generated world. */
+    written = (copy_base (in, out, start) &&
+	       generate_world (out, argv[optind + 1], start));
+    (void)fclose (in);
+    if (EOF == fclose (out)) {
+	perror ("close output world description");
+        written = 0;
+    }
+    return (written ? 0 : 3);
+}
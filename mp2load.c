@@ -0,0 +1,380 @@
+/*									tab:8
+ *
+ * mp2load.c - utility program for load testing the adventure game
+ *
+ * Filename:	    mp2load.c
+ * History:
+ *		1	Played many headless game sessions at once on several
+ *			threads, for load testing.
+ */
+
+
+/*
+ * This file is a standalone utility program that builds a world from a
+ * world file, then plays many game sessions on it at once, with no
+ * display.  Each thread plays its share of the sessions in turn, one
+ * random action at a time: moving left, entering, or moving right;
+ * getting an object in the room, or dropping the last one got; going to
+ * a room visited earlier by name; and listing the inventory.  The rate of
+ * actions over all sessions is then printed.
+ *
+ * With -c, each session is also saved halfway through its actions and
+ * restored into a twin session, which then takes the same actions as
+ * the original.  At the end, the player's room, the objects in it, and
+ * the inventory of each twin must match those of its original.
+ *
+ * Since all sessions share the world's photos, images, names, and paths,
+ * the memory used per session is small.
+ */
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "world.h"
+
+
+/* the state of a session kept by the player */
+typedef struct player_t player_t;
+struct player_t {
+    world_session_t* session;	/* the game session               */
+    room_t*          where;	/* the player's room              */
+    const char*      got;	/* name of the last object got    */
+    const char*      seen;	/* name of a room visited earlier */
+    uint32_t         seed;	/* state of the random choices    */
+};
+
+/* the sessions played by a thread */
+typedef struct player_thread_t player_thread_t;
+struct player_thread_t {
+    pthread_t id;		/* the thread                     */
+    int32_t   first;		/* first of its players           */
+    int32_t   count;		/* number of its players          */
+    int32_t   ok;		/* all sessions were started      */
+    int32_t   differ;		/* twins that differ (-c)         */
+};
+
+/* the options, with their defaults */
+static int32_t n_players = 100;	/* -p: number of sessions played      */
+static int32_t n_threads = 4;	/* -t: number of threads playing them */
+static int32_t n_moves = 1000;	/* -m: actions taken in each session  */
+static uint32_t seed = 1;	/* -s: seed for the random choices    */
+static int32_t check_saves = 0;	/* -c: check save and restore         */
+
+static player_t* player;	/* the sessions                       */
+static player_t* twin;		/* sessions restored from saves (-c)  */
+
+
+/*
+ * show_status
+ *   DESCRIPTION: Show a status message from the game.  No session is
+ *                shown, so the message is dropped.
+ *   INPUTS: s -- the message
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+show_status (const char* s)
+{
+    (void)s;
+}
+
+
+/*
+ * take_action
+ *   DESCRIPTION: Take one random action in the calling thread's session.
+ *   INPUTS: p -- the player of the session
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes the session
+ */
+static void
+take_action (player_t* p)
+{
+    object_t* obj;	/* object in the player's room */
+    int32_t   n;	/* objects passed over         */
+
+    switch (rand_r (&p->seed) % 8) {
+	case 0: (void)try_to_move_left (&p->where); break;
+	case 1: (void)try_to_enter (&p->where); break;
+	case 2: (void)try_to_move_right (&p->where); break;
+	case 3:
+	    n = rand_r (&p->seed) % 4;
+	    for (obj = room_contents_iterate (p->where);
+		 NULL != obj && 0 < n && NULL != obj_next (obj); n--) {
+		obj = obj_next (obj);
+	    }
+	    if (NULL != obj && NULL != obj_name (obj) &&
+		TC_REDRAW_ROOM == typed_cmd_get (&p->where, obj_name (obj))) {
+		p->got = obj_name (obj);
+	    }
+	    break;
+	case 4:
+	    if (NULL != p->got) {
+		(void)typed_cmd_drop (&p->where, p->got);
+		p->got = NULL;
+	    }
+	    break;
+	case 5:
+	    if (NULL != p->seen) {
+		(void)typed_cmd_go (&p->where, p->seen);
+	    }
+	    p->seen = room_name (p->where);
+	    break;
+	case 6: (void)typed_cmd_inventory (&p->where, ""); break;
+	default:
+	    if (0 == rand_r (&p->seed) % 4) {
+		p->seen = room_name (p->where);
+	    }
+	    break;
+    }
+}
+
+
+/*
+ * restore_twin
+ *   DESCRIPTION: Save the calling thread's session, and restore the save
+ *                into a new twin session, which is to take the same 
+ *                actions as the original from now on.
+ *   INPUTS: p -- the player of the session
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: writes and removes a save file; makes the twin session
+ *                 the calling thread's
+ */
+static int32_t
+restore_twin (player_t* p)
+{
+    player_t*   t = &twin[p - player]; /* the twin             */
+    game_view_t view = {0, 0};         /* view saved (unused)  */
+    char        fname[40];             /* save file name       */
+
+    (void)snprintf (fname, sizeof (fname), "mp2load.%d.%d.sav", 
+		    (int)getpid (), (int)(p - player));
+    if (0 != save_game (fname, p->where, &view)) {
+	return -1;
+    }
+    *t = *p;
+    if (NULL == (t->session = new_world_session ())) {
+	(void)unlink (fname);
+	return -1;
+    }
+    use_world_session (t->session);
+    t->where = restore_game (fname, &view);
+    (void)unlink (fname);
+    return (NULL == t->where ? -1 : 0);
+}
+
+
+/*
+ * describe_room
+ *   DESCRIPTION: Describe a room: its name, then the names of the objects
+ *                in it, in order.
+ *   INPUTS: r -- the room
+ *           len -- size of the buffer
+ *   OUTPUTS: buf -- the description (truncated to fit)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+describe_room (const room_t* r, char* buf, size_t len)
+{
+    const object_t* obj;  /* index over the objects */
+    size_t          used; /* characters written     */
+
+    used = snprintf (buf, len, "%s:", room_name (r));
+    for (obj = room_contents_iterate (r); NULL != obj && len > used;
+	 obj = obj_next (obj)) {
+	used += snprintf (buf + used, len - used, " %s", obj_name (obj));
+    }
+    if (len > used) {
+	(void)snprintf (buf + used, len - used, "; ");
+    }
+}
+
+
+/*
+ * describe_session
+ *   DESCRIPTION: Describe the calling thread's session: the player's room,
+ *                then the room reached by the inventory command (the 
+ *                inventory, or the room from which the player entered it).
+ *   INPUTS: p -- the player of the session
+ *           len -- size of the buffer
+ *   OUTPUTS: buf -- the description (truncated to fit)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: uses the inventory command twice, which may record the 
+ *                 player's room as the one from which the inventory was
+ *                 entered
+ */
+static void
+describe_session (player_t* p, char* buf, size_t len)
+{
+    room_t* r = p->where; /* room described */
+
+    describe_room (r, buf, len);
+    (void)typed_cmd_inventory (&r, "");
+    describe_room (r, buf + strlen (buf), len - strlen (buf));
+    (void)typed_cmd_inventory (&r, "");
+}
+
+
+/*
+ * play_sessions
+ *   DESCRIPTION: Start a thread's sessions, then play them in turn, one
+ *                action at a time.  With -c, saves each session halfway
+ *                through and restores it into a twin that takes the same
+ *                actions, then compares each twin with its original.
+ *   INPUTS: arg -- the thread's player_thread_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: sets the thread's ok and differ fields
+ */
+static void*
+play_sessions (void* arg)
+{
+    player_thread_t* pt = arg;	/* the thread          */
+    player_t*        p;		/* index over players  */
+    player_t*        t;		/* twin of player      */
+    int32_t          move;	/* index over actions  */
+    char             mine[1024]; /* original described */
+    char             theirs[1024]; /* twin described   */
+
+    for (p = player + pt->first; player + pt->first + pt->count > p; p++) {
+	if (NULL == (p->session = new_world_session ())) {
+	    return NULL;
+	}
+	use_world_session (p->session);
+	p->where = start_in_room ();
+	p->seed = seed + (p - player);
+    }
+    pt->ok = 1;
+
+    for (move = 0; n_moves > move; move++) {
+	for (p = player + pt->first; player + pt->first + pt->count > p; p++) {
+	    use_world_session (p->session);
+	    if (check_saves && n_moves / 2 == move && 0 != restore_twin (p)) {
+		pt->ok = 0;
+		return NULL;
+	    }
+	    use_world_session (p->session);
+	    take_action (p);
+	    if (check_saves && NULL != (t = &twin[p - player])->session) {
+		use_world_session (t->session);
+		take_action (t);
+	    }
+	}
+    }
+
+    /* Compare each twin with its original. */
+    for (p = player + pt->first; check_saves &&
+	 player + pt->first + pt->count > p; p++) {
+	t = &twin[p - player];
+	if (NULL == t->session) {
+	    continue;
+	}
+	use_world_session (p->session);
+	describe_session (p, mine, sizeof (mine));
+	use_world_session (t->session);
+	describe_session (t, theirs, sizeof (theirs));
+	if (0 != strcmp (mine, theirs)) {
+	    if (0 == pt->differ++) {
+		fprintf (stderr, "session %d restored differs:\n  saved: %s\n"
+			 "  restored: %s\n", (int)(p - player), mine, theirs);
+	    }
+	}
+    }
+    return NULL;
+}
+
+
+int
+main (int argc, char* argv[])
+{
+    player_thread_t* pt;
+    struct timespec  start;
+    struct timespec  end;
+    double           secs;
+    int              opt;
+    int32_t          i;
+    int32_t          ok = 1;
+    int32_t          differ = 0;
+
+    /* Check syntax of invocation. */
+    while (-1 != (opt = getopt (argc, argv, "p:t:m:s:c"))) {
+	switch (opt) {
+	    case 'p': n_players = atoi (optarg); break;
+	    case 't': n_threads = atoi (optarg); break;
+	    case 'm': n_moves = atoi (optarg); break;
+	    case 's': seed = strtoul (optarg, NULL, 0); break;
+	    case 'c': check_saves = 1; break;
+	    default: n_players = 0; break;
+	}
+    }
+    if (1 < argc - optind || 1 > n_players || 1 > n_threads ||
+	0 > n_moves) {
+	fprintf (stderr, "usage: %s [-p <sessions>] [-t <threads>] "
+		 "[-m <actions per session>]\n"
+		 "\t[-s <seed>] [-c] [<world file>]\n", argv[0]);
+	return 2;
+    }
+    if (n_threads > n_players) {
+	n_threads = n_players;
+    }
+
+    /* Build the world, which the sessions then share. */
+    if (!build_world (optind < argc ? argv[optind] : WORLD_FILE)) {
+	return 3;
+    }
+    player = calloc (n_players, sizeof (player[0]));
+    twin = calloc (n_players, sizeof (twin[0]));
+    pt = calloc (n_threads, sizeof (pt[0]));
+    if (NULL == player || NULL == twin || NULL == pt) {
+	fputs ("out of memory for sessions\n", stderr);
+	return 3;
+    }
+
+    /* Play the sessions, splitting them among the threads. */
+    (void)clock_gettime (CLOCK_MONOTONIC, &start);
+    for (i = 0; n_threads > i; i++) {
+	pt[i].first = i * n_players / n_threads;
+	pt[i].count = (i + 1) * n_players / n_threads - pt[i].first;
+	if (0 != pthread_create (&pt[i].id, NULL, play_sessions, &pt[i])) {
+	    perror ("pthread_create");
+	    return 3;
+	}
+    }
+    for (i = 0; n_threads > i; i++) {
+	(void)pthread_join (pt[i].id, NULL);
+	ok = (ok && pt[i].ok);
+	differ += pt[i].differ;
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &end);
+    if (!ok) {
+	fputs ("can't start, save, or restore sessions\n", stderr);
+	return 3;
+    }
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf ("%d sessions on %d threads: %lld actions in %.3f s "
+	    "(%.0f per second)\n", n_players, n_threads,
+	    (long long)n_players * n_moves, secs,
+	    (double)n_players * n_moves / secs);
+
+    if (check_saves) {
+	printf ("%d sessions restored from saves, %d differ\n", n_players,
+		differ);
+    }
+
+    for (i = 0; n_players > i; i++) {
+	free_world_session (player[i].session);
+	if (NULL != twin[i].session) {
+	    free_world_session (twin[i].session);
+	}
+    }
+    return (0 == differ ? 0 : 1);
+}
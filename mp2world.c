@@ -0,0 +1,622 @@
+/*									tab:8
+ *
+ * mp2world.c - utility program for compiling adventure game world files
+ *
+ * Filename:	    mp2world.c
+ * History:
+ *		1	Moved the rooms, objects, and swap photos out of
+ *			world.c into a world file compiled by mp2world.
+ */
+
+
+/*
+ * This file is a standalone utility program that compiles a text
+ * description of the adventure game world (see world.txt) into the binary
+ * world file read by the game (see world_headers.h).  Rooms may be linked
+ * to rooms described later in the text.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "world_headers.h"
+
+
+#define MAX_LINE_LEN 1024	/* longest line in the description */
+#define MAX_FIELDS   8		/* most fields on a line           */
+
+/* kinds of items named by keys */
+enum {KEY_ROOM, KEY_OBJECT, KEY_SWAP};
+
+/*
+ * A room, object, or swap photo as described, with its links still given
+ * by key.  The record for the world file is filled in as the description
+ * is read, apart from the fields that refer to other items.
+ */
+typedef struct text_room_t text_room_t;
+struct text_room_t {
+    world_room_t rec;		/* record for world file         */
+    char*        link[3];	/* keys of left, enter, right    */
+};
+
+typedef struct text_object_t text_object_t;
+struct text_object_t {
+    world_object_t rec;		/* record for world file         */
+    char*          room;	/* key of starting room (or NULL) */
+};
+
+/* a key, and the item that it names */
+typedef struct key_entry_t key_entry_t;
+struct key_entry_t {
+    const char* key;		/* the key                       */
+    int32_t     kind;		/* KEY_ROOM, KEY_OBJECT, KEY_SWAP */
+    int32_t     idx;		/* index among items of the kind */
+};
+
+/* the items described */
+static text_room_t*   room;
+static int32_t        n_rooms, max_rooms;
+static text_object_t* object;
+static int32_t        n_objects, max_objects;
+static world_swap_t*  swap;
+static int32_t        n_swaps, max_swaps;
+static char*          start_key;
+
+/* the keys, in a hash table with linear probing (NULL key if empty) */
+static key_entry_t*   key_tab;
+static int32_t        n_keys, n_key_slots;
+
+/* the string table, and a hash table of string offsets plus one */
+static char*          strings;
+static uint32_t       strings_len, max_strings;
+static uint32_t*      str_tab;
+static int32_t        n_strs, n_str_slots;
+
+
+/*
+ * hash_string
+ *   DESCRIPTION: Hash a string as keys are hashed in world files.
+ *   INPUTS: s -- the string
+ *   OUTPUTS: none
+ *   RETURN VALUE: the hash
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+hash_string (const char* s)
+{
+    uint32_t hash = WORLD_HASH_INIT; /* hash so far */
+
+    for (; '\0' != *s; s++) {
+	hash = WORLD_HASH_STEP (hash, *s);
+    }
+    return hash;
+}
+
+
+/*
+ * grow_array
+ *   DESCRIPTION: Make space for one more element in an array, doubling it
+ *                when full.
+ *   INPUTS: *arr -- the array
+ *           n -- number of elements in use
+ *           *max -- number of elements allocated
+ *           size -- size of an element
+ *   OUTPUTS: *arr -- the (possibly moved) array
+ *            *max -- the new number of elements allocated
+ *   RETURN VALUE: 1 on success, or 0 if out of memory
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+grow_array (void* arr, int32_t n, int32_t* max, size_t size)
+{
+    void*   bigger; /* the new array        */
+    int32_t new_max; /* its number of elements */
+
+    if (n < *max) {
+	return 1;
+    }
+    new_max = (0 == *max ? 64 : 2 * *max);
+    if (NULL == (bigger = realloc (*(void**)arr, new_max * size))) {
+	perror ("allocate world description");
+	return 0;
+    }
+    *(void**)arr = bigger;
+    *max = new_max;
+    return 1;
+}
+
+
+/*
+ * find_key
+ *   DESCRIPTION: Find the key hash table entry for a key, or the empty
+ *                entry into which it would be added.
+ *   INPUTS: key -- the key
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the entry
+ *   SIDE EFFECTS: none
+ */
+static key_entry_t*
+find_key (const char* key)
+{
+    uint32_t slot; /* entry examined */
+
+    for (slot = hash_string (key) & (n_key_slots - 1);
+	 NULL != key_tab[slot].key; slot = (slot + 1) & (n_key_slots - 1)) {
+	if (0 == strcmp (key, key_tab[slot].key)) {
+	    break;
+	}
+    }
+    return &key_tab[slot];
+}
+
+
+/*
+ * add_key
+ *   DESCRIPTION: Add a key for an item, growing the key hash table as
+ *                needed.
+ *   INPUTS: key -- the key (which must remain valid)
+ *           kind -- kind of item (KEY_ROOM, KEY_OBJECT, KEY_SWAP)
+ *           idx -- index of item among items of its kind
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 if the key is used or out of memory
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+add_key (const char* key, int32_t kind, int32_t idx)
+{
+    key_entry_t* old = key_tab;      /* previous table          */
+    int32_t      n_old = n_key_slots; /* size of previous table  */
+    int32_t      i;                  /* index over old table    */
+    key_entry_t* e;                  /* entry for key           */
+
+    if (2 * (n_keys + 1) > n_key_slots) {
+	n_key_slots = (0 == n_old ? 64 : 2 * n_old);
+	if (NULL == (key_tab = calloc (n_key_slots, sizeof (key_tab[0])))) {
+	    perror ("allocate keys");
+	    return 0;
+	}
+	for (i = 0; n_old > i; i++) {
+	    if (NULL != old[i].key) {
+		*find_key (old[i].key) = old[i];
+	    }
+	}
+	free (old);
+    }
+    if (NULL != (e = find_key (key))->key) {
+	fprintf (stderr, "key %s is used twice.\n", key);
+	return 0;
+    }
+    e->key = key;
+    e->kind = kind;
+    e->idx = idx;
+    n_keys++;
+    return 1;
+}
+
+
+/*
+ * add_string
+ *   DESCRIPTION: Add a string to the string table, unless it is already
+ *                there.
+ *   INPUTS: s -- the string
+ *   OUTPUTS: *off -- offset of the string in the string table
+ *   RETURN VALUE: 1 on success, or 0 if out of memory
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+add_string (const char* s, uint32_t* off)
+{
+    uint32_t* old = str_tab;        /* previous table         */
+    int32_t   n_old = n_str_slots;  /* size of previous table */
+    int32_t   i;                    /* index over old table   */
+    uint32_t  slot;                 /* entry examined         */
+    uint32_t  len = strlen (s) + 1; /* bytes used by string   */
+    char*     bigger;               /* larger string table    */
+
+    if (2 * (n_strs + 1) > n_str_slots) {
+	n_str_slots = (0 == n_old ? 64 : 2 * n_old);
+	if (NULL == (str_tab = calloc (n_str_slots, sizeof (str_tab[0])))) {
+	    perror ("allocate strings");
+	    return 0;
+	}
+	for (i = 0; n_old > i; i++) {
+	    if (0 != old[i]) {
+		for (slot = hash_string (strings + old[i] - 1) &
+			    (n_str_slots - 1);
+		     0 != str_tab[slot]; slot = (slot + 1) & (n_str_slots - 1));
+		str_tab[slot] = old[i];
+	    }
+	}
+	free (old);
+    }
+    for (slot = hash_string (s) & (n_str_slots - 1); 0 != str_tab[slot];
+	 slot = (slot + 1) & (n_str_slots - 1)) {
+	if (0 == strcmp (s, strings + str_tab[slot] - 1)) {
+	    *off = str_tab[slot] - 1;
+	    return 1;
+	}
+    }
+    while (strings_len + len > max_strings) {
+	max_strings = (0 == max_strings ? 4096 : 2 * max_strings);
+	if (NULL == (bigger = realloc (strings, max_strings))) {
+	    perror ("allocate strings");
+	    return 0;
+	}
+	strings = bigger;
+    }
+    memcpy (strings + strings_len, s, len);
+    *off = strings_len;
+    str_tab[slot] = strings_len + 1;
+    strings_len += len;
+    n_strs++;
+    return 1;
+}
+
+
+/*
+ * split_line
+ *   DESCRIPTION: Split a line of the description into fields separated by
+ *                white space, removing the quotes from quoted fields.  A
+ *                '#' outside quotes starts a comment.
+ *   INPUTS: line -- the line (modified to terminate the fields)
+ *   OUTPUTS: field -- the fields (pointers into line)
+ *   RETURN VALUE: number of fields, or -1 if a quote is not closed or
+ *                 there are too many fields
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+split_line (char* line, char* field[MAX_FIELDS])
+{
+    int32_t n = 0; /* number of fields */
+
+    while (1) {
+	line += strspn (line, " \t\r\n");
+	if ('\0' == *line || '#' == *line) {
+	    return n;
+	}
+	if (MAX_FIELDS == n) {
+	    return -1;
+	}
+	if ('"' == *line) {
+	    field[n++] = ++line;
+	    if (NULL == (line = strchr (line, '"'))) {
+		return -1;
+	    }
+	} else {
+	    field[n++] = line;
+	    line += strcspn (line, " \t\r\n");
+	    if ('\0' == *line) {
+		return n;
+	    }
+	}
+	*line++ = '\0';
+    }
+}
+
+
+/*
+ * copy_field
+ *   DESCRIPTION: Copy a field naming a key, or give NULL for "-".
+ *   INPUTS: f -- the field
+ *   OUTPUTS: *copy -- the copy, or NULL
+ *   RETURN VALUE: 1 on success, or 0 if out of memory
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+copy_field (const char* f, char** copy)
+{
+    if (0 == strcmp (f, "-")) {
+	*copy = NULL;
+	return 1;
+    }
+    if (NULL == (*copy = strdup (f))) {
+	perror ("allocate world description");
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * read_description
+ *   DESCRIPTION: Read the text description of a world, recording its
+ *                items and their keys and adding its strings to the string
+ *                table.
+ *   INPUTS: fname -- name of the description (for error messages)
+ *           in -- the description
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints error messages on failure
+ */
+static int
+read_description (const char* fname, FILE* in)
+{
+    char    line[MAX_LINE_LEN]; /* line being read          */
+    char*   f[MAX_FIELDS];      /* fields of line           */
+    int32_t n_f;                /* number of fields         */
+    int32_t line_num = 0;       /* number of line being read */
+    char*   key;                /* copy of item's key       */
+    int32_t i;                  /* index over room links    */
+
+    while (NULL != fgets (line, sizeof (line), in)) {
+	line_num++;
+	if (NULL == strchr (line, '\n') && !feof (in)) {
+	    fprintf (stderr, "%s:%d: line too long.\n", fname, line_num);
+	    return 0;
+	}
+	if (0 > (n_f = split_line (line, f))) {
+	    fprintf (stderr, "%s:%d: bad quotes or too many fields.\n",
+		     fname, line_num);
+	    return 0;
+	}
+	if (0 == n_f) {
+	    continue;
+	}
+	if (0 == strcmp (f[0], "start") && 2 == n_f) {
+	    if (!copy_field (f[1], &start_key)) {
+		return 0;
+	    }
+	} else if (0 == strcmp (f[0], "room") && 7 == n_f) {
+	    text_room_t* r;
+
+	    if (!grow_array (&room, n_rooms, &max_rooms, sizeof (room[0])) ||
+		!copy_field (f[1], &key) || NULL == key ||
+		!add_key (key, KEY_ROOM, n_rooms)) {
+		fprintf (stderr, "%s:%d: bad room.\n", fname, line_num);
+		return 0;
+	    }
+	    r = &room[n_rooms++];
+	    if (!add_string (key, &r->rec.key) ||
+		!add_string (f[2], &r->rec.name) ||
+		!add_string (f[3], &r->rec.photo)) {
+		return 0;
+	    }
+	    for (i = 0; 3 > i; i++) {
+		if (!copy_field (f[4 + i], &r->link[i])) {
+		    return 0;
+		}
+	    }
+	} else if (0 == strcmp (f[0], "object") && (5 == n_f || 7 == n_f)) {
+	    text_object_t* o;
+
+	    if (!grow_array (&object, n_objects, &max_objects,
+			     sizeof (object[0])) ||
+		!copy_field (f[1], &key) || NULL == key ||
+		!add_key (key, KEY_OBJECT, n_objects)) {
+		fprintf (stderr, "%s:%d: bad object.\n", fname, line_num);
+		return 0;
+	    }
+	    o = &object[n_objects++];
+	    if (!add_string (key, &o->rec.key) ||
+		!add_string (f[2], &o->rec.name) ||
+		!add_string (f[3], &o->rec.image) ||
+		!copy_field (f[4], &o->room)) {
+		return 0;
+	    }
+	    o->rec.x = o->rec.y = WORLD_RANDOM;
+	    if (7 == n_f) {
+		o->rec.x = atoi (f[5]);
+		o->rec.y = atoi (f[6]);
+		if (0 > o->rec.x || 0 > o->rec.y || NULL == o->room) {
+		    fprintf (stderr, "%s:%d: bad object position.\n",
+			     fname, line_num);
+		    return 0;
+		}
+	    }
+	} else if (0 == strcmp (f[0], "swap") && 3 == n_f) {
+	    world_swap_t* s;
+
+	    if (!grow_array (&swap, n_swaps, &max_swaps, sizeof (swap[0])) ||
+		!copy_field (f[1], &key) || NULL == key ||
+		!add_key (key, KEY_SWAP, n_swaps)) {
+		fprintf (stderr, "%s:%d: bad swap photo.\n", fname, line_num);
+		return 0;
+	    }
+	    s = &swap[n_swaps++];
+	    if (!add_string (key, &s->key) || !add_string (f[2], &s->photo)) {
+		return 0;
+	    }
+	} else {
+	    fprintf (stderr, "%s:%d: unrecognized line.\n", fname, line_num);
+	    return 0;
+	}
+    }
+    if (ferror (in)) {
+	perror ("read world description");
+	return 0;
+    }
+    if (0 == n_rooms || NULL == start_key) {
+	fprintf (stderr, "%s: no rooms or no starting room.\n", fname);
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * room_index
+ *   DESCRIPTION: Find the room named by a key.
+ *   INPUTS: key -- the key, or NULL for no room
+ *   OUTPUTS: *idx -- index of the room, or WORLD_NONE for NULL
+ *   RETURN VALUE: 1 on success, or 0 if the key names no room
+ *   SIDE EFFECTS: prints an error message on failure
+ */
+static int
+room_index (const char* key, int32_t* idx)
+{
+    key_entry_t* e; /* entry for key */
+
+    if (NULL == key) {
+	*idx = WORLD_NONE;
+	return 1;
+    }
+    e = find_key (key);
+    if (NULL == e->key || KEY_ROOM != e->kind) {
+	fprintf (stderr, "%s is not a room.\n", key);
+	return 0;
+    }
+    *idx = e->idx;
+    return 1;
+}
+
+
+/*
+ * write_world_file
+ *   DESCRIPTION: Link the items described, and write the world file.  The
+ *                objects are written in order of their starting rooms.
+ *   INPUTS: out -- the world file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints error messages on failure
+ */
+static int
+write_world_file (FILE* out)
+{
+    world_header_t  hdr;	/* world file header               */
+    world_object_t* obj;	/* objects in order of rooms       */
+    int32_t*        obj_item;	/* item number of each object      */
+    uint32_t*       slot;	/* key hash table for world file   */
+    uint32_t        s;		/* slot examined                   */
+    int32_t         i;		/* index over items                */
+    int32_t         r;		/* starting room of an object      */
+    int32_t         next;	/* index of next object in room    */
+
+    memcpy (hdr.magic, WORLD_MAGIC, sizeof (hdr.magic));
+    hdr.version = WORLD_VERSION;
+    hdr.n_rooms = n_rooms;
+    hdr.n_objects = n_objects;
+    hdr.n_swaps = n_swaps;
+    hdr.strings_len = strings_len;
+    for (hdr.n_slots = 16; 2 * n_keys > hdr.n_slots; hdr.n_slots *= 2);
+    if (!room_index (start_key, &r) || WORLD_NONE == r) {
+	return 0;
+    }
+    hdr.start = r;
+
+    /* Link the rooms, and count the objects starting in each. */
+    for (i = 0; n_rooms > i; i++) {
+	if (!room_index (room[i].link[0], &room[i].rec.left) ||
+	    !room_index (room[i].link[1], &room[i].rec.enter) ||
+	    !room_index (room[i].link[2], &room[i].rec.right)) {
+	    return 0;
+	}
+	room[i].rec.n_objs = 0;
+    }
+    for (i = 0; n_objects > i; i++) {
+	if (!room_index (object[i].room, &object[i].rec.room)) {
+	    return 0;
+	}
+	if (WORLD_NONE != object[i].rec.room) {
+	    room[object[i].rec.room].rec.n_objs++;
+	}
+    }
+
+    /* Sort the objects by starting room, keeping their order otherwise. */
+    obj = malloc ((n_objects + 1) * sizeof (obj[0]));
+    obj_item = malloc ((n_objects + 1) * sizeof (obj_item[0]));
+    slot = calloc (hdr.n_slots, sizeof (slot[0]));
+    if (NULL == obj || NULL == obj_item || NULL == slot) {
+	perror ("allocate world file");
+	return 0;
+    }
+    for (next = 0, i = 0; n_rooms > i; i++) {
+	room[i].rec.first_obj = next;
+	next += room[i].rec.n_objs;
+	room[i].rec.n_objs = 0;
+    }
+    for (i = 0; n_objects > i; i++) {
+	if (WORLD_NONE == (r = object[i].rec.room)) {
+	    obj_item[i] = next++;
+	} else {
+	    obj_item[i] = room[r].rec.first_obj + room[r].rec.n_objs++;
+	}
+	obj[obj_item[i]] = object[i].rec;
+    }
+
+    /* Fill the key hash table. */
+    for (i = 0; n_key_slots > i; i++) {
+	if (NULL == key_tab[i].key) {
+	    continue;
+	}
+	for (s = hash_string (key_tab[i].key) & (hdr.n_slots - 1);
+	     0 != slot[s]; s = (s + 1) & (hdr.n_slots - 1));
+	switch (key_tab[i].kind) {
+	    case KEY_ROOM:   slot[s] = key_tab[i].idx + 1; break;
+	    case KEY_OBJECT:
+		slot[s] = n_rooms + obj_item[key_tab[i].idx] + 1;
+		break;
+	    case KEY_SWAP:
+		slot[s] = n_rooms + n_objects + key_tab[i].idx + 1;
+		break;
+	}
+    }
+
+    /* Write the parts of the file in order. */
+    if (1 != fwrite (&hdr, sizeof (hdr), 1, out)) {
+	perror ("write world file");
+	return 0;
+    }
+    for (i = 0; n_rooms > i; i++) {
+	if (1 != fwrite (&room[i].rec, sizeof (room[i].rec), 1, out)) {
+	    perror ("write world file");
+	    return 0;
+	}
+    }
+    if (n_objects != fwrite (obj, sizeof (obj[0]), n_objects, out) ||
+	n_swaps != fwrite (swap, sizeof (swap[0]), n_swaps, out) ||
+	hdr.n_slots != fwrite (slot, sizeof (slot[0]), hdr.n_slots, out) ||
+	strings_len != fwrite (strings, 1, strings_len, out)) {
+	perror ("write world file");
+	return 0;
+    }
+    free (obj);
+    free (obj_item);
+    free (slot);
+    return 1;
+}
+
+
+int
+main (int argc, char* argv[])
+{
+    FILE*   in;
+    FILE*   out;
+    int32_t written;
+    uint32_t off;
+
+    /* Check syntax of invocation. */
+    if (3 != argc) {
+    	fprintf (stderr, "usage: %s <world description> <output file>\n",
+		 argv[0]);
+	return 2;
+    }
+
+    /* Read the description.  The string table starts with "". */
+    if (NULL == (in = fopen (argv[1], "r"))) {
+        perror ("open world description");
+	return 2;
+    }
+    if (!add_string ("", &off) || !read_description (argv[1], in)) {
+	fclose (in);
+	return 2;
+    }
+    (void)fclose (in);
+
+    /* Try to write, then close, the output file. */
+    if (NULL == (out = fopen (argv[2], "w+b"))) {
+        perror ("open output file");
+	return 2;
+    }
+    written = write_world_file (out);
+    if (EOF == fclose (out)) {
+	perror ("close output file");
+        written = 0;
+    }
+    if (!written) {
+	(void)remove (argv[2]);
+    }
+    return (written ? 0 : 3);
+}
@@ -36,7 +36,9 @@
  */
 
 
+#include <pthread.h>
 #include <string.h>
+#include <time.h>
 
 #include "assert.h"
 #include "modex.h"
@@ -76,6 +78,10 @@ struct photo_t {
     photo_header_t hdr;			/* defines height and width */
     uint8_t        palette[192][3];     /* optimized palette colors */
     uint8_t*       img;                 /* pixel data               */
+    const char*    fname;		/* file holding photo       */
+    int32_t        loaded;		/* 0 until palette and pixel */
+    					/*   data are read, 1 after,  */
+					/*   -1 if reading failed     */
 };
 
 /* 
@@ -100,11 +106,49 @@ struct image_t {
  * The room currently shown on the screen.  This value is not known to 
  * the mode X code, but is needed when filling buffers in callbacks from 
  * that code (fill_horiz_buffer/fill_vert_buffer).  The value is set 
- * by calling prep_room.
+ * by calling prep_room, and must not change while lines are being drawn:
+ * draw_all_lines calls fill_horiz_buffer from several threads at once, 
+ * which is safe only because the fill routines read nothing but cur_room
+ * and the (unchanging) world data, and write only to their own buffers.
  */
 static const room_t* cur_room = NULL; 
 
 
+/*
+ * Photos can be read in two steps: read_photo_header gets the photo's size
+ * (all that the world needs to know until the photo is shown), and 
+ * load_photo reads the pixels and chooses the palette, which is where the
+ * time goes.  A loader thread (see start_photo_loader) loads photos in the
+ * background while the game runs; wait_for_photo blocks until a photo 
+ * that is about to be shown is loaded, and has the loader load it next.
+ * The loaded field of each photo, loader_urgent, loader_active, and the
+ * statistics are protected by load_lock.  Only one thread loads photos at
+ * a time, since the palette selection tables are shared.
+ */
+static pthread_mutex_t    load_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t     load_cv = PTHREAD_COND_INITIALIZER;
+static pthread_t          loader_id;
+static int32_t            loader_active;   /* loader thread is loading   */
+static int32_t            loader_started;  /* loader thread needs joining */
+static int32_t            loader_stop;     /* loader must end            */
+static photo_t* const*    loader_order;    /* photos in order to load    */
+static int32_t            loader_count;    /* number of photos in order  */
+static photo_t*           loader_urgent;   /* photo to be loaded next    */
+static photo_load_stats_t load_stats;
+
+
+/* local functions--see function headers for details */
+static int32_t read_photo_data (photo_t* p);
+static void* photo_loader (void* ignore);
+static void photo_horiz_line (const photo_t* view, int x, int y, 
+			      unsigned char buf[SCROLL_X_DIM]);
+static void objs_horiz_line (const room_objs_t* objs, int x, int y,
+			     unsigned char buf[SCROLL_X_DIM]);
+static void image_horiz_line (const image_t* img, int32_t obj_x, 
+			      int32_t obj_y, int x, int y, 
+			      unsigned char buf[SCROLL_X_DIM]);
+
+
 /* 
  * fill_horiz_buffer
  *   DESCRIPTION: Given the (x,y) map pixel coordinate of the leftmost 
@@ -123,61 +167,145 @@ static const room_t* cur_room = NULL;
 void
 fill_horiz_buffer (int x, int y, unsigned char buf[SCROLL_X_DIM])
 {
-    int            idx;   /* loop index over pixels in the line          */ 
-    object_t*      obj;   /* loop index over objects in the current room */
-    int            imgx;  /* loop index over pixels in object image      */ 
-    int            yoff;  /* y offset into object image                  */ 
-    uint8_t        pixel; /* pixel from object image                     */
-    const photo_t* view;  /* room photo                                  */
-    int32_t        obj_x; /* object x position                           */
-    int32_t        obj_y; /* object y position                           */
-    const image_t* img;   /* object image                                */
+    room_objs_t objs; /* objects in the current room */
 
-    /* Get pointer to current photo of current room. */
-    view = room_photo (cur_room);
+    /* Copy the line from the current photo of the current room. */
+    photo_horiz_line (room_photo (cur_room), x, y, buf);
+
+    /* Draw the objects in the current room. */
+    room_objects (cur_room, &objs);
+    objs_horiz_line (&objs, x, y, buf);
+}
+
+
+/* 
+ * fill_snap_buffer
+ *   DESCRIPTION: The same as fill_horiz_buffer, but draws the room as 
+ *                recorded in a snapshot (see snap_room) rather than the
+ *                current room.  May be called from any thread.
+ *   INPUTS: snap -- snapshot of the room to be drawn
+ *           (x,y) -- leftmost pixel of line to be drawn 
+ *   OUTPUTS: buf -- buffer holding image data for the line
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+fill_snap_buffer (const room_snap_t* snap, int x, int y, 
+		  unsigned char buf[SCROLL_X_DIM])
+{
+    room_objs_t objs; /* objects in the snapshot */
+
+    photo_horiz_line (snap->view, x, y, buf);
+    objs.n = snap->n_objs;
+    objs.x = snap->x;
+    objs.y = snap->y;
+    objs.w = snap->w;
+    objs.h = snap->h;
+    objs.img = snap->img;
+    objs_horiz_line (&objs, x, y, buf);
+}
+
+
+/* 
+ * objs_horiz_line
+ *   DESCRIPTION: Draw the objects that fall on a horizontal line over the
+ *                line buffer, in order.  Only the position and size arrays
+ *                are read for objects off the line.
+ *   INPUTS: objs -- the objects
+ *           (x,y) -- leftmost pixel of line to be drawn 
+ *           buf -- buffer holding image data for the line
+ *   OUTPUTS: buf -- buffer with the objects drawn over it
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+objs_horiz_line (const room_objs_t* objs, int x, int y,
+		 unsigned char buf[SCROLL_X_DIM])
+{
+    int32_t idx; /* loop index over objects */
+
+    for (idx = 0; objs->n > idx; idx++) {
+	/* Is object outside of the line we're drawing? */
+	if (y < objs->y[idx] || y >= objs->y[idx] + objs->h[idx] ||
+	    x + SCROLL_X_DIM <= objs->x[idx] || 
+	    x >= objs->x[idx] + objs->w[idx]) {
+	    continue;
+	}
+	image_horiz_line (objs->img[idx], objs->x[idx], objs->y[idx], 
+			  x, y, buf);
+    }
+}
+
+
+/* 
+ * photo_horiz_line
+ *   DESCRIPTION: Copy a horizontal line of a room photo into a line
+ *                buffer.  Pixels to the left or right of the photo are 
+ *                drawn in color 0.
+ *   INPUTS: view -- the room photo
+ *           (x,y) -- leftmost pixel of line to be drawn 
+ *   OUTPUTS: buf -- buffer holding image data for the line
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+photo_horiz_line (const photo_t* view, int x, int y, 
+		  unsigned char buf[SCROLL_X_DIM])
+{
+    int idx; /* loop index over pixels in the line */
 
-    /* Loop over pixels in line. */
     for (idx = 0; idx < SCROLL_X_DIM; idx++) {
         buf[idx] = (0 <= x + idx && view->hdr.width > x + idx ?
 		    view->img[view->hdr.width * y + x + idx] : 0);
     }
+}
 
-    /* Loop over objects in the current room. */
-    for (obj = room_contents_iterate (cur_room); NULL != obj;
-    	 obj = obj_next (obj)) {
-	obj_x = obj_get_x (obj);
-	obj_y = obj_get_y (obj);
-	img = obj_image (obj);
 
-        /* Is object outside of the line we're drawing? */
-	if (y < obj_y || y >= obj_y + img->hdr.height ||
-	    x + SCROLL_X_DIM <= obj_x || x >= obj_x + img->hdr.width) {
-	    continue;
-	}
+/* 
+ * image_horiz_line
+ *   DESCRIPTION: Draw the part of an object image that falls on a 
+ *                horizontal line over the line buffer.  Transparent 
+ *                pixels of the image are skipped.  The object must 
+ *                overlap the line.
+ *   INPUTS: img -- the object image
+ *           (obj_x,obj_y) -- position of the object in the room photo
+ *           (x,y) -- leftmost pixel of line to be drawn 
+ *           buf -- buffer holding image data for the line
+ *   OUTPUTS: buf -- buffer with the object drawn over it
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+image_horiz_line (const image_t* img, int32_t obj_x, int32_t obj_y,
+		  int x, int y, unsigned char buf[SCROLL_X_DIM])
+{
+    int            idx;   /* loop index over pixels in the line          */ 
+    int            imgx;  /* loop index over pixels in object image      */ 
+    int            yoff;  /* y offset into object image                  */ 
+    uint8_t        pixel; /* pixel from object image                     */
 
-	/* The y offset of drawing is fixed. */
-	yoff = (y - obj_y) * img->hdr.width;
+    /* The y offset of drawing is fixed. */
+    yoff = (y - obj_y) * img->hdr.width;
 
-	/* 
-	 * The x offsets depend on whether the object starts to the left
-	 * or to the right of the starting point for the line being drawn.
-	 */
-	if (x <= obj_x) {
-	    idx = obj_x - x;
-	    imgx = 0;
-	} else {
-	    idx = 0;
-	    imgx = x - obj_x;
-	}
+    /* 
+     * The x offsets depend on whether the object starts to the left
+     * or to the right of the starting point for the line being drawn.
+     */
+    if (x <= obj_x) {
+	idx = obj_x - x;
+	imgx = 0;
+    } else {
+	idx = 0;
+	imgx = x - obj_x;
+    }
 
-	/* Copy the object's pixel data. */
-	for (; SCROLL_X_DIM > idx && img->hdr.width > imgx; idx++, imgx++) {
-	    pixel = img->img[yoff + imgx];
+    /* Copy the object's pixel data. */
+    for (; SCROLL_X_DIM > idx && img->hdr.width > imgx; idx++, imgx++) {
+	pixel = img->img[yoff + imgx];
 
-	    /* Don't copy transparent pixels. */
-	    if (OBJ_CLR_TRANSP != pixel) {
-		buf[idx] = pixel;
-	    }
+	/* Don't copy transparent pixels. */
+	if (OBJ_CLR_TRANSP != pixel) {
+	    buf[idx] = pixel;
 	}
     }
 }
@@ -202,7 +330,8 @@ void
 fill_vert_buffer (int x, int y, unsigned char buf[SCROLL_Y_DIM])
 {
     int            idx;   /* loop index over pixels in the line          */ 
-    object_t*      obj;   /* loop index over objects in the current room */
+    room_objs_t    objs;  /* objects in the current room                 */
+    int32_t        obj;   /* loop index over objects                     */
     int            imgy;  /* loop index over pixels in object image      */ 
     int            xoff;  /* x offset into object image                  */ 
     uint8_t        pixel; /* pixel from object image                     */
@@ -221,17 +350,17 @@ fill_vert_buffer (int x, int y, unsigned char buf[SCROLL_Y_DIM])
     }
 
     /* Loop over objects in the current room. */
-    for (obj = room_contents_iterate (cur_room); NULL != obj;
-    	 obj = obj_next (obj)) {
-	obj_x = obj_get_x (obj);
-	obj_y = obj_get_y (obj);
-	img = obj_image (obj);
+    room_objects (cur_room, &objs);
+    for (obj = 0; objs.n > obj; obj++) {
+	obj_x = objs.x[obj];
+	obj_y = objs.y[obj];
 
         /* Is object outside of the line we're drawing? */
-	if (x < obj_x || x >= obj_x + img->hdr.width ||
-	    y + SCROLL_Y_DIM <= obj_y || y >= obj_y + img->hdr.height) {
+	if (x < obj_x || x >= obj_x + objs.w[obj] ||
+	    y + SCROLL_Y_DIM <= obj_y || y >= obj_y + objs.h[obj]) {
 	    continue;
 	}
+	img = objs.img[obj];
 
 	/* The x offset of drawing is fixed. */
 	xoff = x - obj_x;
@@ -333,12 +462,96 @@ photo_width (const photo_t* p)
 void
 prep_room (const room_t* r)
 {
+    /* The photo may still be loading in the background. */
+    if (0 != wait_for_photo (room_photo (r))) {
+	PANIC ("can't read room photo");
+    }
+
+    /* 
+     * Install the photo's colors.  Only colors that differ from those of
+     * the previous room are actually written to the VGA.
+     */
+    set_palette (room_photo (r)->palette);
+
     /* Record the current room. */
-	set_palette(room_photo(r)->palette);
     cur_room = r;
 }
 
 
+/* 
+ * prep_room_ramp
+ *   DESCRIPTION: Prepare a new room for display, using a fade ramp for
+ *                the room's palette that has already been built (see 
+ *                snap_fade_ramp).  Otherwise the same as prep_room.
+ *   INPUTS: r -- pointer to the new room
+ *           ramp -- fade ramp built from the room's photo palette
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes recorded cur_room for this file
+ */
+void
+prep_room_ramp (const room_t* r, 
+		const unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+    set_palette_ramp (ramp);
+    cur_room = r;
+}
+
+
+/* 
+ * snap_room
+ *   DESCRIPTION: Record what a room shows: its current photo, and the 
+ *                position and image of each object in it.  Unused parts
+ *                of the snapshot are zeroed, so two snapshots of a room
+ *                can be compared with memcmp to find whether anything 
+ *                visible has changed.  Must be called from the thread
+ *                that changes the world.
+ *   INPUTS: r -- pointer to the room
+ *   OUTPUTS: snap -- the snapshot; n_objs is -1 if the room's photo is
+ *                    not yet loaded or if the room holds more than 
+ *                    SNAP_MAX_OBJS objects (the snapshot can then not be
+ *                    drawn)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+snap_room (const room_t* r, room_snap_t* snap)
+{
+    room_objs_t objs; /* objects in the room */
+
+    (void)memset (snap, 0, sizeof (*snap));
+    snap->view = room_photo (r);
+    room_objects (r, &objs);
+    if (!photo_is_loaded (snap->view) || SNAP_MAX_OBJS < objs.n) {
+	snap->n_objs = -1;
+	return;
+    }
+    snap->n_objs = objs.n;
+    (void)memcpy (snap->x, objs.x, objs.n * sizeof (snap->x[0]));
+    (void)memcpy (snap->y, objs.y, objs.n * sizeof (snap->y[0]));
+    (void)memcpy (snap->w, objs.w, objs.n * sizeof (snap->w[0]));
+    (void)memcpy (snap->h, objs.h, objs.n * sizeof (snap->h[0]));
+    (void)memcpy (snap->img, objs.img, objs.n * sizeof (snap->img[0]));
+}
+
+
+/* 
+ * snap_fade_ramp
+ *   DESCRIPTION: Build the fade ramp for the palette of the photo in a
+ *                room snapshot.  May be called from any thread.
+ *   INPUTS: snap -- snapshot of the room
+ *   OUTPUTS: ramp -- the fade ramp
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+snap_fade_ramp (const room_snap_t* snap, 
+		unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3])
+{
+    make_fade_ramp (snap->view->palette, ramp);
+}
+
+
 /* 
  * read_obj_image
  *   DESCRIPTION: Read size and pixel data in 2:2:2 RGB format from a
@@ -422,10 +635,6 @@ read_obj_image (const char* fname)
  * read_photo
  *   DESCRIPTION: Read size and pixel data in 5:6:5 RGB format from a
  *                photo file and create a photo structure from it.
- *                Code provided simply maps to 2:2:2 RGB.  You must
- *                replace this code with palette color selection, and
- *                must map the image pixels into the palette colors that
- *                you have defined.
  *   INPUTS: fname -- file name for input
  *   OUTPUTS: none
  *   RETURN VALUE: pointer to newly allocated photo on success, or NULL
@@ -434,19 +643,38 @@ read_obj_image (const char* fname)
  */
 photo_t*
 read_photo (const char* fname)
+{
+    photo_t* p; /* photo structure */
+
+    if (NULL == (p = read_photo_header (fname))) {
+	return NULL;
+    }
+    if (0 != load_photo (p)) {
+	free (p->img);
+	free (p);
+	return NULL;
+    }
+    return p;
+}
+
+
+/* 
+ * read_photo_header
+ *   DESCRIPTION: Read the size of a photo from a photo file and create a
+ *                photo structure for it, with space for its pixels.  The
+ *                photo is shown black until load_photo is called.
+ *   INPUTS: fname -- file name for input (must remain valid, as the photo
+ *                    is loaded from it later)
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to newly allocated photo on success, or NULL
+ *                 on failure
+ *   SIDE EFFECTS: dynamically allocates memory for the photo
+ */
+photo_t*
+read_photo_header (const char* fname)
 {
     FILE*    in;	/* input file               */
     photo_t* p = NULL;	/* photo structure          */
-    uint16_t x;		/* index over image columns */
-    uint16_t y;		/* index over image rows    */
-    uint16_t pixel;	/* one pixel from the file  */
-
-	unsigned long redp; 
-	unsigned long greenp; 
-	unsigned long bluep; 		
-	unsigned long pixel_4;	
-	unsigned long pixel_4_idx; 
-	unsigned long pixel_2_idx;
 
     /* 
      * Open the file, allocate the structure, read the header, do some
@@ -454,17 +682,13 @@ read_photo (const char* fname)
      * If anything fails, clean up as necessary and return NULL.
      */
     if (NULL == (in = fopen (fname, "r+b")) ||
-	NULL == (p = malloc (sizeof (*p))) ||
-	NULL != (p->img = NULL) || /* false clause for initialization */
+	NULL == (p = calloc (1, sizeof (*p))) ||
 	1 != fread (&p->hdr, sizeof (p->hdr), 1, in) ||
 	MAX_PHOTO_WIDTH < p->hdr.width ||
 	MAX_PHOTO_HEIGHT < p->hdr.height ||
-	NULL == (p->img = malloc 
-		 (p->hdr.width * p->hdr.height * sizeof (p->img[0])))) {
+	NULL == (p->img = calloc 
+		 (p->hdr.width * p->hdr.height, sizeof (p->img[0])))) {
 	if (NULL != p) {
-	    if (NULL != p->img) {
-	        free (p->img);
-	    }
 	    free (p);
 	}
 	if (NULL != in) {
@@ -472,6 +696,78 @@ read_photo (const char* fname)
 	}
 	return NULL;
     }
+    p->fname = fname;
+
+    (void)fclose (in);
+    return p;
+}
+
+
+/* 
+ * load_photo
+ *   DESCRIPTION: Read the pixel data of a photo created by 
+ *                read_photo_header, choose its palette, and map its 
+ *                pixels into the palette colors.  Whether or not this 
+ *                succeeds, the photo is marked as loaded, waking any 
+ *                threads waiting for it.  Not reentrant: only one thread
+ *                may load photos at a time.
+ *   INPUTS: p -- the photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (the photo may then be 
+ *                 partly or entirely black)
+ *   SIDE EFFECTS: fills in the photo's palette and pixels
+ */
+int32_t
+load_photo (photo_t* p)
+{
+    int32_t  ret_val;	/* return value             */
+
+    ret_val = read_photo_data (p);
+
+    (void)pthread_mutex_lock (&load_lock);
+    __atomic_store_n (&p->loaded, (0 == ret_val ? 1 : -1), __ATOMIC_RELEASE);
+    (void)pthread_cond_broadcast (&load_cv);
+    (void)pthread_mutex_unlock (&load_lock);
+
+    return ret_val;
+}
+
+
+/* 
+ * read_photo_data
+ *   DESCRIPTION: Read the pixel data of a photo, choose its palette, and
+ *                map its pixels into the palette colors.  Colors are 
+ *                chosen with an octree: the 128 most common level-4 
+ *                colors are used as they are, and all other pixels use
+ *                one of 64 level-2 colors.
+ *   INPUTS: p -- the photo (with header already read)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: fills in the photo's palette and pixels
+ */
+static int32_t
+read_photo_data (photo_t* p)
+{
+    FILE*    in;	/* input file               */
+    uint16_t x;		/* index over image columns */
+    uint16_t y;		/* index over image rows    */
+    uint16_t pixel;	/* one pixel from the file  */
+
+	unsigned long redp; 
+	unsigned long greenp; 
+	unsigned long bluep; 		
+	unsigned long pixel_4;	
+	unsigned long pixel_4_idx; 
+	unsigned long pixel_2_idx;
+
+    /* Open the file and skip over the header. */
+    if (NULL == (in = fopen (p->fname, "r+b"))) {
+	return -1;
+    }
+    if (0 != fseek (in, sizeof (p->hdr), SEEK_SET)) {
+	(void)fclose (in);
+	return -1;
+    }
 
 //my code starts here 
 
@@ -506,10 +802,8 @@ read_photo (const char* fname)
 	     * return NULL.
 	     */
 	    if (1 != fread (&pixel, sizeof (pixel), 1, in)) {
-		free (p->img);
-		free (p);
 	        (void)fclose (in);
-		return NULL;
+		return -1;
 
 	    }
 	    /* 
@@ -581,11 +875,9 @@ read_photo (const char* fname)
  		for (y = p->hdr.height; y-- > 0; ) {   // loop through the image rows 
 			for (x = 0; p->hdr.width > x; x++) {  // loop through the pixels in the current row from left to right
 				
-				if (1 != fread (&pixel, sizeof (pixel), 1, in)) { // read a single pixel from the input file - if not successful, free memory and return NULL
-					free (p->img);
-					free (p);
+				if (1 != fread (&pixel, sizeof (pixel), 1, in)) { // read a single pixel from the input file - if not successful, return failure
 	        		(void)fclose (in);
-					return NULL;
+					return -1;
 				}
 
 				redp = (pixel >> 11) << 1; // saves all values of the red bits in pixel (16 bit value), shifts 1 left to make it 6 bit and saved in redp, and shifts right by 11 initially to get rid of other bits 
@@ -616,8 +908,189 @@ read_photo (const char* fname)
 	
     /* All done.  Return success. */
     (void)fclose (in);
-    return p;
+    return 0;
+
+}
+
+
+/* 
+ * photo_is_loaded
+ *   DESCRIPTION: Check whether a photo has been loaded successfully.
+ *   INPUTS: p -- the photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the photo can be shown, 0 if not (including when
+ *                 reading it failed)
+ *   SIDE EFFECTS: none
+ */
+int32_t
+photo_is_loaded (const photo_t* p)
+{
+    return (1 == __atomic_load_n (&p->loaded, __ATOMIC_ACQUIRE));
+}
+
+
+/* 
+ * wait_for_photo
+ *   DESCRIPTION: Wait until load_photo has finished with a photo.  If
+ *                the loader thread is running, it is asked to load the 
+ *                photo next; if not, the photo is loaded by the caller.
+ *   INPUTS: p -- the photo
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the photo was loaded, or -1 if reading it failed
+ *   SIDE EFFECTS: may load the photo; updates statistics
+ */
+int32_t
+wait_for_photo (photo_t* p)
+{
+    struct timespec start;  /* time at which waiting began */
+    struct timespec done;   /* time at which waiting ended */
+    int32_t         loaded; /* the photo's loaded field    */
+
+    if (0 != (loaded = __atomic_load_n (&p->loaded, __ATOMIC_ACQUIRE))) {
+	return (1 == loaded ? 0 : -1);
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &start);
+    (void)pthread_mutex_lock (&load_lock);
+    while (0 == p->loaded) {
+	if (!loader_active) {
+	    (void)pthread_mutex_unlock (&load_lock);
+	    (void)load_photo (p);
+	    (void)pthread_mutex_lock (&load_lock);
+	    continue;
+	}
+	loader_urgent = p;
+	(void)pthread_cond_wait (&load_cv, &load_lock);
+    }
+    (void)clock_gettime (CLOCK_MONOTONIC, &done);
+    load_stats.waits++;
+    load_stats.wait_usec += (done.tv_sec - start.tv_sec) * 1000000LL +
+			    (done.tv_nsec - start.tv_nsec) / 1000;
+    loaded = p->loaded;
+    (void)pthread_mutex_unlock (&load_lock);
+
+    return (1 == loaded ? 0 : -1);
+}
+
+
+/* 
+ * start_photo_loader
+ *   DESCRIPTION: Start a thread that loads photos in the background, in
+ *                the order given (skipping any already loaded), except 
+ *                that photos needed by wait_for_photo are loaded first.
+ *                No other thread may call load_photo while the loader
+ *                is running.
+ *   INPUTS: order -- the photos to load (must remain valid)
+ *           count -- number of photos in order
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: creates a thread
+ */
+int32_t
+start_photo_loader (photo_t* const* order, int32_t count)
+{
+    loader_order = order;
+    loader_count = count;
+    loader_stop = 0;
+    loader_active = 1;
+    if (0 != pthread_create (&loader_id, NULL, photo_loader, NULL)) {
+	loader_active = 0;
+	return -1;
+    }
+    loader_started = 1;
+    return 0;
+}
+
+
+/* 
+ * stop_photo_loader
+ *   DESCRIPTION: Stop the background photo loader (after the photo that
+ *                it is loading, if any) and wait for it to end.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: ends a thread
+ */
+void
+stop_photo_loader ()
+{
+    if (!loader_started) {
+	return;
+    }
+    (void)pthread_mutex_lock (&load_lock);
+    loader_stop = 1;
+    (void)pthread_mutex_unlock (&load_lock);
+    (void)pthread_join (loader_id, NULL);
+    loader_started = 0;
+}
+
+
+/* 
+ * get_photo_load_stats
+ *   DESCRIPTION: Get statistics for background photo loading.
+ *   INPUTS: none
+ *   OUTPUTS: stats -- the statistics
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+get_photo_load_stats (photo_load_stats_t* stats)
+{
+    (void)pthread_mutex_lock (&load_lock);
+    *stats = load_stats;
+    (void)pthread_mutex_unlock (&load_lock);
+}
+
+
+/* 
+ * photo_loader
+ *   DESCRIPTION: Thread function for the background photo loader.  Loads
+ *                each photo that is not yet loaded, taking any photo that
+ *                the game is waiting for first.
+ *   INPUTS: ignore -- ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: loads photos; records photos that cannot be read in the
+ *                 load statistics (nothing is printed, as the screen may
+ *                 be in mode X)
+ */
+static void*
+photo_loader (void* ignore)
+{
+    int32_t  next = 0; /* index of next photo in order */
+    photo_t* p;        /* photo to be loaded           */
+    int32_t  failed;   /* photo could not be loaded    */
+
+    (void)pthread_mutex_lock (&load_lock);
+    while (!loader_stop) {
+	/* Choose the photo to load. */
+	if (NULL != loader_urgent && 0 == loader_urgent->loaded) {
+	    p = loader_urgent;
+	} else {
+	    while (loader_count > next && 0 != loader_order[next]->loaded) {
+		next++;
+	    }
+	    if (loader_count == next) {
+		break;
+	    }
+	    p = loader_order[next];
+	}
+	loader_urgent = NULL;
+
+	/* Load it without holding the lock. */
+	(void)pthread_mutex_unlock (&load_lock);
+	failed = load_photo (p);
+	(void)pthread_mutex_lock (&load_lock);
+	if (0 == failed) {
+	    load_stats.loaded++;
+	} else if (0 == load_stats.failed++) {
+	    load_stats.first_failed = p->fname;
+	}
+    }
+    loader_active = 0;
+    (void)pthread_cond_broadcast (&load_cv);
+    (void)pthread_mutex_unlock (&load_lock);
 
+    return NULL;
 }
 
 int compare(const void *a, const void *b){
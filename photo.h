@@ -53,9 +53,32 @@
 #define MAX_OBJECT_HEIGHT 100
 
 
+/* 
+ * A snapshot of what a room shows, taken by snap_room: the room's photo
+ * and the position, size, and image of each object in it (as parallel 
+ * arrays, like those of room_objects).  Since photo and image data never
+ * change once loaded, a snapshot can be drawn from any thread while the 
+ * world goes on changing.
+ */
+#define SNAP_MAX_OBJS 16
+typedef struct room_snap_t room_snap_t;
+struct room_snap_t {
+    const photo_t* view;		/* room photo                        */
+    int32_t        n_objs;		/* objects recorded (-1 if too many) */
+    uint16_t       x[SNAP_MAX_OBJS];	/* locations within room photo       */
+    uint16_t       y[SNAP_MAX_OBJS];
+    uint16_t       w[SNAP_MAX_OBJS];	/* image sizes                       */
+    uint16_t       h[SNAP_MAX_OBJS];
+    image_t*       img[SNAP_MAX_OBJS];	/* images of objects                 */
+};
+
 /* Fill a buffer with the pixels for a horizontal line of current room. */
 extern void fill_horiz_buffer (int x, int y, unsigned char buf[SCROLL_X_DIM]);
 
+/* Fill a buffer with the pixels for a horizontal line of a room snapshot. */
+extern void fill_snap_buffer (const room_snap_t* snap, int x, int y, 
+			      unsigned char buf[SCROLL_X_DIM]);
+
 /* Fill a buffer with the pixels for a vertical line of current room. */
 extern void fill_vert_buffer (int x, int y, unsigned char buf[SCROLL_Y_DIM]);
 
@@ -77,12 +100,65 @@ extern uint32_t photo_width (const photo_t* p);
  */
 extern void prep_room (const room_t* r);
 
+/* Prepare room for display, using an already-built palette fade ramp. */
+extern void prep_room_ramp 
+		(const room_t* r, 
+		 const unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3]);
+
+/* Record what a room shows (call only from the thread changing the world). */
+extern void snap_room (const room_t* r, room_snap_t* snap);
+
+/* Build the palette fade ramp for the photo in a room snapshot. */
+extern void snap_fade_ramp (const room_snap_t* snap, 
+			    unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3]);
+
 /* Read object image from a file into a dynamically allocated structure. */
 extern image_t* read_obj_image (const char* fname);
 
 /* Read room photo from a file into a dynamically allocated structure. */
 extern photo_t* read_photo (const char* fname);
 
+/* 
+ * Read only the size of a room photo from a file into a dynamically 
+ * allocated structure; the rest is read later by load_photo.
+ */
+extern photo_t* read_photo_header (const char* fname);
+
+/* Read the palette and pixels of a photo (one thread at a time). */
+extern int32_t load_photo (photo_t* p);
+
+/* Check whether a photo has been loaded (and reading it succeeded). */
+extern int32_t photo_is_loaded (const photo_t* p);
+
+/* 
+ * Wait for a photo to be loaded (loading it next, or now).  Returns 0, or
+ * -1 if reading the photo failed.
+ */
+extern int32_t wait_for_photo (photo_t* p);
+
+/*
+ * Statistics for loading photos in the background: photos loaded by the
+ * loader thread, those that could not be read (and the file name of the
+ * first, so that the game can report it once out of mode X), and the 
+ * number of times (and total time) that the game had to wait for a photo
+ * to be shown.
+ */
+typedef struct photo_load_stats_t photo_load_stats_t;
+struct photo_load_stats_t {
+    uint32_t loaded;	/* photos loaded in background      */
+    uint32_t failed;	/* photos that could not be read    */
+    const char* first_failed; /* first photo not read, or NULL */
+    uint32_t waits;	/* times game waited for a photo    */
+    uint64_t wait_usec;	/* total time spent waiting (usec)  */
+};
+
+/* Start and stop loading photos in the background, in the given order. */
+extern int32_t start_photo_loader (photo_t* const* order, int32_t count);
+extern void stop_photo_loader (void);
+
+/* Get statistics for background photo loading. */
+extern void get_photo_load_stats (photo_load_stats_t* stats);
+
 
 extern int compare(const void *a, const void *b);
 
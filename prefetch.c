@@ -0,0 +1,375 @@
+/*									tab:8
+ *
+ * prefetch.c - background drawing of neighbouring rooms
+ *
+ * Filename:	    prefetch.c
+ * History:
+ *		1	Drew the rooms next to the player's room in the
+ *			background so that moving into them is immediate.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "photo.h"
+#include "prefetch.h"
+#include "world.h"
+
+
+/*
+ * After each room change, the event loop calls prefetch_neighbours, which
+ * takes a snapshot (see snap_room) of each room that the player can reach
+ * with a single left, enter, or right command, and hands the snapshots to
+ * a worker thread.  The worker draws each one into a slot: the image that
+ * is shown on entering the room and the fade ramp for its palette.  The
+ * worker uses only the snapshot and photo and image data, which never
+ * change, so the event loop goes on changing the world meanwhile.
+ *
+ * On the next room change, prefetch_claim looks for a slot holding the
+ * new room.  It is used only if a new snapshot of the room matches the
+ * one from which it was drawn, so changes to the room after drawing (an
+ * object picked up or dropped, or a different photo) are never shown
+ * stale.  Then prefetch_neighbours starts again.  Drawing for rooms that
+ * are no longer neighbours is cancelled: each change of generation is
+ * noticed by the worker between lines.
+ *
+ * All variables below are protected by pf_lock, except that the worker
+ * reads pf_gen without the lock while drawing, and that the slot being
+ * drawn (busy_slot) belongs to the worker until it is done.
+ */
+typedef enum {SLOT_EMPTY, SLOT_PENDING, SLOT_READY} slot_state_t;
+typedef struct slot_t slot_t;
+struct slot_t {
+    slot_state_t     state;  /* drawing state of slot                  */
+    const room_t*    room;   /* room drawn in slot (if not empty)      */
+    room_snap_t      snap;   /* snapshot from which room is drawn      */
+    prefetch_frame_t frame;  /* image and palette of room              */
+};
+
+static slot_t           slot[PREFETCH_SLOTS];
+static pthread_t        worker_id;
+static int32_t          worker_running = 0;
+static pthread_mutex_t  pf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   idle_cv = PTHREAD_COND_INITIALIZER;
+static uint32_t         pf_gen;       /* changes to cancel drawing      */
+static slot_t*          busy_slot;    /* slot being drawn (or NULL)     */
+static int32_t          pf_hold;      /* worker must not start drawing  */
+static int32_t          pf_stop;      /* worker must end                */
+static prefetch_stats_t pf_stats;
+
+
+/* local functions--see function headers for details */
+static void* prefetch_worker (void* ignore);
+static int32_t draw_slot (slot_t* s, uint32_t gen);
+static void wait_for_worker (const room_t* keep);
+static int32_t slot_is_current (const slot_t* s, const room_t* r);
+
+
+/*
+ * start_prefetch
+ *   DESCRIPTION: Start the background drawing thread.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: creates a thread
+ */
+int32_t
+start_prefetch ()
+{
+    pf_stop = 0;
+    pf_hold = 0;
+    if (0 != pthread_create (&worker_id, NULL, prefetch_worker, NULL)) {
+	return -1;
+    }
+    worker_running = 1;
+    return 0;
+}
+
+
+/*
+ * stop_prefetch
+ *   DESCRIPTION: Stop the background drawing thread, abandoning any
+ *                drawing in progress, and wait for it to end.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: ends a thread
+ */
+void
+stop_prefetch ()
+{
+    if (!worker_running) {
+	return;
+    }
+    (void)pthread_mutex_lock (&pf_lock);
+    pf_stop = 1;
+    __atomic_add_fetch (&pf_gen, 1, __ATOMIC_RELAXED);
+    (void)pthread_cond_signal (&work_cv);
+    (void)pthread_mutex_unlock (&pf_lock);
+    (void)pthread_join (worker_id, NULL);
+    worker_running = 0;
+}
+
+
+/*
+ * prefetch_claim
+ *   DESCRIPTION: Find a prefetched image of a room that the player is
+ *                entering.  If the room is being drawn at the moment,
+ *                waits for it to be finished; other drawing is cancelled.
+ *                The worker then starts no new drawing until the next
+ *                call to prefetch_neighbours.
+ *   INPUTS: r -- the room being entered
+ *   OUTPUTS: none
+ *   RETURN VALUE: the prefetched room, or NULL if none can be used
+ *   SIDE EFFECTS: none
+ */
+const prefetch_frame_t*
+prefetch_claim (const room_t* r)
+{
+    const prefetch_frame_t* frame; /* prefetched room */
+    int32_t                 idx;   /* index over slots */
+
+    (void)pthread_mutex_lock (&pf_lock);
+    pf_hold = 1;
+    wait_for_worker (r);
+    frame = NULL;
+    for (idx = 0; PREFETCH_SLOTS > idx; idx++) {
+	if (slot_is_current (&slot[idx], r)) {
+	    frame = &slot[idx].frame;
+	    break;
+	}
+    }
+    if (NULL != frame) {
+	pf_stats.hits++;
+    } else {
+	pf_stats.misses++;
+    }
+    (void)pthread_mutex_unlock (&pf_lock);
+
+    return frame;
+}
+
+
+/*
+ * prefetch_neighbours
+ *   DESCRIPTION: Start drawing the rooms next to the player's room.  Rooms
+ *                already drawn and unchanged are kept; slots holding any
+ *                other rooms are reused (after cancelling any drawing).
+ *   INPUTS: r -- the player's room
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: takes snapshots of the neighbouring rooms
+ */
+void
+prefetch_neighbours (const room_t* r)
+{
+    const room_t* nbr[PREFETCH_SLOTS];  /* neighbouring rooms      */
+    const room_t* want[PREFETCH_SLOTS]; /* rooms to be drawn       */
+    int32_t       keep[PREFETCH_SLOTS]; /* slot is kept as it is   */
+    int32_t       w_idx;                /* index over wanted rooms */
+    int32_t       idx;                  /* index over slots        */
+
+    nbr[0] = room_left (r);
+    nbr[1] = room_enter (r);
+    nbr[2] = room_right (r);
+
+    (void)pthread_mutex_lock (&pf_lock);
+    wait_for_worker (NULL);
+
+    /* Drop duplicate rooms, and rooms that are already drawn. */
+    for (idx = 0; PREFETCH_SLOTS > idx; idx++) {
+	keep[idx] = 0;
+    }
+    for (w_idx = 0; PREFETCH_SLOTS > w_idx; w_idx++) {
+	want[w_idx] = nbr[w_idx];
+	if (NULL == nbr[w_idx] || r == nbr[w_idx] ||
+	    (0 < w_idx && nbr[w_idx] == nbr[0]) ||
+	    (2 == w_idx && nbr[2] == nbr[1])) {
+	    want[w_idx] = NULL;
+	    continue;
+	}
+	for (idx = 0; PREFETCH_SLOTS > idx; idx++) {
+	    if (!keep[idx] && slot_is_current (&slot[idx], want[w_idx])) {
+		keep[idx] = 1;
+		want[w_idx] = NULL;
+		break;
+	    }
+	}
+    }
+
+    /* Put the remaining rooms in the other slots. */
+    for (idx = 0, w_idx = 0; PREFETCH_SLOTS > idx; idx++) {
+	if (keep[idx]) {
+	    continue;
+	}
+	slot[idx].state = SLOT_EMPTY;
+	while (PREFETCH_SLOTS > w_idx && NULL == want[w_idx]) {
+	    w_idx++;
+	}
+	if (PREFETCH_SLOTS == w_idx) {
+	    continue;
+	}
+	slot[idx].room = want[w_idx];
+	snap_room (want[w_idx], &slot[idx].snap);
+	if (0 <= slot[idx].snap.n_objs) {
+	    slot[idx].state = SLOT_PENDING;
+	}
+	w_idx++;
+    }
+
+    pf_hold = 0;
+    (void)pthread_cond_signal (&work_cv);
+    (void)pthread_mutex_unlock (&pf_lock);
+}
+
+
+/*
+ * prefetch_get_stats
+ *   DESCRIPTION: Get prefetch statistics.
+ *   INPUTS: none
+ *   OUTPUTS: stats -- the statistics
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+prefetch_get_stats (prefetch_stats_t* stats)
+{
+    (void)pthread_mutex_lock (&pf_lock);
+    *stats = pf_stats;
+    (void)pthread_mutex_unlock (&pf_lock);
+}
+
+
+/*
+ * prefetch_worker
+ *   DESCRIPTION: Thread function for background drawing.  Draws each
+ *                pending slot in turn, and waits when there are none.
+ *   INPUTS: ignore -- ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: draws into slots
+ */
+static void*
+prefetch_worker (void* ignore)
+{
+    slot_t*  s;    /* slot to be drawn              */
+    uint32_t gen;  /* generation when drawing began */
+    int32_t  done; /* slot was drawn completely     */
+    int32_t  idx;  /* index over slots              */
+
+    (void)pthread_mutex_lock (&pf_lock);
+    while (1) {
+	/* Wait for a pending slot. */
+	s = NULL;
+	while (!pf_stop) {
+	    if (!pf_hold) {
+		for (idx = 0; PREFETCH_SLOTS > idx; idx++) {
+		    if (SLOT_PENDING == slot[idx].state) {
+			s = &slot[idx];
+			break;
+		    }
+		}
+		if (NULL != s) {
+		    break;
+		}
+	    }
+	    (void)pthread_cond_wait (&work_cv, &pf_lock);
+	}
+	if (pf_stop) {
+	    break;
+	}
+
+	/* Draw it without holding the lock. */
+	busy_slot = s;
+	gen = pf_gen;
+	(void)pthread_mutex_unlock (&pf_lock);
+	done = draw_slot (s, gen);
+	(void)pthread_mutex_lock (&pf_lock);
+	busy_slot = NULL;
+	if (done) {
+	    s->state = SLOT_READY;
+	    pf_stats.drawn++;
+	} else {
+	    s->state = SLOT_EMPTY;
+	    pf_stats.cancelled++;
+	}
+	(void)pthread_cond_broadcast (&idle_cv);
+    }
+    (void)pthread_mutex_unlock (&pf_lock);
+
+    return NULL;
+}
+
+
+/*
+ * draw_slot
+ *   DESCRIPTION: Draw the room in a slot from its snapshot, giving up if
+ *                the generation changes part way through.
+ *   INPUTS: s -- the slot
+ *           gen -- generation when drawing began
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if drawn, or 0 if cancelled
+ *   SIDE EFFECTS: draws into slot
+ */
+static int32_t
+draw_slot (slot_t* s, uint32_t gen)
+{
+    int32_t y; /* index over lines */
+
+    snap_fade_ramp (&s->snap, s->frame.ramp);
+    for (y = 0; SCROLL_Y_DIM > y; y++) {
+	if (gen != __atomic_load_n (&pf_gen, __ATOMIC_RELAXED)) {
+	    return 0;
+	}
+	fill_snap_buffer (&s->snap, 0, y, &s->frame.img[y * SCROLL_X_DIM]);
+    }
+    return 1;
+}
+
+
+/*
+ * wait_for_worker
+ *   DESCRIPTION: Wait until the worker is not drawing.  Drawing of the
+ *                given room is allowed to finish; any other drawing is
+ *                cancelled.  Must be called with pf_lock held.
+ *   INPUTS: keep -- room whose drawing is to be finished (or NULL)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may cancel drawing
+ */
+static void
+wait_for_worker (const room_t* keep)
+{
+    if (NULL != busy_slot && keep != busy_slot->room) {
+	__atomic_add_fetch (&pf_gen, 1, __ATOMIC_RELAXED);
+    }
+    while (NULL != busy_slot) {
+	(void)pthread_cond_wait (&idle_cv, &pf_lock);
+    }
+}
+
+
+/*
+ * slot_is_current
+ *   DESCRIPTION: Check whether a slot holds a finished drawing of a room
+ *                that still shows what it showed when it was drawn.  Must
+ *                be called with pf_lock held and the worker idle.
+ *   INPUTS: s -- the slot
+ *           r -- the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the slot can be shown for the room, or 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+slot_is_current (const slot_t* s, const room_t* r)
+{
+    room_snap_t snap; /* current snapshot of room */
+
+    if (SLOT_READY != s->state || r != s->room) {
+	return 0;
+    }
+    snap_room (r, &snap);
+    return (0 == memcmp (&snap, &s->snap, sizeof (snap)));
+}
@@ -0,0 +1,73 @@
+/*									tab:8
+ *
+ * prefetch.h - header file for background drawing of neighbouring rooms
+ *
+ * Filename:	    prefetch.h
+ * History:
+ *		1	Drew the rooms next to the player's room in the
+ *			background so that moving into them is immediate.
+ */
+
+#if !defined(PREFETCH_H)
+#define PREFETCH_H
+
+
+#include <stdint.h>
+
+#include "modex.h"
+#include "types.h"
+
+
+/*
+ * The number of rooms that can be drawn ahead of time: one for each of
+ * the "left," "enter," and "right" neighbours of the player's room.  Each
+ * takes a little under 60 kB (see prefetch_frame_t), and no other memory
+ * is used.
+ */
+#define PREFETCH_SLOTS 3
+
+/*
+ * A room drawn ahead of time: the image of the view window at (0,0), as
+ * it is shown on entering the room, and the fade ramp for the palette of
+ * the room's photo.
+ */
+typedef struct prefetch_frame_t prefetch_frame_t;
+struct prefetch_frame_t {
+    unsigned char img[SCROLL_Y_DIM * SCROLL_X_DIM];
+    unsigned char ramp[PALETTE_FADE_STEPS + 1][192][3];
+};
+
+/*
+ * Statistics kept by the prefetcher.  A hit is a room entry that used a
+ * room drawn ahead of time; a miss is one that had to draw the room.  A
+ * room is cancelled when the player moves elsewhere while it is drawn.
+ */
+typedef struct prefetch_stats_t prefetch_stats_t;
+struct prefetch_stats_t {
+    uint32_t hits;	    /* room entries using a prefetched room */
+    uint32_t misses;	    /* room entries drawing the room        */
+    uint32_t drawn;	    /* rooms drawn ahead of time            */
+    uint32_t cancelled;     /* rooms abandoned part way through     */
+};
+
+/* Start and stop the background drawing thread. */
+extern int32_t start_prefetch (void);
+extern void stop_prefetch (void);
+
+/*
+ * Find a prefetched image of a room that the player is entering.  Returns
+ * NULL if the room was not drawn ahead of time or has changed since.  The
+ * frame remains valid until the next call to prefetch_neighbours.
+ */
+extern const prefetch_frame_t* prefetch_claim (const room_t* r);
+
+/*
+ * Start drawing the neighbours of the player's room, abandoning any
+ * drawing for rooms that are no longer neighbours.
+ */
+extern void prefetch_neighbours (const room_t* r);
+
+/* Get prefetch statistics. */
+extern void prefetch_get_stats (prefetch_stats_t* stats);
+
+#endif /* PREFETCH_H */
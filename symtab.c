@@ -0,0 +1,196 @@
+/*									tab:8
+ *
+ * symtab.c - table of interned names
+ *
+ * Filename:	    symtab.c
+ * History:
+ *		1	Interned object and room names so that typed names
+ *			are compared once, by hashing, rather than against
+ *			each object.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "symtab.h"
+
+
+/*
+ * The names are kept in lower case in sym_name, indexed by symbol.  They
+ * are found through an open-addressed hash table (linear probing) holding
+ * symbol + 1 in each used slot, so that empty slots hold 0.  The table
+ * size is a power of two, and the table is doubled whenever it becomes
+ * half full.
+ */
+#define SYM_MIN_SLOTS 64
+static char**   sym_name;	/* names by symbol            */
+static int32_t  n_syms;		/* number of symbols          */
+static int32_t  max_syms;	/* space in sym_name          */
+static int32_t* sym_slot;	/* hash table of symbol + 1   */
+static int32_t  n_slots;	/* size of hash table         */
+
+static uint32_t hash_name (const char* name);
+static int32_t find_slot (const char* name, uint32_t hash);
+static int32_t grow_table (void);
+
+
+/*
+ * hash_name
+ *   DESCRIPTION: Hash a name, ignoring case (FNV-1a).
+ *   INPUTS: name -- the name
+ *   OUTPUTS: none
+ *   RETURN VALUE: the hash
+ *   SIDE EFFECTS: none
+ */
+static uint32_t
+hash_name (const char* name)
+{
+    uint32_t hash = 2166136261U; /* hash so far */
+
+    for (; '\0' != *name; name++) {
+	hash = (hash ^ (unsigned char)tolower (*name)) * 16777619U;
+    }
+    return hash;
+}
+
+
+/*
+ * find_slot
+ *   DESCRIPTION: Find the hash table slot holding a name, or the empty
+ *                slot at which it would be added.  The table must exist.
+ *   INPUTS: name -- the name
+ *           hash -- hash of the name
+ *   OUTPUTS: none
+ *   RETURN VALUE: index of the slot
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+find_slot (const char* name, uint32_t hash)
+{
+    int32_t slot; /* slot examined */
+
+    for (slot = hash & (n_slots - 1); 0 != sym_slot[slot];
+	 slot = (slot + 1) & (n_slots - 1)) {
+	if (0 == strcasecmp (name, sym_name[sym_slot[slot] - 1])) {
+	    break;
+	}
+    }
+    return slot;
+}
+
+
+/*
+ * grow_table
+ *   DESCRIPTION: Double the size of the hash table (or create it), and
+ *                add the existing symbols to the new table.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of memory
+ *   SIDE EFFECTS: replaces the hash table
+ */
+static int32_t
+grow_table ()
+{
+    int32_t* old = sym_slot;  /* previous table          */
+    int32_t  n_old = n_slots; /* size of previous table  */
+    int32_t  idx;	      /* index over symbols      */
+
+    n_slots = (0 == n_old ? SYM_MIN_SLOTS : 2 * n_old);
+    if (NULL == (sym_slot = calloc (n_slots, sizeof (sym_slot[0])))) {
+	sym_slot = old;
+	n_slots = n_old;
+	return -1;
+    }
+    for (idx = 0; n_syms > idx; idx++) {
+	sym_slot[find_slot (sym_name[idx], hash_name (sym_name[idx]))] =
+		idx + 1;
+    }
+    free (old);
+    return 0;
+}
+
+
+/*
+ * intern_name
+ *   DESCRIPTION: Get the symbol for a name, adding the name to the table
+ *                if it is not already there.
+ *   INPUTS: name -- the name
+ *   OUTPUTS: none
+ *   RETURN VALUE: the symbol, or SYM_NONE if out of memory
+ *   SIDE EFFECTS: may allocate memory
+ */
+int32_t
+intern_name (const char* name)
+{
+    int32_t slot;  /* hash table slot for name */
+    char**  names; /* larger array of names    */
+    char*   copy;  /* lower case copy of name  */
+    int32_t idx;   /* index over name          */
+
+    if (2 * (n_syms + 1) > n_slots && 0 != grow_table ()) {
+	return SYM_NONE;
+    }
+    slot = find_slot (name, hash_name (name));
+    if (0 != sym_slot[slot]) {
+	return sym_slot[slot] - 1;
+    }
+
+    /* Add the name. */
+    if (max_syms == n_syms) {
+	names = realloc (sym_name, 2 * (max_syms + 1) * sizeof (names[0]));
+	if (NULL == names) {
+	    return SYM_NONE;
+	}
+	sym_name = names;
+	max_syms = 2 * (max_syms + 1);
+    }
+    if (NULL == (copy = malloc (strlen (name) + 1))) {
+	return SYM_NONE;
+    }
+    for (idx = 0; '\0' != name[idx]; idx++) {
+	copy[idx] = tolower (name[idx]);
+    }
+    copy[idx] = '\0';
+    sym_name[n_syms] = copy;
+    sym_slot[slot] = ++n_syms;
+    return n_syms - 1;
+}
+
+
+/*
+ * find_name
+ *   DESCRIPTION: Get the symbol for a name without adding it.
+ *   INPUTS: name -- the name
+ *   OUTPUTS: none
+ *   RETURN VALUE: the symbol, or SYM_NONE if the name was never interned
+ *   SIDE EFFECTS: none
+ */
+int32_t
+find_name (const char* name)
+{
+    int32_t slot; /* hash table slot for name */
+
+    if (0 == n_slots) {
+	return SYM_NONE;
+    }
+    slot = find_slot (name, hash_name (name));
+    return sym_slot[slot] - 1;
+}
+
+
+/*
+ * symbol_count
+ *   DESCRIPTION: Get the number of names interned.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the number of symbols (all symbols are less than this)
+ *   SIDE EFFECTS: none
+ */
+int32_t
+symbol_count ()
+{
+    return n_syms;
+}
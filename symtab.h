@@ -0,0 +1,39 @@
+/*									tab:8
+ *
+ * symtab.h - header file for the table of interned names
+ *
+ * Filename:	    symtab.h
+ * History:
+ *		1	Interned object and room names so that typed names
+ *			are compared once, by hashing, rather than against
+ *			each object.
+ */
+
+#if !defined(SYMTAB_H)
+#define SYMTAB_H
+
+
+#include <stdint.h>
+
+
+/*
+ * Names are interned without regard to case: names that differ only in
+ * case get the same symbol.  Symbols are numbered from 0 in the order in
+ * which their names were first interned; SYM_NONE stands for a name that
+ * was never interned.
+ */
+#define SYM_NONE (-1)
+
+/* Get the symbol for a name, adding it if necessary (SYM_NONE on failure). */
+extern int32_t intern_name (const char* name);
+
+/*
+ * Get the symbol for a name, or SYM_NONE if it has not been interned.  May
+ * be called from several threads at once while no names are interned.
+ */
+extern int32_t find_name (const char* name);
+
+/* Get the number of symbols. */
+extern int32_t symbol_count (void);
+
+#endif /* SYMTAB_H */
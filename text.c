@@ -576,63 +576,129 @@ unsigned char font_data[256][16] = {
  */   
 
 void print_text( const char* text, unsigned char * buffer, int ca, const char *ptr)
+{
+    unsigned char string_to_print[STATUS_BAR_CHARS]; // the line of characters to be drawn 
+    int i;
+
+    layout_status_text(text, ca, ptr, string_to_print); // arranges the text into the line 
+    for ( i = 0; i< STATUS_BAR_CHARS ; i++){ // iterating through the 40 charcaters of the line 
+        print_char_cell(buffer, i, string_to_print[i]);
+    }
+}
+
+/*
+ * layout_status_text
+ *   DESCRIPTION: arranges the text for the status bar into a line of characters, without drawing anything 
+ *                 
+ *   INPUTS:text: a pointer to the string that is to be printed (can be a status message, or room name)
+            ca: 1 to put the text at the left with the typed command at the right, 0 to center the text 
+            ptr: the text typed by the user (shown at the right side of the status bar when ca is 1)
+ *   OUTPUTS: line: the 40 characters of the status bar (unused positions hold character 0, which is blank)
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */   
+
+void layout_status_text (const char* text, int ca, const char* ptr,
+			 unsigned char line[STATUS_BAR_CHARS])
 {
     int len = strlen(text); // length if the given inputted text 
-    unsigned int bit_wise; 
-    unsigned char string_to_print[40] = {""}; // initializing a blank buffer to store the text 
     int p;
-    int mid_offset = ((40 - (len))); // calculating the middle offset 
-    int plane_no = 4; 
-    int bit_no = 8; 
-    int status_width = 80 ; 
-    int status_length = 18 ; 
+    int mid_offset = ((STATUS_BAR_CHARS - (len))); // calculating the middle offset 
+
+    memset(line, 0, STATUS_BAR_CHARS); // initializing a blank line to store the text 
     if( ca == 1){ //checking if the text given is a room name 
       
         
         for (p = 0; p <len; p++){
-            string_to_print[p]= text[p]; // copying the original text into the render buffer 
+            line[p]= text[p]; // copying the original text into the render buffer 
         }
-        int blank_space = 40 - len - strlen(ptr) -1; // calculating the number of blank spaces inbetween the room name and whatver is being typed in the keyboard 
+        int blank_space = STATUS_BAR_CHARS - len - strlen(ptr) -1; // calculating the number of blank spaces inbetween the room name and whatver is being typed in the keyboard 
         int k;
         
         for(k =0; k<blank_space; k++){ 
-        string_to_print[len + k]= ' '; // fills the blank spaces with an empty character 
+        line[len + k]= ' '; // fills the blank spaces with an empty character 
         }
         for (p = 0; p<strlen(ptr); p++){
-            string_to_print[p+ len+ blank_space]= ptr[p]; // fills in the text characters of whatver the user inputs 
+            line[p+ len+ blank_space]= ptr[p]; // fills in the text characters of whatver the user inputs 
         }
         if (strlen(ptr) < 20){
-            string_to_print[39]= '_'; // at the end of the line fils in the cursor 
+            line[STATUS_BAR_CHARS - 1]= '_'; // at the end of the line fils in the cursor 
         }
     }
     else{
         for (p = 0; p<len ; p++){
-            string_to_print[p + mid_offset/2] = text[p];// if theres a status message, fills it in at the middle of the screen 
+            line[p + mid_offset/2] = text[p];// if theres a status message, fills it in at the middle of the screen 
         }
     }
+}
 
-    int mask;
-    int c; 
-    int i;
-    int j;
-    int x; 
-    for ( i = 0; i< 40 ; i++){ // iterating through the 40 charcaters of the buffer 
-        for (j = 0; j <= 15 ; j++){
-            bit_wise = font_data[(int)string_to_print[i]][j]; // retirves bitwise representation for the current characeter 
-            mask = 0x80; // value used to mask the bits (10000000 in binary)
-            for ( x = 0 ; x <bit_no; x++){ // going through the bits 
-                c = bit_wise & mask; // ands both the values to check if it a 0 or 1
-                if (c== mask){ 
-                    buffer[(status_width*(j+1))+(status_width*status_length*((i*bit_no+x)%plane_no))+(bit_no*i+x)/plane_no] = 0x15; 
-                    /*if its a 1 we add the text color to it and map it to the planes in the build buffer. Initially we calculate the row offset to the buffer
-                    and 1 to j so that we can leave space for the uppermost row. After that we compute the plane index (0,1,2,3) by %4. At the end we calculate 
-                    the column offset within current plane. 80 is the width of the row for the graphics display.  */ 
-                }
+/*
+ * Expanded glyph pixels.  Mode X splits each 8-pixel glyph row across
+ * the four planes, two pixels per plane: plane p gets pixels p and p+4,
+ * which land in adjacent bytes of the plane.  The table holds, for each
+ * possible font byte and each plane, the two pixel colors for that plane,
+ * so that drawing a glyph row takes a table lookup and two stores per 
+ * plane instead of a loop over bits.  The table is built on first use.
+ */
+static unsigned char glyph_pixels[256][4][2];
+static int glyph_pixels_ready = 0;
 
-                mask = mask >> 1 ; // shifting the bits right by 1 
-                
-                }
-            }
+/*
+ * expand_glyph_pixels
+ *   DESCRIPTION: fills in the glyph_pixels table from the font bit patterns 
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: fills glyph_pixels 
+ */   
+
+static void expand_glyph_pixels ()
+{
+    int bits; 
+    int p; 
+
+    for (bits = 0; bits < 256; bits++){ // every possible font byte 
+        for (p = 0; p < 4; p++){ // pixel p goes to the first byte of plane p and pixel p+4 to the second 
+            glyph_pixels[bits][p][0] = ((bits & (0x80 >> p)) ? STATUS_FG_COLOR : STATUS_BG_COLOR); 
+            glyph_pixels[bits][p][1] = ((bits & (0x08 >> p)) ? STATUS_FG_COLOR : STATUS_BG_COLOR); 
         }
     }
+    glyph_pixels_ready = 1;
+}
+
+/*
+ * print_char_cell
+ *   DESCRIPTION: draws one character cell (8x16 pixels) of the status bar, both the text and background pixels, 
+ *                so that a cell can be redrawn without redrawing the rest of the bar 
+ *   INPUTS: buffer: the status bar image (four planes of 18 rows x 80 bytes)
+            cell: which of the 40 character positions to draw
+            ch: the character to draw there
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites the pixels of the cell in the buffer 
+ */   
+
+void print_char_cell (unsigned char* buffer, int cell, unsigned char ch)
+{
+    int plane_no = 4; 
+    int status_width = 80 ; 
+    int status_length = 18 ; 
+    const unsigned char* pix; 
+    unsigned char* row; 
+    int j;
+    int p; 
+
+    if (!glyph_pixels_ready){
+        expand_glyph_pixels();
+    }
 
+    /* The cell covers bytes 2*cell and 2*cell+1 of each plane, below the blank top row. */
+    row = buffer + status_width + 2 * cell; 
+    for (j = 0; j <= 15 ; j++, row += status_width){
+        for (p = 0; p < plane_no; p++){
+            pix = glyph_pixels[font_data[ch][j]][p]; // the two pixels of this glyph row that go to plane p 
+            row[status_width*status_length*p] = pix[0]; 
+            row[status_width*status_length*p + 1] = pix[1]; 
+        }
+    }
+}
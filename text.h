@@ -40,7 +40,26 @@
 #define FONT_WIDTH   8
 #define FONT_HEIGHT 16
 
+/* 
+ * The status bar is a single line of STATUS_BAR_CHARS characters drawn
+ * in STATUS_FG_COLOR on STATUS_BG_COLOR.  Its image is STATUS_BAR_SIZE
+ * bytes, four planes of 18 rows of 80 bytes each, with a blank row above
+ * and below the text.
+ */
+#define STATUS_BAR_CHARS 40
+#define STATUS_BAR_SIZE  5760
+#define STATUS_FG_COLOR  0x15
+#define STATUS_BG_COLOR  11
+
 /* Standard VGA text font. */
 extern unsigned char font_data[256][16];
 void print_text( const char* text, unsigned char * buffer, int ca, const char *ptr);
+
+/* Arrange status bar text into a line of characters without drawing it. */
+extern void layout_status_text (const char* text, int ca, const char* ptr,
+				unsigned char line[STATUS_BAR_CHARS]);
+
+/* Draw one character cell of the status bar into a status bar image. */
+extern void print_char_cell (unsigned char* buffer, int cell, 
+			     unsigned char ch);
 #endif /* TEXT_H */
@@ -0,0 +1,328 @@
+/*									tab:8
+ *
+ * tick.c - event loop tick scheduler
+ *
+ * Filename:	    tick.c
+ * History:
+ *		1	Replaced busy-waiting game loop tick with absolute
+ *			sleeps on the monotonic clock.
+ *		2	Allowed the tick length to change while running.
+ *		3	Delivered ticks through a timerfd so that the event
+ *			loop can wait for ticks along with other events.
+ *		4	Reported the time left before the next tick.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tick.h"
+
+
+/* local functions--see function headers for details */
+static int32_t arm_timer (void);
+static void advance_time (struct timespec* t, int32_t usec);
+static void retard_time (struct timespec* t, int32_t usec);
+static int64_t usec_between (const struct timespec* t1,
+			     const struct timespec* t2);
+
+
+/* 
+ * The tick clock.  Tick start times are absolute times on CLOCK_MONOTONIC,
+ * so that the loop can sleep right up to the start of the next tick 
+ * (rather than spinning on the clock) and is not disturbed if someone
+ * sets the wall clock.  The ticks are delivered by a periodic timerfd,
+ * which becomes readable when a tick starts; reading it gives the number
+ * of ticks started since it was last read.
+ */
+static int             tick_fd = -1; /* timerfd that delivers ticks        */
+static struct timespec start_time;  /* time at which tick_start was called */
+static struct timespec tick_time;   /* start of the next tick              */
+static int32_t         tick_usec;   /* tick length in microseconds         */
+static tick_stats_t    stats;       /* statistics for tick_get_stats       */
+
+
+/* 
+ * tick_start
+ *   DESCRIPTION: Start the tick clock, with the first tick starting one
+ *                period from now.  Also clears the tick statistics.
+ *   INPUTS: period_usec -- tick length in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the clock or timer cannot be set up
+ *   SIDE EFFECTS: creates the tick timerfd
+ */
+int32_t
+tick_start (int32_t period_usec)
+{
+    if (0 > tick_fd && 
+	0 > (tick_fd = timerfd_create (CLOCK_MONOTONIC, 
+				       TFD_NONBLOCK | TFD_CLOEXEC))) {
+	return -1;
+    }
+    if (0 != clock_gettime (CLOCK_MONOTONIC, &start_time)) {
+	return -1;
+    }
+    tick_usec = period_usec;
+    tick_time = start_time;
+    advance_time (&tick_time, tick_usec);
+    (void)memset (&stats, 0, sizeof (stats));
+    return arm_timer ();
+}
+
+
+/* 
+ * tick_get_fd
+ *   DESCRIPTION: Get the file descriptor that becomes readable when a
+ *                tick starts (for use with poll, epoll, etc.).  Call
+ *                tick_expired when it does.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the descriptor, or -1 if the clock was never started
+ *   SIDE EFFECTS: none
+ */
+int
+tick_get_fd ()
+{
+    return tick_fd;
+}
+
+
+/* 
+ * tick_set_period
+ *   DESCRIPTION: Change the tick length.  The next tick is rescheduled to
+ *                start one new tick length after the start of the current
+ *                tick (if that time has already passed, the tick 
+ *                descriptor becomes readable immediately).
+ *   INPUTS: period_usec -- new tick length in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the timer cannot be set
+ *   SIDE EFFECTS: rearms the tick timer
+ */
+int32_t
+tick_set_period (int32_t period_usec)
+{
+    if (period_usec == tick_usec) {
+	return 0;
+    }
+    retard_time (&tick_time, tick_usec);
+    advance_time (&tick_time, period_usec);
+    tick_usec = period_usec;
+    return arm_timer ();
+}
+
+
+/* 
+ * tick_get_period
+ *   DESCRIPTION: Get the current tick length.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: tick length in microseconds
+ *   SIDE EFFECTS: none
+ */
+int32_t
+tick_get_period ()
+{
+    return tick_usec;
+}
+
+
+/* 
+ * tick_expired
+ *   DESCRIPTION: Account for the start of a tick; call when the tick
+ *                descriptor becomes readable.  If we missed one or more 
+ *                ticks completely, i.e., if more than one tick has started
+ *                since the last call, the extra ticks are skipped (and
+ *                counted as missed), and only the latest one is run.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a tick has started, 0 if not, -1 on error
+ *   SIDE EFFECTS: updates statistics
+ */
+int32_t
+tick_expired ()
+{
+    uint64_t        n_ticks;  /* ticks started since last read */
+    struct timespec cur_time; /* time of reading               */
+    int64_t         late;     /* wake-up lateness              */
+
+    if (sizeof (n_ticks) != read (tick_fd, &n_ticks, sizeof (n_ticks))) {
+	return (EAGAIN == errno ? 0 : -1);
+    }
+    if (0 != clock_gettime (CLOCK_MONOTONIC, &cur_time)) {
+	return -1;
+    }
+
+    /* Skip (and count) any missed ticks. */
+    stats.missed += n_ticks - 1;
+    while (1 < n_ticks--) {
+	advance_time (&tick_time, tick_usec);
+    }
+
+    /* Record how late we woke up for the tick that we run. */
+    late = usec_between (&tick_time, &cur_time);
+    if (0 > late) {
+	late = 0;
+    }
+    stats.ticks++;
+    stats.late_total_usec += late;
+    if (stats.late_max_usec < late) {
+	stats.late_max_usec = late;
+    }
+
+    /* Advance to the next tick. */
+    advance_time (&tick_time, tick_usec);
+    return 1;
+}
+
+
+/* 
+ * tick_elapsed_usec
+ *   DESCRIPTION: Get the number of microseconds since tick_start.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: elapsed microseconds (0 if the clock cannot be read)
+ *   SIDE EFFECTS: none
+ */
+int64_t
+tick_elapsed_usec ()
+{
+    struct timespec cur_time; /* current time */
+
+    if (0 != clock_gettime (CLOCK_MONOTONIC, &cur_time)) {
+	return 0;
+    }
+    return usec_between (&start_time, &cur_time);
+}
+
+
+/* 
+ * tick_remaining_usec
+ *   DESCRIPTION: Get the number of microseconds left before the start of
+ *                the next tick.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: microseconds to next tick (0 if it is already due, or
+ *                 if the clock cannot be read)
+ *   SIDE EFFECTS: none
+ */
+int64_t
+tick_remaining_usec ()
+{
+    struct timespec cur_time; /* current time        */
+    int64_t         left;     /* time left (usec)    */
+
+    if (0 != clock_gettime (CLOCK_MONOTONIC, &cur_time)) {
+	return 0;
+    }
+    left = usec_between (&cur_time, &tick_time);
+    return (0 < left ? left : 0);
+}
+
+
+/* 
+ * tick_elapsed_sec
+ *   DESCRIPTION: Get the number of whole seconds since tick_start.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: elapsed seconds (0 if the clock cannot be read)
+ *   SIDE EFFECTS: none
+ */
+int32_t
+tick_elapsed_sec ()
+{
+    return tick_elapsed_usec () / 1000000;
+}
+
+
+/* 
+ * tick_get_stats
+ *   DESCRIPTION: Get a copy of the tick scheduler statistics.
+ *   INPUTS: none
+ *   OUTPUTS: *st -- the statistics
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+tick_get_stats (tick_stats_t* st)
+{
+    *st = stats;
+}
+
+
+/* 
+ * arm_timer
+ *   DESCRIPTION: Set the tick timer to go off at the start of the next 
+ *                tick and every tick length thereafter.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+arm_timer ()
+{
+    struct itimerspec its; /* timer settings */
+
+    its.it_value = tick_time;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = tick_usec * 1000L;
+    return timerfd_settime (tick_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+
+/* 
+ * advance_time
+ *   DESCRIPTION: Add a number of microseconds to a time.
+ *   INPUTS: *t -- the time
+ *           usec -- microseconds to add (less than one second)
+ *   OUTPUTS: *t -- the later time
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+advance_time (struct timespec* t, int32_t usec)
+{
+    if (1000000000 <= (t->tv_nsec += usec * 1000L)) {
+	t->tv_sec++;
+	t->tv_nsec -= 1000000000;
+    }
+}
+
+
+/* 
+ * retard_time
+ *   DESCRIPTION: Subtract a number of microseconds from a time.
+ *   INPUTS: *t -- the time
+ *           usec -- microseconds to subtract (less than one second)
+ *   OUTPUTS: *t -- the earlier time
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+retard_time (struct timespec* t, int32_t usec)
+{
+    if (0 > (t->tv_nsec -= usec * 1000L)) {
+	t->tv_sec--;
+	t->tv_nsec += 1000000000;
+    }
+}
+
+
+/* 
+ * usec_between
+ *   DESCRIPTION: Calculate the time from one time to another.
+ *   INPUTS: t1 -- the earlier time
+ *           t2 -- the later time
+ *   OUTPUTS: none
+ *   RETURN VALUE: microseconds from t1 to t2 (negative if t2 is earlier)
+ *   SIDE EFFECTS: none
+ */
+static int64_t
+usec_between (const struct timespec* t1, const struct timespec* t2)
+{
+    return ((int64_t)(t2->tv_sec - t1->tv_sec) * 1000000 +
+	    (t2->tv_nsec - t1->tv_nsec) / 1000);
+}
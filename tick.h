@@ -0,0 +1,67 @@
+/*									tab:8
+ *
+ * tick.h - header file for the event loop tick scheduler
+ *
+ * Filename:	    tick.h
+ * History:
+ *		1	Replaced busy-waiting game loop tick with absolute
+ *			sleeps on the monotonic clock.
+ *		2	Allowed the tick length to change while running.
+ *		3	Delivered ticks through a timerfd so that the event
+ *			loop can wait for ticks along with other events.
+ *		4	Reported the time left before the next tick.
+ */
+
+#if !defined(TICK_H)
+#define TICK_H
+
+
+#include <stdint.h>
+
+
+/* 
+ * Statistics kept by the tick scheduler.  A tick is missed when the 
+ * event loop wakes up after the time at which the following tick should 
+ * already have started; such ticks are skipped rather than run late.
+ * Lateness is the time between a tick's scheduled start and the moment 
+ * that the event loop actually woke up for it.
+ */
+typedef struct tick_stats_t tick_stats_t;
+struct tick_stats_t {
+    uint32_t ticks;	       /* ticks run                         */
+    uint32_t missed;	       /* ticks skipped entirely            */
+    uint64_t late_total_usec;  /* total wake-up lateness (usec)     */
+    uint32_t late_max_usec;    /* worst wake-up lateness (usec)     */
+};
+
+/* Start the tick clock.  The first tick starts one period from now. */
+extern int32_t tick_start (int32_t period_usec);
+
+/* Get a descriptor that becomes readable when a tick starts. */
+extern int tick_get_fd (void);
+
+/* Change the tick length, starting with the next tick. */
+extern int32_t tick_set_period (int32_t period_usec);
+
+/* Get the current tick length in microseconds. */
+extern int32_t tick_get_period (void);
+
+/* 
+ * Account for the start of a tick when the tick descriptor is readable.
+ * Returns 1 if a tick has started, 0 if not, or -1 on error.
+ */
+extern int32_t tick_expired (void);
+
+/* Get the number of microseconds elapsed since tick_start. */
+extern int64_t tick_elapsed_usec (void);
+
+/* Get the number of microseconds left before the next tick starts. */
+extern int64_t tick_remaining_usec (void);
+
+/* Get the number of whole seconds elapsed since tick_start. */
+extern int32_t tick_elapsed_sec (void);
+
+/* Get a copy of the tick scheduler statistics. */
+extern void tick_get_stats (tick_stats_t* stats);
+
+#endif /* TICK_H */
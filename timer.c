@@ -0,0 +1,270 @@
+/*									tab:8
+ *
+ * timer.c - game-timed events
+ *
+ * Filename:	    timer.c
+ * History:
+ *		1	Replaced status message helper thread with timers run
+ *			by the event loop.
+ */
+
+#include <stddef.h>
+
+#include "tick.h"
+#include "timer.h"
+
+
+/* 
+ * The timers are kept in a hierarchical timer wheel.  Time is counted in
+ * units of TIMER_RES_USEC ("jiffies").  The first level has one slot for 
+ * each of the next 256 jiffies; each slot of the second level covers 256
+ * jiffies, and each slot of the third level covers 256 * 64 jiffies.  A
+ * timer is placed in a slot of the lowest level that reaches its expiry
+ * time, so scheduling and cancelling a timer take constant time.  Each 
+ * time that the first level wraps around, the next second-level slot is
+ * emptied into the first level (and similarly for the third level).  
+ * Timers further away than the wheel reaches (about 2.9 hours) are
+ * placed at the end of the wheel.
+ *
+ * The wheel is driven by the event loop, which calls timer_run on each
+ * tick, so timers expire on the first tick at or after their expiry 
+ * time.  Everything runs in the event loop thread, so no locks are needed.
+ */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL0_MASK (WHEEL0_SIZE - 1)
+#define WHEELN_MASK (WHEELN_SIZE - 1)
+#define WHEEL1_SPAN (1UL << (WHEEL0_BITS + WHEELN_BITS))
+#define WHEEL2_SPAN (1UL << (WHEEL0_BITS + 2 * WHEELN_BITS))
+
+static game_timer_t* wheel0[WHEEL0_SIZE];
+static game_timer_t* wheel1[WHEELN_SIZE];
+static game_timer_t* wheel2[WHEELN_SIZE];
+static uint32_t cur_jiffy;  /* next jiffy to be run */
+
+
+/* local functions--see function headers for details */
+static void add_timer (game_timer_t* t);
+static void cascade (game_timer_t** slot);
+static void unlink_timer (game_timer_t* t);
+
+
+/* 
+ * timer_setup
+ *   DESCRIPTION: Prepare a timer for use.
+ *   INPUTS: t -- the timer
+ *           fn -- function to call when the timer expires
+ *           arg -- argument to pass to fn
+ *   OUTPUTS: *t -- an idle timer
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+timer_setup (game_timer_t* t, timer_fn_t fn, void* arg)
+{
+    t->next = NULL;
+    t->pprev = NULL;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+
+/* 
+ * timer_schedule
+ *   DESCRIPTION: Schedule a timer to expire after a delay.  If the timer
+ *                is already pending, it is rescheduled.
+ *   INPUTS: t -- the timer
+ *           delay_usec -- delay from now in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+timer_schedule (game_timer_t* t, int64_t delay_usec)
+{
+    timer_schedule_at (t, tick_elapsed_usec () + delay_usec);
+}
+
+
+/* 
+ * timer_schedule_at
+ *   DESCRIPTION: Schedule a timer to expire at a given time.  If the timer
+ *                is already pending, it is rescheduled.  Times in the past
+ *                expire on the next call to timer_run.
+ *   INPUTS: t -- the timer
+ *           when_usec -- expiry time on the tick clock, in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+timer_schedule_at (game_timer_t* t, int64_t when_usec)
+{
+    timer_cancel (t);
+    t->expires = (when_usec + TIMER_RES_USEC - 1) / TIMER_RES_USEC;
+    add_timer (t);
+}
+
+
+/* 
+ * timer_cancel
+ *   DESCRIPTION: Cancel a pending timer.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+timer_cancel (game_timer_t* t)
+{
+    if (NULL != t->pprev) {
+	unlink_timer (t);
+    }
+}
+
+
+/* 
+ * timer_pending
+ *   DESCRIPTION: Check whether a timer is waiting to expire.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if pending, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int
+timer_pending (const game_timer_t* t)
+{
+    return (NULL != t->pprev);
+}
+
+
+/* 
+ * timer_run
+ *   DESCRIPTION: Run the timer wheel up to a given time, calling the 
+ *                functions for all timers that expire at or before that
+ *                time.  The functions may schedule or cancel any timer,
+ *                including their own.
+ *   INPUTS: now_usec -- current time on the tick clock, in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: calls timer functions
+ */
+void
+timer_run (int64_t now_usec)
+{
+    uint32_t      target; /* last jiffy to run             */
+    uint32_t      idx;    /* first level slot being run    */
+    game_timer_t* work;   /* timers expiring in this jiffy */
+    game_timer_t* t;      /* timer being run               */
+
+    target = now_usec / TIMER_RES_USEC;
+    while (0 <= (int32_t)(target - cur_jiffy)) {
+
+	/* Refill the first level from the higher levels when it wraps. */
+	idx = cur_jiffy & WHEEL0_MASK;
+	if (0 == idx) {
+	    if (0 == ((cur_jiffy >> WHEEL0_BITS) & WHEELN_MASK)) {
+		cascade (&wheel2[(cur_jiffy >> (WHEEL0_BITS + WHEELN_BITS)) & 
+				 WHEELN_MASK]);
+	    }
+	    cascade (&wheel1[(cur_jiffy >> WHEEL0_BITS) & WHEELN_MASK]);
+	}
+
+	/* 
+	 * Move the slot's timers to a work list and advance the clock, so
+	 * that timers scheduled by the functions go into later slots.
+	 */
+	if (NULL != (work = wheel0[idx])) {
+	    work->pprev = &work;
+	    wheel0[idx] = NULL;
+	}
+	cur_jiffy++;
+
+	while (NULL != (t = work)) {
+	    unlink_timer (t);
+	    (*t->fn) (t->arg);
+	}
+    }
+}
+
+
+/* 
+ * add_timer
+ *   DESCRIPTION: Put an idle timer into the wheel slot for its expiry time.
+ *   INPUTS: t -- the timer (with expires set)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+add_timer (game_timer_t* t)
+{
+    uint32_t       delta; /* jiffies until expiry */
+    game_timer_t** slot;  /* slot for the timer   */
+
+    delta = t->expires - cur_jiffy;
+    if (0 > (int32_t)delta) {
+	/* Already expired: run on the next jiffy. */
+	t->expires = cur_jiffy;
+	slot = &wheel0[cur_jiffy & WHEEL0_MASK];
+    } else if (WHEEL0_SIZE > delta) {
+	slot = &wheel0[t->expires & WHEEL0_MASK];
+    } else if (WHEEL1_SPAN > delta) {
+	slot = &wheel1[(t->expires >> WHEEL0_BITS) & WHEELN_MASK];
+    } else {
+	if (WHEEL2_SPAN <= delta) {
+	    t->expires = cur_jiffy + WHEEL2_SPAN - 1;
+	}
+	slot = &wheel2[(t->expires >> (WHEEL0_BITS + WHEELN_BITS)) & 
+		       WHEELN_MASK];
+    }
+
+    /* Link the timer at the head of the slot. */
+    if (NULL != (t->next = *slot)) {
+	t->next->pprev = &t->next;
+    }
+    *slot = t;
+    t->pprev = slot;
+}
+
+
+/* 
+ * cascade
+ *   DESCRIPTION: Move all timers in a higher-level wheel slot down to the
+ *                lower level(s).
+ *   INPUTS: slot -- the slot
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: empties the slot
+ */
+static void
+cascade (game_timer_t** slot)
+{
+    game_timer_t* t; /* timer being moved */
+
+    while (NULL != (t = *slot)) {
+	unlink_timer (t);
+	add_timer (t);
+    }
+}
+
+
+/* 
+ * unlink_timer
+ *   DESCRIPTION: Remove a pending timer from its list, leaving it idle.
+ *   INPUTS: t -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+unlink_timer (game_timer_t* t)
+{
+    if (NULL != (*t->pprev = t->next)) {
+	t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
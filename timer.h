@@ -0,0 +1,57 @@
+/*									tab:8
+ *
+ * timer.h - header file for game-timed events
+ *
+ * Filename:	    timer.h
+ * History:
+ *		1	Replaced status message helper thread with timers run
+ *			by the event loop.
+ */
+
+#if !defined(TIMER_H)
+#define TIMER_H
+
+
+#include <stdint.h>
+
+
+/* timer resolution; timers expire on the first tick at or after this */
+#define TIMER_RES_USEC 10000
+
+/* function called when a timer expires */
+typedef void (*timer_fn_t) (void* arg);
+
+/* 
+ * A timer.  Timers are owned by the caller (usually as static variables)
+ * and linked into the timer wheel while pending; the fields are private 
+ * to timer.c.  A timer must be set up with timer_setup before use.
+ */
+typedef struct game_timer_t game_timer_t;
+struct game_timer_t {
+    game_timer_t*  next;    /* next timer in wheel slot                 */
+    game_timer_t** pprev;   /* link pointing to this timer (NULL if idle) */
+    uint32_t       expires; /* expiry time in TIMER_RES_USEC units      */
+    timer_fn_t     fn;      /* function called on expiry                */
+    void*          arg;     /* argument passed to fn                    */
+};
+
+/* Prepare a timer to call fn (arg) when it expires. */
+extern void timer_setup (game_timer_t* t, timer_fn_t fn, void* arg);
+
+/* 
+ * Schedule (or reschedule) a timer to expire delay_usec from now, or at
+ * time when_usec on the tick clock (see tick_elapsed_usec).
+ */
+extern void timer_schedule (game_timer_t* t, int64_t delay_usec);
+extern void timer_schedule_at (game_timer_t* t, int64_t when_usec);
+
+/* Cancel a timer (no effect if the timer is not pending). */
+extern void timer_cancel (game_timer_t* t);
+
+/* Check whether a timer is scheduled and has not yet expired. */
+extern int timer_pending (const game_timer_t* t);
+
+/* Run all timers that expire at or before time now_usec. */
+extern void timer_run (int64_t now_usec);
+
+#endif /* TIMER_H */
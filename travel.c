@@ -0,0 +1,292 @@
+/*									tab:8
+ *
+ * travel.c - finding paths between rooms
+ *
+ * Filename:	    travel.c
+ * History:
+ *		1	Found shortest paths between rooms with a table of
+ *			next steps, for travelling to rooms by name.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "travel.h"
+
+
+/*
+ * The table of next steps has one row per destination room, holding for
+ * each room the link to follow from it on a shortest path to the
+ * destination: 2 bits per room, 0 for none (the destination itself, or
+ * a room with no path to it), or else the link number plus one.  A row
+ * is filled by a breadth-first search outward from its destination along
+ * links followed backwards, so each room also keeps a list of the links
+ * that lead to it.  Link i of room r is numbered 3 * r + i.
+ *
+ * If the whole table fits in TRAVEL_TABLE_BYTES and the world has at most
+ * TRAVEL_PRECOMPUTE rooms, every row is filled when the table is
+ * prepared.  Otherwise the table keeps as many rows as fit, filling a row
+ * the first time that its destination is sought and replacing rows in
+ * turn.  The links are all set before the table is prepared, and do not
+ * change afterward.
+ *
+ * Paths may be sought from several threads at once.  Since seeking a path
+ * may fill (and so replace) a row, the rows are protected by table_lock.
+ */
+#define TRAVEL_TABLE_BYTES (4 * 1024 * 1024)
+#define TRAVEL_PRECOMPUTE  1024
+#define TRAVEL_MIN_ROWS    16
+
+static int32_t  n_rooms;	/* number of rooms                    */
+static int32_t* link_to;	/* room reached by each link          */
+static int32_t* in_first;	/* first link leading to each room    */
+static int32_t* in_next;	/* next link leading to the same room */
+static int32_t* queue;		/* rooms found by the search          */
+
+static uint8_t* rows;		/* the rows of the table              */
+static int32_t  row_bytes;	/* size of a row                      */
+static int32_t  n_rows;		/* number of rows kept                */
+static int32_t* row_dest;	/* destination of each row            */
+static int32_t* dest_row;	/* row for each destination room      */
+static int32_t  next_row;	/* next row to be replaced            */
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int32_t get_hop (const uint8_t* row, int32_t r);
+static void fill_row (int32_t k, int32_t dest);
+static void drop_row (int32_t k);
+static const uint8_t* find_row (int32_t dest);
+static int32_t row_distance (int32_t k, int32_t from);
+
+
+/*
+ * get_hop
+ *   DESCRIPTION: Get the entry for a room in a row of the table.
+ *   INPUTS: row -- the row
+ *           r -- the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for no step, or the link to follow plus one
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+get_hop (const uint8_t* row, int32_t r)
+{
+    return (row[r / 4] >> (2 * (r % 4))) & 3;
+}
+
+
+/*
+ * fill_row
+ *   DESCRIPTION: Fill a row of the table for a destination room.
+ *   INPUTS: k -- the row
+ *           dest -- the destination
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: replaces the row's previous destination, if any
+ */
+static void
+fill_row (int32_t k, int32_t dest)
+{
+    uint8_t* row = rows + k * row_bytes; /* the row                 */
+    int32_t  head;			 /* index of room searched  */
+    int32_t  tail = 1;			 /* number of rooms found   */
+    int32_t  in;			 /* link leading to room    */
+    int32_t  r;				 /* room at start of link   */
+
+    drop_row (k);
+    row_dest[k] = dest;
+    dest_row[dest] = k;
+
+    (void)memset (row, 0, row_bytes);
+    queue[0] = dest;
+    for (head = 0; tail > head; head++) {
+	for (in = in_first[queue[head]]; TRAVEL_NONE != in; in = in_next[in]) {
+	    r = in / 3;
+	    if (dest != r && 0 == get_hop (row, r)) {
+		row[r / 4] |= (in % 3 + 1) << (2 * (r % 4));
+		queue[tail++] = r;
+	    }
+	}
+    }
+}
+
+
+/*
+ * drop_row
+ *   DESCRIPTION: Drop a row of the table, if it is in use.
+ *   INPUTS: k -- the row
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void
+drop_row (int32_t k)
+{
+    if (TRAVEL_NONE != row_dest[k]) {
+	dest_row[row_dest[k]] = TRAVEL_NONE;
+	row_dest[k] = TRAVEL_NONE;
+    }
+}
+
+
+/*
+ * find_row
+ *   DESCRIPTION: Find the row of the table for a destination room, filling
+ *                one if it is not kept.
+ *   INPUTS: dest -- the destination
+ *   OUTPUTS: none
+ *   RETURN VALUE: the row
+ *   SIDE EFFECTS: may replace a row
+ */
+static const uint8_t*
+find_row (int32_t dest)
+{
+    if (TRAVEL_NONE == dest_row[dest]) {
+	fill_row (next_row, dest);
+	next_row = (next_row + 1) % n_rows;
+    }
+    return rows + dest_row[dest] * row_bytes;
+}
+
+
+/*
+ * row_distance
+ *   DESCRIPTION: Count the steps from a room to the destination of a row
+ *                by following the row.
+ *   INPUTS: k -- the row
+ *           from -- the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: the number of steps, or -1 if no path exists
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+row_distance (int32_t k, int32_t from)
+{
+    const uint8_t* row = rows + k * row_bytes; /* the row          */
+    int32_t        n;			       /* steps taken      */
+    int32_t        hop;			       /* link to follow   */
+
+    for (n = 0; row_dest[k] != from; n++) {
+	if (0 == (hop = get_hop (row, from)) || n_rooms == n) {
+	    return -1;
+	}
+	from = link_to[3 * from + hop - 1];
+    }
+    return n;
+}
+
+
+/*
+ * init_travel
+ *   DESCRIPTION: Start a graph of rooms with no links, and make space for
+ *                the table of next steps.
+ *   INPUTS: n -- number of rooms
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 if out of memory
+ *   SIDE EFFECTS: none
+ */
+int32_t
+init_travel (int32_t n)
+{
+    int32_t idx; /* index over rooms and rows */
+
+    n_rooms = n;
+    row_bytes = (n + 3) / 4;
+    n_rows = TRAVEL_TABLE_BYTES / row_bytes;
+    if (TRAVEL_MIN_ROWS > n_rows) {
+	n_rows = TRAVEL_MIN_ROWS;
+    }
+    if (n < n_rows) {
+	n_rows = n;
+    }
+    link_to = malloc (3 * n * sizeof (link_to[0]));
+    in_first = malloc (n * sizeof (in_first[0]));
+    in_next = malloc (3 * n * sizeof (in_next[0]));
+    queue = malloc (n * sizeof (queue[0]));
+    dest_row = malloc (n * sizeof (dest_row[0]));
+    row_dest = malloc (n_rows * sizeof (row_dest[0]));
+    rows = malloc (n_rows * row_bytes);
+    if (NULL == link_to || NULL == in_first || NULL == in_next ||
+	NULL == queue || NULL == dest_row || NULL == row_dest ||
+	NULL == rows) {
+	return -1;
+    }
+    for (idx = 0; 3 * n > idx; idx++) {
+	link_to[idx] = TRAVEL_NONE;
+    }
+    for (idx = 0; n > idx; idx++) {
+	in_first[idx] = TRAVEL_NONE;
+	dest_row[idx] = TRAVEL_NONE;
+    }
+    for (idx = 0; n_rows > idx; idx++) {
+	row_dest[idx] = TRAVEL_NONE;
+    }
+    return 0;
+}
+
+
+/*
+ * set_travel_link
+ *   DESCRIPTION: Set a link.  Called only before the table is prepared.
+ *   INPUTS: from -- the room
+ *           dir -- the link (TRAVEL_LEFT, TRAVEL_ENTER, TRAVEL_RIGHT)
+ *           to -- the room reached by the link
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+set_travel_link (int32_t from, int32_t dir, int32_t to)
+{
+    int32_t l = 3 * from + dir; /* number of the link */
+
+    link_to[l] = to;
+    in_next[l] = in_first[to];
+    in_first[to] = l;
+}
+
+
+/*
+ * prepare_travel
+ *   DESCRIPTION: Prepare the table of next steps, filling every row if
+ *                the world is small enough (see above).
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+prepare_travel ()
+{
+    int32_t dest; /* index over destinations */
+
+    if (n_rooms == n_rows && TRAVEL_PRECOMPUTE >= n_rooms) {
+	for (dest = 0; n_rooms > dest; dest++) {
+	    fill_row (dest, dest);
+	}
+    }
+}
+
+
+/*
+ * travel_distance
+ *   DESCRIPTION: Get the number of steps on a shortest path between two
+ *                rooms.
+ *   INPUTS: from -- the room in which the path starts
+ *           to -- the destination
+ *   OUTPUTS: none
+ *   RETURN VALUE: the number of steps, or -1 if no path exists
+ *   SIDE EFFECTS: may fill a row of the table
+ */
+int32_t
+travel_distance (int32_t from, int32_t to)
+{
+    int32_t dist; /* steps on shortest path */
+
+    (void)pthread_mutex_lock (&table_lock);
+    (void)find_row (to);
+    dist = row_distance (dest_row[to], from);
+    (void)pthread_mutex_unlock (&table_lock);
+    return dist;
+}
@@ -0,0 +1,39 @@
+/*									tab:8
+ *
+ * travel.h - header file for finding paths between rooms
+ *
+ * Filename:	    travel.h
+ * History:
+ *		1	Found shortest paths between rooms with a table of
+ *			next steps, for travelling to rooms by name.
+ */
+
+#if !defined(TRAVEL_H)
+#define TRAVEL_H
+
+
+#include <stdint.h>
+
+
+/*
+ * Rooms are numbered from 0, and each has up to three links to other
+ * rooms, numbered as below.  TRAVEL_NONE stands for no room (or no link).
+ */
+#define TRAVEL_NONE  (-1)
+#define TRAVEL_LEFT  0
+#define TRAVEL_ENTER 1
+#define TRAVEL_RIGHT 2
+
+/* Start a graph of rooms with no links.  Returns 0, or -1 on failure. */
+extern int32_t init_travel (int32_t n_rooms);
+
+/* Set a link.  The links are all set before the table is prepared. */
+extern void set_travel_link (int32_t from, int32_t dir, int32_t to);
+
+/* Fill the table of next steps, after the links are set. */
+extern void prepare_travel (void);
+
+/* Get the number of steps between rooms, or -1 if no path exists. */
+extern int32_t travel_distance (int32_t from, int32_t to);
+
+#endif /* TRAVEL_H */
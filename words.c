@@ -0,0 +1,288 @@
+/*									tab:8
+ *
+ * words.c - matching typed words as they are typed
+ *
+ * Filename:	    words.c
+ * History:
+ *		1	Matched typed verbs and argument words with prefix
+ *			tries advanced one node per keystroke.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "words.h"
+
+
+/*
+ * A node of a trie.  Each node stands for the characters typed to reach
+ * it from its root; its children are linked through their sibling fields.
+ * Words are numbered from 1, so that 0 means no word (and no node, as the
+ * roots are never children).  The only field names the single word that
+ * starts with the node's characters, or is SEVERAL_WORDS if more than one
+ * does.
+ *
+ * The nodes and words are kept in arrays that start with room for 
+ * WORD_NODES_INIT nodes and WORDS_INIT words and double in size as they
+ * fill, since the noun trie holds the names of all objects in the world.
+ * Until the first word is added, the arrays (even the roots) do not
+ * exist, and no word starts with anything.
+ */
+#define SEVERAL_WORDS   (-1)
+#define WORD_NODES_INIT 512
+#define WORDS_INIT      64
+typedef struct word_node_t word_node_t;
+struct word_node_t {
+    int32_t child;	/* first child node                      */
+    int32_t sibling;	/* next child of the same parent         */
+    int32_t depth;	/* number of characters typed to reach   */
+    int32_t only;	/* only word through node (see above)    */
+    int32_t verb;	/* verb selected by typing the node      */
+    int32_t whole;	/* word ending at the node               */
+    char    ch;		/* character (lower case) typed to reach */
+};
+
+/* the trie nodes: the verb and noun roots, then the others */
+static word_node_t* word_node;
+static int32_t n_word_nodes = 2;
+static int32_t max_word_nodes;
+
+/* the words added, and the ids given for verbs */
+static const char** word_name;
+static int32_t* word_id;
+static int32_t n_words = 1;
+static int32_t max_words;
+
+static int32_t reserve_words (int32_t n_nodes);
+static int32_t add_word (int32_t root, const char* name, int32_t min_len,
+			 int32_t id);
+
+
+/*
+ * reserve_words
+ *   DESCRIPTION: Make sure that there is room for one more word and for
+ *                a number of new nodes, growing the arrays if necessary.
+ *   INPUTS: n_nodes -- number of new nodes needed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of memory
+ *   SIDE EFFECTS: may move the arrays
+ */
+static int32_t
+reserve_words (int32_t n_nodes)
+{
+    int32_t      max;	/* new number of nodes or words */
+    word_node_t* nodes;	/* new node array               */
+    const char** names;	/* new word name array          */
+    int32_t*     ids;	/* new word id array            */
+
+    if (max_word_nodes < n_word_nodes + n_nodes) {
+	for (max = (0 == max_word_nodes ? WORD_NODES_INIT : max_word_nodes);
+	     n_word_nodes + n_nodes > max; max *= 2);
+	if (NULL == (nodes = realloc (word_node, max * sizeof (*nodes)))) {
+	    return -1;
+	}
+	(void)memset (nodes + max_word_nodes, 0, 
+		      (max - max_word_nodes) * sizeof (*nodes));
+	word_node = nodes;
+	max_word_nodes = max;
+    }
+    if (max_words <= n_words) {
+	max = (0 == max_words ? WORDS_INIT : 2 * max_words);
+	if (NULL == (names = realloc (word_name, max * sizeof (*names)))) {
+	    return -1;
+	}
+	word_name = names;
+	if (NULL == (ids = realloc (word_id, max * sizeof (*ids)))) {
+	    return -1;
+	}
+	word_id = ids;
+	max_words = max;
+    }
+    return 0;
+}
+
+
+/*
+ * add_word
+ *   DESCRIPTION: Add a word to a trie, creating the nodes needed for its
+ *                characters.  The name must remain valid, as word hints
+ *                point into it.
+ *   INPUTS: root -- VERB_ROOT or NOUN_ROOT
+ *           name -- the word
+ *           min_len -- for verbs, the length of the shortest abbreviation;
+ *                      ignored for nouns
+ *           id -- for verbs, the id returned when the verb is typed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of memory (the tries are
+ *                 unchanged)
+ *   SIDE EFFECTS: may move the arrays of nodes and words
+ */
+static int32_t
+add_word (int32_t root, const char* name, int32_t min_len, int32_t id)
+{
+    const char* s;  /* character being added       */
+    int32_t node;   /* node for characters so far  */
+    int32_t k;	    /* child of node               */
+    int32_t w;	    /* number of word being added  */
+
+    if (0 != reserve_words (strlen (name))) {
+	return -1;
+    }
+    w = n_words++;
+    word_name[w] = name;
+    word_id[w] = id;
+
+    for (node = root, s = name; '\0' != *s; s++, node = k) {
+	/* Find or create the child for this character. */
+	for (k = word_node[node].child;
+	     0 != k && tolower (*s) != word_node[k].ch;
+	     k = word_node[k].sibling);
+	if (0 == k) {
+	    k = n_word_nodes++;
+	    word_node[k].ch = tolower (*s);
+	    word_node[k].depth = word_node[node].depth + 1;
+	    word_node[k].sibling = word_node[node].child;
+	    word_node[node].child = k;
+	}
+
+	/* Record the word as passing through the child. */
+	if (0 == word_node[k].only) {
+	    word_node[k].only = w;
+	} else {
+	    word_node[k].only = SEVERAL_WORDS;
+	}
+	if (VERB_ROOT == root && min_len <= word_node[k].depth &&
+	    0 == word_node[k].verb) {
+	    word_node[k].verb = w;
+	}
+    }
+    if (0 == word_node[node].whole) {
+	word_node[node].whole = w;
+    }
+    return 0;
+}
+
+
+/*
+ * add_verb
+ *   DESCRIPTION: Add a verb to the verb trie.  Typing any prefix of the
+ *                verb of at least min_len characters selects the verb,
+ *                unless a verb added earlier is already selected by the
+ *                same prefix.
+ *   INPUTS: name -- the verb (which must remain valid)
+ *           min_len -- the length of the shortest abbreviation
+ *           id -- the id returned by word_verb when the verb is typed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of memory
+ *   SIDE EFFECTS: none
+ */
+int32_t
+add_verb (const char* name, int32_t min_len, int32_t id)
+{
+    return add_word (VERB_ROOT, name, min_len, id);
+}
+
+
+/*
+ * add_noun
+ *   DESCRIPTION: Add a noun to the noun trie, unless it is already there
+ *                (several objects may share a name).
+ *   INPUTS: name -- the noun (which must remain valid)
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of memory
+ *   SIDE EFFECTS: none
+ */
+int32_t
+add_noun (const char* name)
+{
+    const char* s; /* character being matched     */
+    int32_t node;  /* node for characters so far  */
+
+    for (node = NOUN_ROOT, s = name; WORD_NONE != node && '\0' != *s; s++) {
+	node = word_step (node, *s);
+    }
+    if (WORD_NONE != node && 0 != word_node[node].whole) {
+	return 0;
+    }
+    return add_word (NOUN_ROOT, name, 0, 0);
+}
+
+
+/*
+ * word_step
+ *   DESCRIPTION: Find the node reached by typing one more character.
+ *   INPUTS: node -- node for the characters typed so far (or WORD_NONE)
+ *           c -- the character typed
+ *   OUTPUTS: none
+ *   RETURN VALUE: the node reached, or WORD_NONE if no word starts with
+ *                 the characters typed
+ *   SIDE EFFECTS: none
+ */
+int32_t
+word_step (int32_t node, char c)
+{
+    int32_t k; /* child of node */
+
+    if (WORD_NONE == node || NULL == word_node) {
+	return WORD_NONE;
+    }
+    c = tolower (c);
+    for (k = word_node[node].child; 0 != k; k = word_node[k].sibling) {
+	if (c == word_node[k].ch) {
+	    return k;
+	}
+    }
+    return WORD_NONE;
+}
+
+
+/*
+ * word_verb
+ *   DESCRIPTION: Get the verb selected by the characters typed to reach a
+ *                node of the verb trie.
+ *   INPUTS: node -- the node (or WORD_NONE)
+ *   OUTPUTS: none
+ *   RETURN VALUE: the id given for the verb, or -1 if no verb is selected
+ *   SIDE EFFECTS: none
+ */
+int32_t
+word_verb (int32_t node)
+{
+    if (WORD_NONE == node || NULL == word_node || 
+	0 == word_node[node].verb) {
+	return -1;
+    }
+    return word_id[word_node[node].verb];
+}
+
+
+/*
+ * word_hint
+ *   DESCRIPTION: Get the characters that would complete the word being
+ *                typed: the rest of the verb selected at a verb trie
+ *                node, or else the rest of the only word that starts with
+ *                the characters typed.
+ *   INPUTS: node -- node for the characters typed (or WORD_NONE)
+ *   OUTPUTS: none
+ *   RETURN VALUE: the rest of the word, or "" if there is no single word
+ *                 or if the word is already complete
+ *   SIDE EFFECTS: none
+ */
+const char*
+word_hint (int32_t node)
+{
+    int32_t w; /* word hinted */
+
+    if (WORD_NONE == node || NULL == word_node) {
+	return "";
+    }
+    if (0 == (w = word_node[node].verb)) {
+	w = word_node[node].only;
+    }
+    if (0 == w || SEVERAL_WORDS == w) {
+	return "";
+    }
+    return word_name[w] + word_node[node].depth;
+}
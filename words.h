@@ -0,0 +1,53 @@
+/*									tab:8
+ *
+ * words.h - header file for matching typed words as they are typed
+ *
+ * Filename:	    words.h
+ * History:
+ *		1	Matched typed verbs and argument words with prefix
+ *			tries advanced one node per keystroke.
+ */
+
+#if !defined(WORDS_H)
+#define WORDS_H
+
+
+#include <stdint.h>
+
+
+/*
+ * Words that can be typed are kept in two prefix tries: one of verbs,
+ * which must be typed first, and one of the words (nouns) that can follow
+ * a verb, such as object and place names.  A typed word is matched by
+ * starting at the root of the appropriate trie and stepping down one
+ * node per character typed, ignoring case.  WORD_NONE means that no word
+ * starts with the characters typed.
+ */
+#define WORD_NONE  (-1)
+#define VERB_ROOT  0
+#define NOUN_ROOT  1
+
+/*
+ * Add a verb that can be abbreviated to its first min_len characters
+ * (where the abbreviations of two verbs overlap, the verb added first
+ * wins), producing the value id.  Returns 0 on success, -1 on failure.
+ */
+extern int32_t add_verb (const char* name, int32_t min_len, int32_t id);
+
+/* Add a noun, which must be typed in full.  Returns 0 or -1. */
+extern int32_t add_noun (const char* name);
+
+/* Step from a trie node by one typed character. */
+extern int32_t word_step (int32_t node, char c);
+
+/* Get the id of the verb typed to reach a node, or -1 if there is none. */
+extern int32_t word_verb (int32_t node);
+
+/*
+ * Get the rest of the only word (or, for a verb trie node, the verb) that
+ * the characters typed to reach a node can start.  Returns "" if there is
+ * none or if the word is complete.
+ */
+extern const char* word_hint (int32_t node);
+
+#endif /* WORDS_H */
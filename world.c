@@ -34,17 +34,37 @@
  */
  
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "assert.h"
 #include "photo.h"
+#include "symtab.h"
+#include "travel.h"
+#include "words.h"
 #include "world.h"
+#include "world_headers.h"
 
 
 /* parameters defined for this file */
 
-/* room identifiers */
+/* 
+ * number of rooms whose photos are loaded ahead of time (the rest are 
+ * read when first shown)
+ */
+#define PRELOAD_ROOMS 128
+
+/* 
+ * identifiers of the rooms used by the game's puzzles (a world file may 
+ * hold many other rooms)
+ */
 enum {
     R_NONE = -1,
 
@@ -122,10 +142,10 @@ enum {
     R_REM_ICE,		/* the ice fields near rem. sen. lab */
     R_REM_LAB,		/* part of a remote sensing lab      */
 
-    N_ROOMS
+    N_KNOWN_ROOMS
 };
 
-/* object identifiers */
+/* identifiers of the objects used by the game's puzzles */
 enum {
     O_NONE = -1,
 
@@ -150,7 +170,7 @@ enum {
     O_ROBOT_LIVE,	/* lockpicking robot with new control program */
     O_MIMO_CARD,	/* a MIMO card for planes                     */
 
-    N_OBJECTS
+    N_KNOWN_OBJECTS
 };
 
 /* flag identifiers for recording the player's accomplishments */
@@ -175,15 +195,33 @@ enum {
 
 /*
  * The structure representing a room in the world.  The backpack/inventory 
- * is also a 'room' (#0, R_INVENTORY). 
+ * is also a 'room' (R_INVENTORY).  A room is set up (and its name
+ * filled in) when it is first used.
  */
 struct room_t {
-    const char* name;		/* name of room                   */
+    const char* name;		/* name of room (NULL if not set up) */
+    int32_t     sym;		/* interned name of room          */
     photo_t*    view;		/* photo currently shown for room */
-    object_t*   contents; 	/* linked list of objects in room */
     room_t*     left;   	/* room to the "left"             */
     room_t*     enter;  	/* doors, etc.                    */
     room_t*     right;  	/* room to the "right"            */
+
+    /* 
+     * The objects in the room, as parallel arrays in drawing order (the
+     * object placed in the room most recently comes first).  Drawing
+     * tests each object against each line, so the fields tested are 
+     * kept apart from the rest, and the tests read only a few cache 
+     * lines.  The object arrays lead back to the object structures.
+     */
+    int32_t     n_objs;		/* number of objects in room      */
+    int32_t     max_objs;	/* space in the arrays            */
+    uint16_t*   obj_x;		/* x positions within room photo  */
+    uint16_t*   obj_y;		/* y positions within room photo  */
+    uint16_t*   obj_w;		/* image widths                   */
+    uint16_t*   obj_h;		/* image heights                  */
+    image_t**   obj_img;	/* images                         */
+    int32_t*    obj_sym;	/* interned names                 */
+    object_t**  obj;		/* the objects                    */
 };
 
 /*
@@ -192,258 +230,261 @@ struct room_t {
  * all the same bottle!).  Sorry.
  */
 struct object_t {
-    const char*  name;		/* name of object                 */
-    object_t*    next;		/* linked list of room contents   */
+    const char*  name;		/* name of object (NULL if not set up) */
     room_t*      loc;      	/* in what 'room'?                */
+    int32_t      slot;		/* index in room's object arrays  */
     uint16_t     x, y;    	/* location within room photo     */
     image_t*     img;     	/* image for use in room          */
 };
 
 /*
- * This local structure is used to specify room connectivity and data 
- * in a reasonably manageable way.  The array entries in the database
- * specify the room id, name, filename, and connections to other
- * rooms by symbolic name.  Since there are many rooms, trying to
- * keep the order between the enumeration of symbolic names and the
- * array entries can be tricky.  Instead, we associate array entries
- * with specific symbolic names using the id field.  Thus, you can
- * reorder the entries in the room_data array without affecting their
- * meaning.
- */
-typedef struct room_data_t room_data_t;
-struct room_data_t {
-    int32_t           id;	/* id of room being described    */
-    const char* const name;	/* name of room                  */
-    const char* const filename;	/* file name for room photo      */
-    int32_t           left;	/* id of room to 'left'          */
-    int32_t           enter;	/* id of room reached by 'enter' */
-    int32_t           right;	/* id of room to 'right'         */
+ * The state of one game session: the session's rooms and objects, which
+ * correspond to those in the world file, and its accomplishment flags 
+ * and swap photos.  Everything else is shared by the sessions: the world
+ * file, the room photos and object images (which sessions only read once
+ * they are loaded), the interned names, and the paths between rooms.
+ * Each thread plays one session at a time (see use_world_session), so
+ * sessions can be played on several threads at once.
+ *
+ * Flags are coded as bit vectors using an array of 32-bit words.  It's 
+ * overkill for this game, but it's nice not to worry about the number of 
+ * flags...
+ */
+struct world_session_t {
+    room_t*   room;				/* rooms                  */
+    object_t* object;				/* objects                */
+    room_t*   known_room[N_KNOWN_ROOMS];	/* rooms used by puzzles  */
+    object_t* known_obj[N_KNOWN_OBJECTS];	/* objects used by them   */
+    uint32_t  player_flags[(NUM_FLAGS + 31) / 32]; /* accomplishments */
+    photo_t*  swap_photo[N_SWAPS];		/* swapping photos        */
+    room_t*   swapped_into[N_SWAPS];	/* room showing swap photo, or NULL */
 };
 
-/* the room connectivity data */
-static const room_data_t room_data[N_ROOMS] = {
-    /* Area 0: The Backpack */
-    {R_INVENTORY, "Inventory", "images/backpack.photo", 
-                       R_NONE,      R_NONE,      R_NONE},
-
-    /* Area 1: Everitt and Green Street */
-    {R_IN_391LAB, "391 Lab", "images/391lab.photo", 
-                       R_NONE, R_BY_391LAB,      R_NONE},
-    {R_BY_391LAB, "Outside of 391", "images/outside391.photo", 
-                     R_BY_ZAS, R_IN_391LAB,   R_BY_IEEE},
-    {  R_IN_IEEE, "IEEE Office", "images/ieee.photo", 
-                       R_NONE,   R_BY_IEEE,      R_NONE},
-    {  R_BY_IEEE, "Outside IEEE", "images/byieee.photo", 
-                  R_BY_391LAB,   R_IN_IEEE, R_BY_395LAB},
-    {R_IN_395LAB, "395 Lab", "images/395lab.photo", 
-                       R_NONE, R_BY_395LAB,      R_NONE},
-    {R_BY_395LAB, "Outside of 395", "images/outside395.photo", 
-                    R_BY_IEEE,      R_NONE, R_EVT_STAIR},
-    {R_EVT_STAIR, "Everitt Stairs", "images/evtstair.photo", 
-                  R_BY_395LAB, R_EAST_EVRT, R_BY_CLEANR},
-    {R_IN_CLEANR, "In Cleanroom", "images/cleanr.photo", 
-                       R_NONE, R_BY_CLEANR,      R_NONE},
-    {R_BY_CLEANR, "By the Cleanroom", "images/outclean.photo", 
-                  R_EVT_STAIR,      R_NONE, R_EVRT_VEND},
-    {R_EVRT_VEND, "Vending Machine", "images/vend.photo", 
-                  R_BY_CLEANR, R_EVRT_BSMT,      R_NONE},
-    {R_ALMAMATER, "Alma Mater", "images/almamater.photo", 
-                  R_EAST_EVRT, R_EAST_EVRT, R_BY_COCOMR},
-    {R_IN_COCOMR, "Cocomero", "images/incoco.photo", 
-                       R_NONE, R_BY_COCOMR,      R_NONE},
-    {R_BY_COCOMR, "Near Cocomero", "images/bycoco.photo", 
-                  R_ALMAMATER, R_IN_COCOMR,    R_BY_ZAS},
-    {R_BY_ZAS, "The Ruins", "images/ruins.photo", 
-                  R_BY_COCOMR,      R_NONE,      R_NONE},
-    {R_EAST_EVRT, "East of Everitt", "images/eeast.photo", 
-                  R_ALMAMATER, R_EVT_STAIR, R_EVRT_BSMT},
-    {R_EVRT_BSMT, "Basement Entry", "images/basement.photo", 
-                  R_EAST_EVRT, R_EVRT_VEND, R_CIRCLE_SW},
-
-    /* Area 2: Bardeen Quad and Environs */
-    {R_WEST_BONE, "Boneyard Creek", "images/bonew.photo", 
-                  R_CIRCLE_SW,      R_NONE,  R_CIRCLE_N},
-    { R_CIRCLE_N, "Boneyard Bridge", "images/circlen1.photo", 
-                  R_WEST_BONE, R_TALBOT_NW, R_EAST_BONE},
-    {R_CIRCLE_SW, "Boneyard Bridge", "images/circlesw.photo", 
-                  R_EAST_BONE, R_EVRT_BSMT,  R_CIRCLE_N},
-    {R_EAST_BONE, "Boneyard Creek", "images/bonee.photo", 
-                   R_CIRCLE_N,      R_NONE, R_CIRCLE_SW},
-    {  R_BARDEEN, "Bardeen Quad", "images/bardeen.photo", 
-                   R_LIB_BACK, R_EAST_BONE, R_TALBOT_SW},
-    { R_LIB_BACK, "Grainger Library", "images/graingerback.photo", 
-                        R_DCL,   R_RESERVE,   R_BARDEEN},
-    {  R_RESERVE, "Grainger Reserves", "images/reserve.photo", 
-                       R_NONE,  R_LIB_BACK, R_LIB_FRONT},
-    {R_TALBOT_NW, "Talbot Lab", "images/talbotnw.photo", 
-                  R_CIRCLE_SW,    R_TALBOT, R_TALBOT_SW},
-    {R_TALBOT_SW, "Talbot Lab", "images/talbotsw.photo", 
-                  R_TALBOT_NW,    R_TALBOT, R_SPRINGFLD},
-    {   R_TALBOT, "Talbot Lab", "images/talbot.photo", 
-                       R_NONE, R_TALBOT_NW,      R_NONE},
-    {R_SPRINGFLD, "Springfield Avenue", "images/springfield.photo", 
-                  R_TALBOT_SW,   R_CARIBOU,    R_KENNEY},
-    {  R_CARIBOU, "Caribou", "images/caribou.photo", 
-                       R_NONE, R_SPRINGFLD,      R_NONE},
-    {   R_KENNEY, "Kenney Gym", "images/kenney.photo", 
-                  R_SPRINGFLD,      R_NONE,       R_DCL},
-    {      R_DCL, "DCL", "images/dcl.photo", 
-                     R_KENNEY,  R_KENNEY_E, R_LIB_FRONT},
-    {R_LIB_FRONT, "Grainger Library", "images/graingerfront.photo", 
-                        R_DCL,   R_RESERVE, R_TALBOT_SW},
-
-    /* Area 3: CSL and Environs */
-    { R_KENNEY_E, "East of Kenney", "images/kenneye.photo", 
-                        R_DCL,       R_DCL,   R_NEWMARK},
-    {  R_NEWMARK, "Newmark Lab", "images/newmark.photo", 
-                    R_MNTL_NW,      R_NONE,  R_KENNEY_E},
-    {  R_MNTL_NW, "MNTL", "images/mntlnw.photo", 
-                    R_NEWMARK, R_MNTLLOBBY,  R_CSL_VIEW},
-    {  R_MNTL_SW, "MNTL", "images/mntlsw.photo", 
-                    R_MNTL_NW, R_MNTLLOBBY,   R_BECKMAN},
-    {R_MNTLLOBBY, "Lobby of MNTL", "images/mntllobby.photo", 
-                  R_MNTL_LAB1,   R_MNTL_SW, R_MNTL_LAB2},
-    {R_MNTL_LAB1, "Kevin's Lab in MNTL", "images/mntllab1.photo", 
-                       R_NONE,      R_NONE, R_MNTLLOBBY},
-    {R_MNTL_LAB2, "MNTL Laser Lab", "images/mntllab2.photo", 
-                  R_MNTLLOBBY, R_MNTL_LAB3,      R_NONE},
-    {R_MNTL_LAB3, "MNTL Laser Lab", "images/mntllab3.photo", 
-                       R_NONE, R_MNTL_LAB2,      R_NONE},
-    { R_CSL_VIEW, "CSL", "images/csl.photo", 
-                   R_BECK_LOT,  R_CSL_DOOR,   R_MNTL_NW},
-    { R_CSL_DOOR, "CSL Main Entrance", "images/csldoor.photo", 
-                   R_BECK_LOT,      R_NONE,   R_MNTL_NW},
-    {R_CSL_LOBBY, "CSL Lobby", "images/csllobby.photo", 
-                  R_CSL_UPPER,  R_CSL_DOOR,      R_NONE},
-    {R_CSL_UPPER, "Upper Floor of CSL", "images/cslupper.photo", 
-                       R_NONE, R_CSLLOUNGE, R_CSL_LOBBY},
-    {R_CSLLOUNGE, "CSL Lounge", "images/csllounge.photo", 
-                       R_NONE, R_CSL_UPPER,      R_NONE},
-    { R_BECK_LOT, "Beckman Circle Lot", "images/becklot.photo", 
-                    R_BECKMAN,    R_GARAGE,  R_CSL_VIEW},
-    {  R_BECKMAN, "Beckman Institute", "images/beckman.photo", 
-                    R_MNTL_SW, R_BECK_DOOR,  R_BECK_LOT},
-    {R_BECK_DOOR, "Beckman Institute", "images/beckdoor.photo", 
-                    R_MNTL_SW,      R_NONE,  R_BECK_LOT},
-    {R_BECKLOBBY, "Beckman Lobby", "images/becklobby.photo", 
-                       R_NONE,  R_BECK_MRI, R_BECK_DOOR},
-    { R_BECK_MRI, "An MRI Lab", "images/beckmri.photo", 
-                       R_NONE, R_BECKLOBBY,      R_NONE},
+/*
+ * A saved game is written as one block: the header below, followed by 
+ * one record for each object that had been set up, in limbo or not.
+ * Objects in rooms come first, room by room, each room's objects in the
+ * reverse of their drawing order (so that placing each at the front of 
+ * the room's contents restores the order).  Rooms and objects are given
+ * by their indices in the world file, so a game can only be restored 
+ * with the world file with which it was saved (the header records the
+ * file's sizes to check).  Objects that had not been set up are where
+ * they start, as are the rooms that had not been.
+ */
+#define SAVE_MAGIC   "MP2S"	/* saved game magic sequence (in header) */
+#define SAVE_VERSION 2		/* version of the format described here  */
+
+typedef struct save_header_t save_header_t;
+struct save_header_t {
+    char     magic[4];		/* SAVE_MAGIC (not NUL-terminated)       */
+    uint32_t version;		/* SAVE_VERSION                          */
+    uint32_t n_rooms;		/* sizes of the world file               */
+    uint32_t n_objects;
+    uint32_t strings_len;
+    uint32_t n_saved;		/* number of object records that follow  */
+    int32_t  where;		/* player's room                         */
+    game_view_t view;		/* state kept by adventure.c             */
+    uint32_t flags[(NUM_FLAGS + 31) / 32]; /* accomplishment flags       */
+    int32_t  swapped[N_SWAPS];	/* room showing each swap photo, if any  */
+    int32_t  enter[N_KNOWN_ROOMS]; /* "enter" links of puzzle rooms      */
+};
 
-    /* Area 4: The Rest of the World, Featuring the Remote Sensing Lab */
-    {   R_GARAGE, "Campus Parking", "images/garage.photo", 
-                   R_BECK_LOT,  R_CAR_SITE,      R_NONE},
-    { R_CAR_SITE, "Use Someone's Car?", "images/carclosed.photo", 
-                       R_NONE,    R_GARAGE,      R_NONE},
-    { R_ALLERTON, "Allerton Mansion", "images/allerton.photo", 
-                    R_FU_DOGS,      R_NONE, R_SUNSINGER},
-    {  R_FU_DOGS, "Fu Dog Statues", "images/fudogs.photo", 
-                       R_NONE,    R_STATUE,  R_ALLERTON},
-    {   R_STATUE, "A Tall Statue", "images/statue.photo", 
-                       R_NONE,   R_FU_DOGS,      R_NONE},
-    {R_SUNSINGER, "The Sun Singer", "images/sunsinger.photo", 
-                   R_ALLERTON,      R_NONE,      R_NONE},
-    {  R_WILLARD, "Willard Airport", "images/willard.photo", 
-                       R_NONE, R_WILL_SIDE,      R_NONE},
-    {R_WILL_SIDE, "Willard Tower", "images/willardside.photo", 
-                  R_REM_PLANE,      R_NONE,   R_WILLARD},
-    {R_REM_PLANE, "Sensor-Laden Plane", "images/rsenseplane.photo", 
-                    R_COCKPIT,      R_NONE, R_WILL_SIDE},
-    {  R_COCKPIT, "Plane Cockpit", "images/cockpit.photo", 
-                       R_NONE,      R_NONE, R_REM_PLANE},
-    {R_OVER_WILL, "Flying over Willard", "images/overwillard.photo", 
-                       R_NONE,   R_COCKPIT,   R_AIR_RIO},
-    {  R_AIR_RIO, "Rio de Janeiro", "images/riofromair.photo", 
-                  R_OVER_WILL,      R_NONE,   R_REM_ICE},
-    {  R_REM_ICE, "Ice Fields", "images/rsenseice.photo", 
-                    R_AIR_RIO,   R_REM_LAB,      R_NONE},
-    {  R_REM_LAB, "Remote Sensing Lab", "images/rsenselab.photo", 
-                       R_NONE,   R_REM_ICE,      R_NONE}
+typedef struct save_object_t save_object_t;
+struct save_object_t {
+    uint32_t obj;		/* the object                            */
+    int32_t  room;		/* its room, or WORLD_NONE for limbo     */
+    uint16_t x, y;		/* location within room photo            */
 };
 
 /*
- * This local structure is used to specify object information in a 
- * reasonably manageable way.  The array entries in the database specify 
- * the object id, name, filename, starting room (if any), and starting 
- * location * within that room (if not random).  We use this approach for 
- * the same * reason as with the rooms: to avoid the need to match the 
- * order between the enumeration of symbolic names and the array entries.
- */
-typedef struct obj_data_t obj_data_t;
-struct obj_data_t {
-    int32_t id;			/* object identifier                   */
-    const char* const name;	/* object keyword                      */
-    const char* const filename; /* object image file name              */
-    int32_t room;		/* starting room or R_NONE             */
-    int32_t x;			/* starting x position (-1 for random) */
-    int32_t y;			/* starting y position                 */
+ * The rooms, objects, and swap photos themselves are described in the 
+ * world file (see world.txt and world_headers.h).  The game finds the 
+ * ones named by the identifiers above by their keys in the file.
+ */
+static const char* const room_key[N_KNOWN_ROOMS] = {
+    [R_INVENTORY] = "inventory",
+    [R_IN_391LAB] = "in_391lab",
+    [R_BY_391LAB] = "by_391lab",
+    [R_IN_IEEE]   = "in_ieee",
+    [R_BY_IEEE]   = "by_ieee",
+    [R_IN_395LAB] = "in_395lab",
+    [R_BY_395LAB] = "by_395lab",
+    [R_EVT_STAIR] = "evt_stair",
+    [R_IN_CLEANR] = "in_cleanr",
+    [R_BY_CLEANR] = "by_cleanr",
+    [R_EVRT_VEND] = "evrt_vend",
+    [R_ALMAMATER] = "almamater",
+    [R_IN_COCOMR] = "in_cocomr",
+    [R_BY_COCOMR] = "by_cocomr",
+    [R_BY_ZAS]    = "by_zas",
+    [R_EAST_EVRT] = "east_evrt",
+    [R_EVRT_BSMT] = "evrt_bsmt",
+    [R_WEST_BONE] = "west_bone",
+    [R_CIRCLE_N]  = "circle_n",
+    [R_CIRCLE_SW] = "circle_sw",
+    [R_EAST_BONE] = "east_bone",
+    [R_BARDEEN]   = "bardeen",
+    [R_LIB_BACK]  = "lib_back",
+    [R_RESERVE]   = "reserve",
+    [R_TALBOT_NW] = "talbot_nw",
+    [R_TALBOT_SW] = "talbot_sw",
+    [R_TALBOT]    = "talbot",
+    [R_SPRINGFLD] = "springfld",
+    [R_CARIBOU]   = "caribou",
+    [R_KENNEY]    = "kenney",
+    [R_DCL]       = "dcl",
+    [R_LIB_FRONT] = "lib_front",
+    [R_KENNEY_E]  = "kenney_e",
+    [R_NEWMARK]   = "newmark",
+    [R_MNTL_NW]   = "mntl_nw",
+    [R_MNTL_SW]   = "mntl_sw",
+    [R_MNTLLOBBY] = "mntllobby",
+    [R_MNTL_LAB1] = "mntl_lab1",
+    [R_MNTL_LAB2] = "mntl_lab2",
+    [R_MNTL_LAB3] = "mntl_lab3",
+    [R_CSL_VIEW]  = "csl_view",
+    [R_CSL_DOOR]  = "csl_door",
+    [R_CSL_LOBBY] = "csl_lobby",
+    [R_CSL_UPPER] = "csl_upper",
+    [R_CSLLOUNGE] = "csllounge",
+    [R_BECK_LOT]  = "beck_lot",
+    [R_BECKMAN]   = "beckman",
+    [R_BECK_DOOR] = "beck_door",
+    [R_BECKLOBBY] = "becklobby",
+    [R_BECK_MRI]  = "beck_mri",
+    [R_GARAGE]    = "garage",
+    [R_CAR_SITE]  = "car_site",
+    [R_ALLERTON]  = "allerton",
+    [R_FU_DOGS]   = "fu_dogs",
+    [R_STATUE]    = "statue",
+    [R_SUNSINGER] = "sunsinger",
+    [R_WILLARD]   = "willard",
+    [R_WILL_SIDE] = "will_side",
+    [R_REM_PLANE] = "rem_plane",
+    [R_COCKPIT]   = "cockpit",
+    [R_OVER_WILL] = "over_will",
+    [R_AIR_RIO]   = "air_rio",
+    [R_REM_ICE]   = "rem_ice",
+    [R_REM_LAB]   = "rem_lab"
+};
+static const char* const obj_key[N_KNOWN_OBJECTS] = {
+    [O_BOARD]      = "board",
+    [O_JETPACK]    = "jetpack",
+    [O_TUX]        = "tux",
+    [O_MP2]        = "mp2",
+    [O_BOOK_C]     = "book_c",
+    [O_BOOK_WODE]  = "book_wode",
+    [O_GPS_BAD]    = "gps_bad",
+    [O_GPS_GOOD]   = "gps_good",
+    [O_GPS_SPEC]   = "gps_spec",
+    [O_BUNNYSUIT]  = "bunnysuit",
+    [O_BATT_EMPTY] = "batt_empty",
+    [O_BATT_FULL]  = "batt_full",
+    [O_BATT_CAR]   = "batt_car",
+    [O_MTN_DEW]    = "mtn_dew",
+    [O_FISH]       = "fish",
+    [O_ICARD]      = "icard",
+    [O_CAR_KEY]    = "car_key",
+    [O_ROBOT_DEAD] = "robot_dead",
+    [O_ROBOT_LIVE] = "robot_live",
+    [O_MIMO_CARD]  = "mimo_card"
 };
 
-/* the object positioning data */
-static const obj_data_t obj_data[N_OBJECTS] = {
-    {     O_BOARD, "board", "images/board.obj", R_IN_IEEE, -1, -1},
-    {   O_JETPACK, "jetpack", "images/jetpack.obj", R_TALBOT, -1, -1},
-    {       O_TUX, "tux", "images/tux.obj", R_REM_LAB, 250, 100},
-    {       O_MP2, "mp2", "images/mp2.obj", R_CSLLOUNGE, -1, -1},
-    {    O_BOOK_C, "book", "images/book.obj", R_NONE, -1, -1},
-    { O_BOOK_WODE, "book", "images/book2.obj", R_NONE, -1, -1},
-    {   O_GPS_BAD, "gps", "images/gpsbad.obj", R_TALBOT, -1, -1},
-    {  O_GPS_GOOD, "gps", "images/gpsgood.obj", R_NONE, -1, -1},
-    {  O_GPS_SPEC, "spec", "images/gpsspec.obj", R_CSL_UPPER, -1, -1},
-    { O_BUNNYSUIT, "bunnysuit", "images/bunnysuit.obj", R_ALMAMATER, 230, 250},
-    {O_BATT_EMPTY, "battery", "images/battery.obj", R_NONE, -1, -1},
-    { O_BATT_FULL, "battery", "images/battery.obj", R_NONE, -1, -1},
-    {  O_BATT_CAR, "battery", "images/batteryincar.obj", R_NONE, -1, -1},
-    {   O_MTN_DEW, "dew", "images/dew.obj", R_NONE, -1, -1},
-    {      O_FISH, "fish", "images/fish.obj", R_EAST_BONE, 80, 260},
-    {     O_ICARD, "Icard", "images/icard.obj", R_BARDEEN, -1, -1},
-    {   O_CAR_KEY, "key", "images/key.obj", R_CARIBOU, -1, -1},
-    {O_ROBOT_DEAD, "robot", "images/robot.obj", R_MNTL_LAB3, -1, -1},
-    {O_ROBOT_LIVE, "robot", "images/robot.obj", R_NONE, -1, -1},
-    { O_MIMO_CARD, "mimo", "images/mimo.obj", R_STATUE, -1, -1}
+/*
+ * Words that typed commands look for in their arguments (object names, 
+ * places to go, things to buy, and so forth).  These are the first names
+ * interned, in this order, so that each word's symbol is its identifier.
+ * They and the object names are also added to the noun trie so that they
+ * can be completed as they are typed.
+ */
+enum {
+    W_391, W_AIRPORT, W_ALLERTON, W_BATTERY, W_BOOK, W_BUNNYSUIT, 
+    W_CAMPUS, W_CAR, W_CARD, W_DEW, W_FISH, W_GPS, W_MIMO, W_MP2, 
+    W_ROBOT, W_TRANSMITTER, W_WILLARD, W_YOGURT,
+    N_ARG_WORDS
+};
+static const char* const arg_words[N_ARG_WORDS] = {
+    "391", "airport", "allerton", "battery", "book", "bunnysuit",
+    "campus", "car", "card", "dew", "fish", "gps", "mimo", "mp2",
+    "robot", "transmitter", "willard", "yogurt"
 };
 
 /*
  * Some rooms alternate between two photos.  For these rooms, we load the
  * image data for both photos once, but need an extra pointer in order to
- * keep track of the photo currently swapped out.  We use these swap data
- * to name and describe these extra photos.
+ * keep track of the photo currently swapped out.  The extra photos are
+ * found in the world file by these keys.
  */
-typedef struct swap_data_t swap_data_t;
-struct swap_data_t {
-    int32_t id;
-    const char* const filename;
-};
-
-/* the swap photo descriptions */
-static const swap_data_t swap_data[N_SWAPS] = {
-    {SWAP_CIRCLE, "images/circlen2.photo"},	/* alternate for Boneyard */
-    {SWAP_CAR, "images/caropen.photo"}		/* open/closed car photos */
+static const char* const swap_key[N_SWAPS] = {
+    [SWAP_CIRCLE] = "circle",	/* alternate for Boneyard */
+    [SWAP_CAR]    = "car"	/* open/closed car photos */
 };
 
-
 /* functions local to this file--see function headers for details */
 static void do_photo_swap (room_t* r, int32_t which);
-static object_t* find_in_room (const room_t* r, const char* arg);
+static object_t* find_in_room (const room_t* r, int32_t sym);
 static void insert_object_at (object_t* o, room_t* r, int32_t x, int32_t y);
 static void insert_object (object_t* o, room_t* r);
+static void grow_room_objects (room_t* r);
 static void move_object_to_inventory (object_t* obj);
-static object_t* obj_special_get (room_t* r, const char* arg);
+static object_t* obj_special_get (room_t* r, int32_t sym);
 static int32_t player_flag_is_set (int32_t fnum);
 static void player_set_flag (int32_t fnum);
 static void remove_object (object_t* o);
+static int32_t map_world_file (const char* fname);
+static const char* world_string (uint32_t off);
+static int32_t find_world_item (const char* key);
+static room_t* world_link (int32_t idx);
+static room_t* use_room (room_t* r);
+static object_t* use_object (object_t* o);
+static int32_t build_room_graph (void);
+static int32_t index_objects (void);
+static int32_t walk_distance (int32_t from, int32_t to);
+static int32_t saved_room_ok (int32_t idx);
+static int32_t saved_game_ok (const uint8_t* buf, size_t len);
+static void reset_objects (void);
 
 
 /* file-scope variables */
+
+/* the session played by this thread */
+static __thread world_session_t* cur;
+
+/*
+ * The world file, mapped into memory (or read into memory if it can't be
+ * mapped), and the parts of it.  A session's rooms and objects are set
+ * up when the session first uses them.
+ */
+static const world_header_t* world_hdr;	  /* its header             */
+static const world_room_t*   world_room;  /* its rooms              */
+static const world_object_t* world_obj;	  /* its objects            */
+static const world_swap_t*   world_swap;  /* its swap photos        */
+static const uint32_t*       world_slot;  /* its key hash table     */
+static const char*           world_str;	  /* its string table       */
+static int32_t known_room_idx[N_KNOWN_ROOMS];  /* rooms used by puzzles  */
+static int32_t known_obj_idx[N_KNOWN_OBJECTS]; /* objects used by them   */
+
+/*
+ * The photos and images shared by the sessions: each room's photo and 
+ * each object's image, read by the first session to use them (NULL until
+ * then), and the swap photos.  Reading them is serialized by asset_lock;
+ * the photos' pixels are loaded and shared as described in photo.c.
+ */
+static pthread_mutex_t asset_lock = PTHREAD_MUTEX_INITIALIZER;
+static photo_t**       room_photos;
+static image_t**       obj_images;
+static photo_t*        swap_photos[N_SWAPS];
+
+/* the interned name of each object, indexed by object */
+static int32_t* obj_name_sym;
+
 /* 
- * Flags are coded as bit vectors using an array of 32-bit words.  It's 
- * overkill for this game, but it's nice not to worry about the number of 
- * flags...
+ * The first room with each name, indexed by symbol, and the next room
+ * with the same name, indexed by room (both TRAVEL_NONE at the end).
  */
-static room_t   room[N_ROOMS];			     /* rooms                */
-static object_t object[N_OBJECTS];		     /* objects              */
-static uint32_t player_flags[(NUM_FLAGS + 31) / 32]; /* accomplishment flags */
-static photo_t* swap_photo[N_SWAPS];                 /* swapping photos      */
+static int32_t* first_room_named;
+static int32_t* next_room_named;
+static int32_t  n_room_names;	/* number of symbols in first_room_named */
 
 
 /* 
@@ -453,7 +494,7 @@ static photo_t* swap_photo[N_SWAPS];                 /* swapping photos      */
  *	     which -- index into array of stored photos
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: records the room showing the stored photo
  */
 static void
 do_photo_swap (room_t* r, int32_t which)
@@ -462,36 +503,39 @@ do_photo_swap (room_t* r, int32_t which)
 
     /* Swap the photos. */
     tmp               = r->view;
-    r->view           = swap_photo[which];
-    swap_photo[which] = tmp;
+    r->view           = cur->swap_photo[which];
+    cur->swap_photo[which] = tmp;
+
+    /* Swapping again puts the photos back. */
+    cur->swapped_into[which] = (NULL == cur->swapped_into[which] ? r : NULL);
 }
 
 
 /* 
  * find_in_room
- *   DESCRIPTION: Find an object by name in a room.  The name must match
- *                exactly, although the match is not sensitive to case.
+ *   DESCRIPTION: Find an object by name in a room by comparing the
+ *                interned names kept with the room's contents; if several
+ *                objects with the name are in the room, the one placed
+ *                there last (the first in the room's contents) is found.
  *   INPUTS: r -- the room in which to look
- *           arg -- the name of the object (a string)
+ *           sym -- the interned name of the object (or SYM_NONE)
  *   OUTPUTS: none
  *   RETURN VALUE: a pointer to a matching object, or NULL if none is found
  *   SIDE EFFECTS: none
  */
 static object_t* 
-find_in_room (const room_t* r, const char* arg)
+find_in_room (const room_t* r, int32_t sym)
 {
-    object_t* obj;	/* index over room contents */
-
-    /* Loop over objects in room. */
-    for (obj = r->contents; NULL != obj; obj = obj->next) {
+    int32_t idx; /* index over room's objects */
 
-	/* If we find a matching object, return it. */
-        if (0 == strcasecmp (arg, obj->name)) {
-	    return obj;
+    if (SYM_NONE == sym) {
+	return NULL;
+    }
+    for (idx = 0; r->n_objs > idx; idx++) {
+	if (sym == r->obj_sym[idx]) {
+	    return r->obj[idx];
 	}
     }
-
-    /* No object found: return NULL. */
     return NULL;
 }
 
@@ -512,6 +556,8 @@ find_in_room (const room_t* r, const char* arg)
 static void 
 insert_object_at (object_t* o, room_t* r, int32_t x, int32_t y)
 {
+    int32_t idx; /* index over room's objects */
+
     /* Remove object from its current room, if any. */
     remove_object (o);
 
@@ -519,10 +565,56 @@ insert_object_at (object_t* o, room_t* r, int32_t x, int32_t y)
     o->x = x;
     o->y = y;
 
-    /* Now add the object to the new room's contents. */
+    /* Now add the object to the front of the new room's contents. */
+    if (r->max_objs == r->n_objs) {
+	grow_room_objects (r);
+    }
+    for (idx = r->n_objs++; 0 < idx; idx--) {
+	r->obj_x[idx] = r->obj_x[idx - 1];
+	r->obj_y[idx] = r->obj_y[idx - 1];
+	r->obj_w[idx] = r->obj_w[idx - 1];
+	r->obj_h[idx] = r->obj_h[idx - 1];
+	r->obj_img[idx] = r->obj_img[idx - 1];
+	r->obj_sym[idx] = r->obj_sym[idx - 1];
+	r->obj[idx] = r->obj[idx - 1];
+	r->obj[idx]->slot = idx;
+    }
+    r->obj_x[0] = x;
+    r->obj_y[0] = y;
+    r->obj_w[0] = image_width (o->img);
+    r->obj_h[0] = image_height (o->img);
+    r->obj_img[0] = o->img;
+    r->obj_sym[0] = obj_name_sym[o - cur->object];
+    r->obj[0] = o;
+    o->slot = 0;
     o->loc = r;
-    o->next = r->contents;
-    r->contents = o;
+}
+
+
+/* 
+ * grow_room_objects
+ *   DESCRIPTION: Make room for more objects in a room's object arrays.
+ *   INPUTS: r -- the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reallocates the arrays; terminates the program if out
+ *                 of memory
+ */
+static void
+grow_room_objects (room_t* r)
+{
+    int32_t n = (0 == r->max_objs ? 8 : 2 * r->max_objs); /* new space */
+
+    if (NULL == (r->obj_x = realloc (r->obj_x, n * sizeof (uint16_t))) ||
+	NULL == (r->obj_y = realloc (r->obj_y, n * sizeof (uint16_t))) ||
+	NULL == (r->obj_w = realloc (r->obj_w, n * sizeof (uint16_t))) ||
+	NULL == (r->obj_h = realloc (r->obj_h, n * sizeof (uint16_t))) ||
+	NULL == (r->obj_img = realloc (r->obj_img, n * sizeof (image_t*))) ||
+	NULL == (r->obj_sym = realloc (r->obj_sym, n * sizeof (int32_t))) ||
+	NULL == (r->obj = realloc (r->obj, n * sizeof (object_t*)))) {
+	PANIC ("out of memory for room contents");
+    }
+    r->max_objs = n;
 }
 
 
@@ -581,7 +673,8 @@ insert_object (object_t* o, room_t* r)
 static void
 move_object_to_inventory (object_t* obj)
 {
-    object_t* conf;	/* loop index over possible conflicts for a space */
+    room_t*   inv;	/* the inventory                                  */
+    int32_t   conf;	/* loop index over possible conflicts for a space */
     int32_t   x;	/* loop index for 3x3 grid x positions            */
     int32_t   y;	/* loop index for 3x3 grid y positions            */
 
@@ -589,23 +682,23 @@ move_object_to_inventory (object_t* obj)
      * This approach is asymptotically slow (N^2), but there shouldn't be 
      * much in inventory, so it doesn't matter.
      */
+    inv = cur->known_room[R_INVENTORY];
     for (y = 10; 160 >= y; y += 50) {
         for (x = 10; 210 >= x; x += 100) {
-	    for (conf = room[R_INVENTORY].contents; NULL != conf; 
-	    	 conf = conf->next) {
-	        if (x == conf->x && y == conf->y) {
+	    for (conf = 0; inv->n_objs > conf; conf++) {
+	        if (x == inv->obj_x[conf] && y == inv->obj_y[conf]) {
 		    break;
 		}
 	    }
-	    if (NULL == conf) {
-		insert_object_at (obj, &room[R_INVENTORY], x, y);
+	    if (inv->n_objs == conf) {
+		insert_object_at (obj, cur->known_room[R_INVENTORY], x, y);
 		return;
 	    }
 	}
     }
 
     /* Give up: place randomly in bottom quarter like a room. */
-    insert_object (obj, &room[R_INVENTORY]);
+    insert_object (obj, cur->known_room[R_INVENTORY]);
 }
 
 
@@ -615,34 +708,35 @@ move_object_to_inventory (object_t* obj)
  *                gets an object that is not represented as an object_t in
  *                the room's contents.
  *   INPUTS: r -- the room in which the "get" is performed
- *           arg -- the name of the object sought
+ *           sym -- the interned name of the object sought
  *   OUTPUTS: none
  *   RETURN VALUE: an object to be gotten by the player, or NULL for nothing
  *   SIDE EFFECTS: may move objects or show status messages
  */
 static object_t*
-obj_special_get (room_t* r, const char* arg)
+obj_special_get (room_t* r, int32_t sym)
 {
     /* Get a book from the Grainger reference desk... */
-    if (&room[R_RESERVE] == r && 0 == strcasecmp ("book", arg)) {
+    if (cur->known_room[R_RESERVE] == r && W_BOOK == sym) {
 	/* can only get it once... */
 	if (player_flag_is_set (FLAG_HAS_EATEN)) {
-	    if (NULL == object[O_BOOK_C].loc) {
+	    if (NULL == cur->known_obj[O_BOOK_C]->loc) {
 		show_status ("You check out the C book.");
-		return &object[O_BOOK_C];
+		return cur->known_obj[O_BOOK_C];
 	    }
 	} else {
-	    if (NULL == object[O_BOOK_WODE].loc) {
+	    if (NULL == cur->known_obj[O_BOOK_WODE]->loc) {
 		show_status ("Here's a nice Wodehouse collection.");
-		return &object[O_BOOK_WODE];
+		return cur->known_obj[O_BOOK_WODE];
 	    }
 	}
     }
 
     /* Pick up the car battery... */
-    if (&room[R_CAR_SITE] == r && object[O_BATT_CAR].loc == r) {
-        remove_object (&object[O_BATT_CAR]);
-	return &object[O_BATT_EMPTY];
+    if (cur->known_room[R_CAR_SITE] == r && 
+	cur->known_obj[O_BATT_CAR]->loc == r) {
+        remove_object (cur->known_obj[O_BATT_CAR]);
+	return cur->known_obj[O_BATT_EMPTY];
     }
 
     /* That's all, folks! */
@@ -661,7 +755,7 @@ obj_special_get (room_t* r, const char* arg)
 static int32_t
 player_flag_is_set (int32_t fnum)
 {
-    return (0 != (player_flags[fnum / 32] & (1UL << (fnum % 32))));
+    return (0 != (cur->player_flags[fnum / 32] & (1UL << (fnum % 32))));
 }
 
 
@@ -677,7 +771,7 @@ player_flag_is_set (int32_t fnum)
 static void
 player_set_flag (int32_t fnum)
 {
-    player_flags[fnum / 32] |= (1UL << (fnum % 32));
+    cur->player_flags[fnum / 32] |= (1UL << (fnum % 32));
 }
 
 
@@ -693,19 +787,24 @@ player_set_flag (int32_t fnum)
 static void
 remove_object (object_t* o)
 {
-    object_t** find;	/* loop index over pointers to objects in room */
+    room_t* r;	 /* room holding the object */
+    int32_t idx; /* index over room's objects */
 
     /* Is object already in limbo? */
-    if (NULL != o->loc) {
-
-	/* Remove from previous room (with safety check)... */
-	for (find = &o->loc->contents; NULL != *find; find = &(*find)->next) {
-	    if (o == *find) {
-		/* We found the predecessor!  Unlink the object. */
-	        *find = o->next;
-		break;
-	    }
+    if (NULL != (r = o->loc)) {
+
+	/* Close up the gap in the room's object arrays. */
+	for (idx = o->slot + 1; r->n_objs > idx; idx++) {
+	    r->obj_x[idx - 1] = r->obj_x[idx];
+	    r->obj_y[idx - 1] = r->obj_y[idx];
+	    r->obj_w[idx - 1] = r->obj_w[idx];
+	    r->obj_h[idx - 1] = r->obj_h[idx];
+	    r->obj_img[idx - 1] = r->obj_img[idx];
+	    r->obj_sym[idx - 1] = r->obj_sym[idx];
+	    r->obj[idx - 1] = r->obj[idx];
+	    r->obj[idx - 1]->slot = idx - 1;
 	}
+	r->n_objs--;
 
 	/* Mark the object's location as NULL. */
 	o->loc = NULL;
@@ -713,6 +812,258 @@ remove_object (object_t* o)
 }
 
 
+/* 
+ * map_world_file
+ *   DESCRIPTION: Map a world file into memory (or, if it can't be mapped,
+ *                read it into memory), and check that its parts fit in it.
+ *                The contents of the parts are checked as they are used.
+ *   INPUTS: fname -- name of the world file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: prints error messages to stderr on failure
+ */
+static int32_t
+map_world_file (const char* fname)
+{
+    int         fd;	/* world file descriptor        */
+    struct stat st;	/* world file status            */
+    void*       addr;	/* contents of the file         */
+    size_t      done;	/* bytes read from the file     */
+    ssize_t     got;	/* bytes got by one read        */
+    uint64_t    len;	/* length implied by the header */
+
+    if (-1 == (fd = open (fname, O_RDONLY))) {
+	perror ("open world file");
+	return -1;
+    }
+    if (0 != fstat (fd, &st) || sizeof (world_header_t) > st.st_size) {
+	fprintf (stderr, "%s is not a world file.\n", fname);
+	(void)close (fd);
+	return -1;
+    }
+    addr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == addr) {
+	if (NULL == (addr = malloc (st.st_size))) {
+	    perror ("allocate world file");
+	    (void)close (fd);
+	    return -1;
+	}
+	for (done = 0; st.st_size > done; done += got) {
+	    if (0 >= (got = read (fd, (uint8_t*)addr + done, 
+	    			  st.st_size - done))) {
+		perror ("read world file");
+		free (addr);
+		(void)close (fd);
+		return -1;
+	    }
+	}
+    }
+    (void)close (fd);
+
+    /* Find the parts of the file, and check that they fill it. */
+    world_hdr = addr;
+    world_room = (const world_room_t*)(world_hdr + 1);
+    world_obj = (const world_object_t*)(world_room + world_hdr->n_rooms);
+    world_swap = (const world_swap_t*)(world_obj + world_hdr->n_objects);
+    world_slot = (const uint32_t*)(world_swap + world_hdr->n_swaps);
+    world_str = (const char*)(world_slot + world_hdr->n_slots);
+    len = sizeof (world_header_t) + 
+	  (uint64_t)world_hdr->n_rooms * sizeof (world_room_t) +
+	  (uint64_t)world_hdr->n_objects * sizeof (world_object_t) +
+	  (uint64_t)world_hdr->n_swaps * sizeof (world_swap_t) +
+	  (uint64_t)world_hdr->n_slots * sizeof (uint32_t) +
+	  world_hdr->strings_len;
+    if (0 != memcmp (world_hdr->magic, WORLD_MAGIC, 4) ||
+	WORLD_VERSION != world_hdr->version || st.st_size != len ||
+	world_hdr->n_rooms <= world_hdr->start || 0 == world_hdr->n_slots || 
+	0 != (world_hdr->n_slots & (world_hdr->n_slots - 1)) ||
+	0 == world_hdr->strings_len ||
+	'\0' != world_str[world_hdr->strings_len - 1]) {
+	fprintf (stderr, "%s is not a valid world file.\n", fname);
+	return -1;
+    }
+    return 0;
+}
+
+
+/* 
+ * world_string
+ *   DESCRIPTION: Get a string from the world file's string table.
+ *   INPUTS: off -- offset of the string in the table
+ *   OUTPUTS: none
+ *   RETURN VALUE: the string
+ *   SIDE EFFECTS: terminates the program if the offset is bad
+ */
+static const char*
+world_string (uint32_t off)
+{
+    if (world_hdr->strings_len <= off) {
+	PANIC ("bad string in world file");
+    }
+    return world_str + off;
+}
+
+
+/* 
+ * find_world_item
+ *   DESCRIPTION: Find an item (room, object, or swap photo) in the world
+ *                file by its key.
+ *   INPUTS: key -- the key
+ *   OUTPUTS: none
+ *   RETURN VALUE: the item number (see world_headers.h), or -1 if no 
+ *                 item has the key
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+find_world_item (const char* key)
+{
+    uint32_t    mask = world_hdr->n_slots - 1; /* mask for slot index    */
+    uint32_t    hash = WORLD_HASH_INIT;        /* hash of key            */
+    uint32_t    slot;                          /* slot examined          */
+    uint32_t    n_probes;                      /* number of slots probed */
+    uint32_t    item;                          /* item in slot           */
+    uint32_t    off;                           /* offset of item's key   */
+    const char* s;                             /* index over key         */
+
+    for (s = key; '\0' != *s; s++) {
+	hash = WORLD_HASH_STEP (hash, *s);
+    }
+    for (slot = hash & mask, n_probes = 0; 
+	 world_hdr->n_slots > n_probes && 0 != world_slot[slot];
+	 slot = (slot + 1) & mask, n_probes++) {
+	item = world_slot[slot] - 1;
+	if (world_hdr->n_rooms > item) {
+	    off = world_room[item].key;
+	} else if (world_hdr->n_objects > (item -= world_hdr->n_rooms)) {
+	    off = world_obj[item].key;
+	} else if (world_hdr->n_swaps > (item -= world_hdr->n_objects)) {
+	    off = world_swap[item].key;
+	} else {
+	    PANIC ("bad key in world file");
+	}
+	if (0 == strcmp (key, world_string (off))) {
+	    return world_slot[slot] - 1;
+	}
+    }
+    return -1;
+}
+
+
+/* 
+ * world_link
+ *   DESCRIPTION: Get the room to which a world file room links.
+ *   INPUTS: idx -- index of the room, or WORLD_NONE
+ *   OUTPUTS: none
+ *   RETURN VALUE: the room (not necessarily set up), or NULL for WORLD_NONE
+ *   SIDE EFFECTS: terminates the program if the index is bad
+ */
+static room_t*
+world_link (int32_t idx)
+{
+    if (WORLD_NONE == idx) {
+	return NULL;
+    }
+    if (0 > idx || world_hdr->n_rooms <= idx) {
+	PANIC ("bad room link in world file");
+    }
+    return &cur->room[idx];
+}
+
+
+/* 
+ * use_room
+ *   DESCRIPTION: Set up a room the first time that the session uses it:
+ *                find its name, links, and photo (reading the photo's
+ *                size if no session has yet), and place the objects that
+ *                start in it.  Rooms are set up before they are handed
+ *                out by this file, so only the rooms that the game uses
+ *                cost anything.
+ *   INPUTS: r -- the room (or NULL)
+ *   OUTPUTS: none
+ *   RETURN VALUE: r
+ *   SIDE EFFECTS: may read room photo headers and object images;
+ *                 terminates the program if the room can't be set up
+ */
+static room_t*
+use_room (room_t* r)
+{
+    const world_room_t*   wr;  /* room in world file        */
+    const world_object_t* wo;  /* object in world file      */
+    uint32_t              idx; /* index over room's objects */
+    photo_t**             p;   /* shared photo of room      */
+
+    if (NULL == r || NULL != r->name) {
+	return r;
+    }
+    wr = &world_room[r - cur->room];
+    r->name = world_string (wr->name);
+    r->sym = find_name (r->name);
+    p = &room_photos[r - cur->room];
+    (void)pthread_mutex_lock (&asset_lock);
+    if (NULL == *p &&
+	NULL == (*p = read_photo_header (world_string (wr->photo)))) {
+	fprintf (stderr, "Can't read room photo %s.\n",
+		 world_string (wr->photo));
+	PANIC ("can't set up room");
+    }
+    (void)pthread_mutex_unlock (&asset_lock);
+    r->view = *p;
+    r->left = world_link (wr->left);
+    r->enter = world_link (wr->enter);
+    r->right = world_link (wr->right);
+
+    /* Place the objects that start in the room. */
+    if (world_hdr->n_objects < wr->first_obj ||
+	world_hdr->n_objects - wr->first_obj < wr->n_objs) {
+	PANIC ("bad room objects in world file");
+    }
+    for (idx = wr->first_obj; wr->first_obj + wr->n_objs > idx; idx++) {
+	wo = &world_obj[idx];
+	if (WORLD_RANDOM != wo->x) {
+	    insert_object_at (use_object (&cur->object[idx]), r,
+			      wo->x, wo->y);
+	} else {
+	    insert_object (use_object (&cur->object[idx]), r);
+	}
+    }
+    return r;
+}
+
+
+/* 
+ * use_object
+ *   DESCRIPTION: Set up an object the first time that the session uses
+ *                it: find its name and image (reading the image if no
+ *                session has yet).  The object is left in limbo.
+ *   INPUTS: o -- the object
+ *   OUTPUTS: none
+ *   RETURN VALUE: o
+ *   SIDE EFFECTS: terminates the program if the object can't be set up
+ */
+static object_t*
+use_object (object_t* o)
+{
+    const world_object_t* wo = &world_obj[o - cur->object];   /* in file */
+    image_t**             img = &obj_images[o - cur->object]; /* shared  */
+
+    if (NULL != o->name) {
+	return o;
+    }
+    o->name = world_string (wo->name);
+    (void)pthread_mutex_lock (&asset_lock);
+    if (NULL == *img &&
+	NULL == (*img = read_obj_image (world_string (wo->image)))) {
+	fprintf (stderr, "Can't read object photo %s.\n",
+		 world_string (wo->image));
+	PANIC ("can't set up object");
+    }
+    (void)pthread_mutex_unlock (&asset_lock);
+    o->img = *img;
+    o->loc = NULL;
+    return o;
+}
+
+
 /* 
  * obj_get_x
  *   DESCRIPTION: Get x position of object within containing room.
@@ -758,20 +1109,38 @@ obj_image (const object_t* obj)
 }
 
 
+/*
+ * obj_name
+ *   DESCRIPTION: Get name for an object.
+ *   INPUTS: obj -- pointer to the object
+ *   OUTPUTS: none
+ *   RETURN VALUE: the name of object obj (a string)
+ *   SIDE EFFECTS: none
+ */
+const char*
+obj_name (const object_t* obj)
+{
+    return obj->name;
+}
+
+
 /* 
  * obj_next
  *   DESCRIPTION: Get pointer to next object in object's room.  Use with
  *                room_contents_iterate to iterate over all objects in 
- *                a room.
+ *                a room.  (Drawing uses room_objects instead.)
  *   INPUTS: obj -- pointer to the object
  *   OUTPUTS: none
- *   RETURN VALUE: the object obj's next pointer (NULL if obj is last)
+ *   RETURN VALUE: the next object in obj's room (NULL if obj is last)
  *   SIDE EFFECTS: none
  */
 object_t*
 obj_next (const object_t* obj)
 {
-    return obj->next;
+    if (NULL == obj->loc || obj->loc->n_objs <= obj->slot + 1) {
+	return NULL;
+    }
+    return obj->loc->obj[obj->slot + 1];
 }
 
 
@@ -787,7 +1156,30 @@ obj_next (const object_t* obj)
 object_t*
 room_contents_iterate (const room_t* r)
 {
-    return r->contents;
+    return (0 == r->n_objs ? NULL : r->obj[0]);
+}
+
+
+/* 
+ * room_objects
+ *   DESCRIPTION: Get the positions, sizes, and images of the objects in a
+ *                room, as parallel arrays in drawing order (the same order
+ *                as room_contents_iterate).  The arrays remain valid until
+ *                an object is next placed in or removed from the room.
+ *   INPUTS: r -- pointer to the room
+ *   OUTPUTS: objs -- the arrays
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+room_objects (const room_t* r, room_objs_t* objs)
+{
+    objs->n = r->n_objs;
+    objs->x = r->obj_x;
+    objs->y = r->obj_y;
+    objs->w = r->obj_w;
+    objs->h = r->obj_h;
+    objs->img = r->obj_img;
 }
 
 
@@ -806,6 +1198,53 @@ room_name (const room_t* r)
 }
 
 
+/* 
+ * room_left
+ *   DESCRIPTION: Get the room to the "left" of a room.
+ *   INPUTS: r -- pointer to the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: the neighbouring room, or NULL if there is none
+ *   SIDE EFFECTS: none
+ */
+room_t*
+room_left (const room_t* r)
+{
+    return use_room (r->left);
+}
+
+
+/* 
+ * room_enter
+ *   DESCRIPTION: Get the room reached by "enter" from a room.  Rooms that can 
+ *                only be reached when special conditions are met are 
+ *                not included.
+ *   INPUTS: r -- pointer to the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: the neighbouring room, or NULL if there is none
+ *   SIDE EFFECTS: none
+ */
+room_t*
+room_enter (const room_t* r)
+{
+    return use_room (r->enter);
+}
+
+
+/* 
+ * room_right
+ *   DESCRIPTION: Get the room to the "right" of a room.
+ *   INPUTS: r -- pointer to the room
+ *   OUTPUTS: none
+ *   RETURN VALUE: the neighbouring room, or NULL if there is none
+ *   SIDE EFFECTS: none
+ */
+room_t*
+room_right (const room_t* r)
+{
+    return use_room (r->right);
+}
+
+
 /* 
  * room_photo
  *   DESCRIPTION: Get room photo for a room.
@@ -852,132 +1291,401 @@ room_photo_width (const room_t* r)
 
 
 /* 
- * build_world
- *   DESCRIPTION: Builds and connects the rooms, creates objects, and 
- *                reads in all image data (could be done lazily with 
- *                caching instead).
+ * build_room_graph
+ *   DESCRIPTION: Index all rooms in the world file by name, and prepare
+ *                the table of shortest paths between rooms over their
+ *                links.  The inventory's links are left out, as its 
+ *                "enter" link only leads back to the player's room.
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: 1 on success, or 0 on failure
- *   SIDE EFFECTS: prints error messages to stderr on failure
+ *   SIDE EFFECTS: interns the names of all rooms; prints error messages 
+ *                 to stderr on failure
  */
-int32_t
-build_world ()
+static int32_t
+build_room_graph ()
 {
-    int32_t idx;	/* index over data arrays   */
-    int32_t which;	/* id for current data item */
-
-    /* Clear all accomplishment flags. */
-    (void)memset (player_flags, 0, sizeof (player_flags));
+    const world_room_t* wr;     /* room in world file    */
+    int32_t             idx;    /* index over rooms      */
+    int32_t             sym;    /* interned room name    */
+    int32_t             link[3]; /* links of room        */
+    int32_t             dir;    /* index over links      */
+
+    if (0 != init_travel (world_hdr->n_rooms) ||
+	NULL == (next_room_named = malloc (world_hdr->n_rooms * 
+					   sizeof (next_room_named[0])))) {
+	fputs ("Can't allocate room paths.\n", stderr);
+	return 0;
+    }
+    for (idx = world_hdr->n_rooms; 0 < idx--; ) {
+	wr = &world_room[idx];
+	if (SYM_NONE == (sym = intern_name (world_string (wr->name)))) {
+	    fputs ("Can't intern room name.\n", stderr);
+	    return 0;
+	}
+	if (n_room_names <= sym) {
+	    first_room_named = realloc (first_room_named, 2 * (sym + 1) * 
+	    				sizeof (first_room_named[0]));
+	    if (NULL == first_room_named) {
+		fputs ("Can't index rooms by name.\n", stderr);
+		return 0;
+	    }
+	    for (; 2 * (sym + 1) > n_room_names; n_room_names++) {
+		first_room_named[n_room_names] = TRAVEL_NONE;
+	    }
+	}
+	next_room_named[idx] = first_room_named[sym];
+	first_room_named[sym] = idx;
 
-    /* Clear room data to enable sanity check for duplication. */
-    (void)memset (room, 0, sizeof (room));
+	if (known_room_idx[R_INVENTORY] == idx) {
+	    continue;
+	}
+	link[TRAVEL_LEFT] = wr->left;
+	link[TRAVEL_ENTER] = wr->enter;
+	link[TRAVEL_RIGHT] = wr->right;
+	for (dir = 0; 3 > dir; dir++) {
+	    if (WORLD_NONE != link[dir]) {
+		if (0 > link[dir] || world_hdr->n_rooms <= link[dir]) {
+		    fputs ("Bad room link in world file.\n", stderr);
+		    return 0;
+		}
+		set_travel_link (idx, dir, link[dir]);
+	    }
+	}
+    }
+    prepare_travel ();
+    return 1;
+}
 
-    /* Loop over room data. */
-    for (idx = 0; N_ROOMS > idx; idx++) {
-	
-	/* Set the room id. */
-	which = room_data[idx].id;
 
-	/* Check for bad and duplicate ids. */
-	if (0 > which || N_ROOMS <= which) {
-	    fputs ("Bad index in room data.\n", stderr);
+/* 
+ * index_objects
+ *   DESCRIPTION: Intern the names of all objects in the world file, and
+ *                add them to the noun trie.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: interns the names of all objects; prints error messages 
+ *                 to stderr on failure
+ */
+static int32_t
+index_objects ()
+{
+    const char* name;	/* name of object     */
+    int32_t     idx;	/* index over objects */
+
+    obj_name_sym = malloc ((world_hdr->n_objects + 1) * 
+			   sizeof (obj_name_sym[0]));
+    if (NULL == obj_name_sym) {
+	fputs ("Can't index objects by name.\n", stderr);
+	return 0;
+    }
+    for (idx = 0; world_hdr->n_objects > idx; idx++) {
+	name = world_string (world_obj[idx].name);
+	if (SYM_NONE == (obj_name_sym[idx] = intern_name (name))) {
+	    fputs ("Can't intern object name.\n", stderr);
 	    return 0;
 	}
-	if (NULL != room[which].name) {
-	    fprintf (stderr, "Duplicate index %d in room data.\n", which);
+	if (0 != add_noun (name)) {
+	    fputs ("Can't add object name to typed words.\n", stderr);
 	    return 0;
 	}
+    }
+    return 1;
+}
 
-	/* Set up the room. */
-        room[which].name = room_data[idx].name;
-	room[which].view = read_photo (room_data[idx].filename);
-	if (NULL == room[which].view) {
-	    fprintf (stderr, "Can't read room photo %s.\n", 
-	    	     room_data[idx].filename);
+
+/* 
+ * build_world
+ *   DESCRIPTION: Maps the world file and finds the rooms, objects, and
+ *                swap photos used by the game's puzzles, reads the swap
+ *                photos' sizes, and indexes the rooms and objects, all 
+ *                shared by the game's sessions; then starts a session 
+ *                (see new_world_session) played by the calling thread.
+ *                All names in the world are interned here, so that the 
+ *                sessions need only look names up.  Only the sizes of 
+ *                room photos are read; their pixels are read by 
+ *                load_world_photos (or when first shown).  Adds the 
+ *                argument words of typed commands and the object names
+ *                to the noun trie.
+ *   INPUTS: fname -- name of the world file
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: prints error messages to stderr on failure
+ */
+int32_t
+build_world (const char* fname)
+{
+    int32_t          idx;	/* index over puzzle items  */
+    int32_t          item;	/* item number in the file  */
+    world_session_t* s;		/* first session            */
+
+    /* 
+     * Intern the words sought by typed commands first, so that their
+     * symbols match their identifiers.
+     */
+    for (idx = 0; N_ARG_WORDS > idx; idx++) {
+	if (idx != intern_name (arg_words[idx])) {
+	    fputs ("Can't intern typed command words.\n", stderr);
 	    return 0;
 	}
-	room[which].contents = NULL;
-	room[which].left  = (R_NONE == room_data[idx].left ? NULL : 
-			     &room[room_data[idx].left]);
-	room[which].enter = (R_NONE == room_data[idx].enter ? NULL : 
-			     &room[room_data[idx].enter]);
-	room[which].right = (R_NONE == room_data[idx].right ? NULL : 
-			     &room[room_data[idx].right]);
     }
 
-    /* Clear object data to enable sanity check for duplication. */
-    (void)memset (object, 0, sizeof (object));
-
-    /* Loop over object data. */
-    for (idx = 0; N_OBJECTS > idx; idx++) {
-
-	/* Set the object id. */
-	which = obj_data[idx].id;
+    /* Map the world file, and make space for its photos and images. */
+    if (0 != map_world_file (fname)) {
+	return 0;
+    }
+    room_photos = calloc (world_hdr->n_rooms, sizeof (room_photos[0]));
+    obj_images = calloc (world_hdr->n_objects + 1, sizeof (obj_images[0]));
+    if (NULL == room_photos || NULL == obj_images) {
+	fputs ("Can't allocate world.\n", stderr);
+	return 0;
+    }
 
-	/* Check for bad and duplicate ids. */
-	if (0 > which || N_OBJECTS <= which) {
-	    fputs ("Bad index in object data.\n", stderr);
+    /* Find the rooms, objects, and swap photos used by the puzzles. */
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	item = find_world_item (room_key[idx]);
+	if (0 > item || world_hdr->n_rooms <= item) {
+	    fprintf (stderr, "No room %s in world file.\n", room_key[idx]);
 	    return 0;
 	}
-	if (NULL != object[which].name) {
-	    fprintf (stderr, "Duplicate index %d in object data.\n", which);
+	known_room_idx[idx] = item;
+    }
+    for (idx = 0; N_KNOWN_OBJECTS > idx; idx++) {
+	item = find_world_item (obj_key[idx]) - world_hdr->n_rooms;
+	if (0 > item || world_hdr->n_objects <= item) {
+	    fprintf (stderr, "No object %s in world file.\n", obj_key[idx]);
 	    return 0;
 	}
-
-	/* Set up the object. */
-        object[which].name = obj_data[idx].name;
-	object[which].img = read_obj_image (obj_data[idx].filename);
-	if (NULL == object[which].img) {
-	    fprintf (stderr, "Can't read object photo %s.\n", 
-	    	     obj_data[idx].filename);
+	known_obj_idx[idx] = item;
+    }
+    for (idx = 0; N_SWAPS > idx; idx++) {
+	item = (find_world_item (swap_key[idx]) - world_hdr->n_rooms - 
+		world_hdr->n_objects);
+	if (0 > item || world_hdr->n_swaps <= item) {
+	    fprintf (stderr, "No swap photo %s in world file.\n", 
+		     swap_key[idx]);
 	    return 0;
 	}
-        object[which].next = NULL;
-        object[which].loc = NULL;
-        object[which].x = 0;
-        object[which].y = 0;
+	swap_photos[idx] = read_photo_header (world_string 
+					      (world_swap[item].photo));
+	if (NULL == swap_photos[idx]) {
+	    fprintf (stderr, "Can't read room photo %s.\n", 
+	    	     world_string (world_swap[item].photo));
+	    return 0;
+	}
+    }
 
-	/* Insert it into a room if necessary. */
-	if (R_NONE != obj_data[idx].room) {
-	    if (-1 != obj_data[idx].x) {
-	        insert_object_at (&object[which], &room[obj_data[idx].room],
-				  obj_data[idx].x, obj_data[idx].y);
-	    } else {
-	        insert_object (&object[which], &room[obj_data[idx].room]);
-	    }
+    /* 
+     * Index the rooms and objects by name, and find the paths between
+     * rooms.  The words that can follow typed verbs go into the noun 
+     * trie ahead of the object names.
+     */
+    for (idx = 0; N_ARG_WORDS > idx; idx++) {
+	if (0 != add_noun (arg_words[idx])) {
+	    fputs ("Can't add typed command words.\n", stderr);
+	    return 0;
 	}
     }
+    if (!build_room_graph () || !index_objects ()) {
+	return 0;
+    }
 
-    /* Clear swap photo data to enable sanity check for duplication. */
-    (void)memset (swap_photo, 0, sizeof (swap_photo));
+    /* Start the first session. */
+    if (NULL == (s = new_world_session ())) {
+	fputs ("Can't allocate world.\n", stderr);
+	return 0;
+    }
+    use_world_session (s);
 
-    /* Loop over swap photo data. */
-    for (idx = 0; N_SWAPS > idx; idx++) {
+    /* Everything worked! */
+    return 1;
+}
 
-	/* Set the swap photo id. */
-	which = swap_data[idx].id;
 
-	/* Check for bad and duplicate ids. */
-	if (0 > which || N_SWAPS <= which) {
-	    fputs ("Bad index in swap data.\n", stderr);
-	    return 0;
+/* 
+ * new_world_session
+ *   DESCRIPTION: Start a new game session, sharing the world loaded by 
+ *                build_world.  Sets up the puzzle items, along with the
+ *                rooms in which the puzzle objects start (so that those 
+ *                objects are in place from the start), and the starting
+ *                room.  Other rooms and objects are set up when the 
+ *                session first uses them.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the session, or NULL if out of memory
+ *   SIDE EFFECTS: may read room photo headers and object images
+ */
+world_session_t*
+new_world_session ()
+{
+    world_session_t* s;		/* the session              */
+    world_session_t* prev;	/* this thread's session    */
+    int32_t          idx;	/* index over puzzle items  */
+
+    if (NULL == (s = calloc (1, sizeof (*s)))) {
+	return NULL;
+    }
+    s->room = calloc (world_hdr->n_rooms, sizeof (s->room[0]));
+    s->object = calloc (world_hdr->n_objects + 1, sizeof (s->object[0]));
+    if (NULL == s->room || NULL == s->object) {
+	free (s->room);
+	free (s->object);
+	free (s);
+	return NULL;
+    }
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	s->known_room[idx] = &s->room[known_room_idx[idx]];
+    }
+    for (idx = 0; N_KNOWN_OBJECTS > idx; idx++) {
+	s->known_obj[idx] = &s->object[known_obj_idx[idx]];
+    }
+    (void)memcpy (s->swap_photo, swap_photos, sizeof (swap_photos));
+
+    /* Set up the session's first rooms and objects. */
+    prev = cur;
+    cur = s;
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	(void)use_room (s->known_room[idx]);
+    }
+    for (idx = 0; N_KNOWN_OBJECTS > idx; idx++) {
+	(void)use_object (s->known_obj[idx]);
+	(void)use_room (world_link (world_obj[known_obj_idx[idx]].room));
+    }
+    (void)use_room (&s->room[world_hdr->start]);
+    cur = prev;
+    return s;
+}
+
+
+/* 
+ * use_world_session
+ *   DESCRIPTION: Make a session the one played by the calling thread.  
+ *                Everything else in this file (apart from the functions 
+ *                that examine only the room or object given) acts on the
+ *                calling thread's session.
+ *   INPUTS: s -- the session
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+use_world_session (world_session_t* s)
+{
+    cur = s;
+}
+
+
+/* 
+ * free_world_session
+ *   DESCRIPTION: End a session, freeing its rooms and objects (but not the
+ *                shared photos and images).  The session must not be in 
+ *                use by any thread.
+ *   INPUTS: s -- the session
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void
+free_world_session (world_session_t* s)
+{
+    room_t* r;	 /* index over rooms */
+
+    for (r = s->room; s->room + world_hdr->n_rooms > r; r++) {
+	free (r->obj_x);
+	free (r->obj_y);
+	free (r->obj_w);
+	free (r->obj_h);
+	free (r->obj_img);
+	free (r->obj_sym);
+	free (r->obj);
+    }
+    free (s->room);
+    free (s->object);
+    free (s);
+}
+
+
+/* 
+ * load_world_photos
+ *   DESCRIPTION: Load the photos of the rooms nearest the starting room 
+ *                (and the photos that replace them during the game), 
+ *                either now or in the background.  Photos are loaded in 
+ *                order of their distance from the starting room, so that
+ *                those that the player can reach soonest are ready first;
+ *                in small worlds, photos of rooms reached in other ways
+ *                follow, and swap photos come last.  Photos of rooms 
+ *                beyond the first PRELOAD_ROOMS are read when first shown.
+ *   INPUTS: background -- 1 to load in a background thread, or 0 to load 
+ *                         before returning
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 on success, or 0 on failure
+ *   SIDE EFFECTS: sets up the rooms whose photos are loaded; prints error
+ *                 messages to stderr on failure
+ */
+int32_t
+load_world_photos (int32_t background)
+{
+    static photo_t* order[PRELOAD_ROOMS + N_SWAPS]; /* photos in load order */
+    room_t*         queue[PRELOAD_ROOMS];    /* rooms in order of reach    */
+    int32_t         n_queued;                /* number of rooms queued     */
+    int32_t         n_order;                 /* number of photos in order  */
+    int32_t         idx;                     /* index over rooms           */
+    room_t*         next[3];                 /* neighbours of a room       */
+    int32_t         n_idx;                   /* index over neighbours      */
+    int32_t         q_idx;                   /* index over queue           */
+
+    /* Find rooms in breadth-first order from the starting room. */
+    queue[0] = start_in_room ();
+    n_queued = 1;
+    for (idx = 0; n_queued > idx && PRELOAD_ROOMS > n_queued; idx++) {
+	next[0] = queue[idx]->left;
+	next[1] = queue[idx]->enter;
+	next[2] = queue[idx]->right;
+	for (n_idx = 0; 3 > n_idx && PRELOAD_ROOMS > n_queued; n_idx++) {
+	    for (q_idx = 0; n_queued > q_idx; q_idx++) {
+		if (queue[q_idx] == next[n_idx]) {
+		    break;
+		}
+	    }
+	    if (NULL != next[n_idx] && n_queued == q_idx) {
+		queue[n_queued++] = use_room (next[n_idx]);
+	    }
 	}
-	if (NULL != swap_photo[which]) {
-	    fprintf (stderr, "Duplicate index %d in swap data.\n", which);
-	    return 0;
+    }
+    for (idx = 0; world_hdr->n_rooms > idx && PRELOAD_ROOMS > n_queued; 
+	 idx++) {
+	for (q_idx = 0; n_queued > q_idx; q_idx++) {
+	    if (queue[q_idx] == &cur->room[idx]) {
+		break;
+	    }
+	}
+	if (n_queued == q_idx) {
+	    queue[n_queued++] = use_room (&cur->room[idx]);
 	}
+    }
 
-	/* Read in the swap photo. */
-	swap_photo[which] = read_photo (swap_data[idx].filename);
-	if (NULL == swap_photo[which]) {
-	    fprintf (stderr, "Can't read room photo %s.\n", 
-	    	     swap_data[idx].filename);
+    /* List their photos, then the swap photos. */
+    for (idx = 0; n_queued > idx; idx++) {
+	order[idx] = queue[idx]->view;
+    }
+    for (n_order = n_queued, idx = 0; N_SWAPS > idx; idx++) {
+	order[n_order++] = cur->swap_photo[idx];
+    }
+
+    if (background) {
+	if (0 != start_photo_loader (order, n_order)) {
+	    fputs ("Can't start photo loader.\n", stderr);
+	    return 0;
+	}
+	return 1;
+    }
+    for (idx = 0; n_order > idx; idx++) {
+	if (!photo_is_loaded (order[idx]) && 0 != load_photo (order[idx])) {
+	    fputs ("Can't read room photo.\n", stderr);
 	    return 0;
 	}
     }
-
-    /* Everything worked! */
     return 1;
 }
 
@@ -994,7 +1702,299 @@ build_world ()
 room_t*
 start_in_room ()
 {
-    return &room[R_EAST_EVRT];
+    return &cur->room[world_hdr->start];
+}
+
+
+/* 
+ * save_game
+ *   DESCRIPTION: Save the state of the game to a file: the accomplishment
+ *                flags, the places of the objects, the swap photos shown,
+ *                the "enter" links of the puzzle rooms (which puzzles and
+ *                the inventory change), the player's room, and the state
+ *                kept by adventure.c.  The state is gathered into one 
+ *                block (see save_header_t) and written with one write to
+ *                a temporary file, which then replaces the file, so that
+ *                a failed save leaves the last saved game intact.
+ *   INPUTS: fname -- name of the file
+ *           where -- the player's room
+ *           view -- the state kept by adventure.c
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, or -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t
+save_game (const char* fname, const room_t* where, const game_view_t* view)
+{
+    static __thread uint8_t* buf = NULL; /* block written (per thread) */
+    save_header_t*  hdr;        /* its header                         */
+    save_object_t*  rec;        /* next object record                 */
+    char            tmp[256];   /* name of temporary file             */
+    size_t          len;        /* length of block                    */
+    int             fd;         /* temporary file descriptor          */
+    int32_t         idx;        /* index over rooms and objects       */
+    int32_t         slot;       /* index over room's objects          */
+    room_t*         r;          /* room examined                      */
+
+    /* Every object may need a record, so make space for them all once. */
+    if (NULL == buf && NULL == (buf = malloc (sizeof (save_header_t) + 
+    			world_hdr->n_objects * sizeof (save_object_t)))) {
+	return -1;
+    }
+    hdr = (save_header_t*)buf;
+    (void)memset (hdr, 0, sizeof (*hdr));
+    (void)memcpy (hdr->magic, SAVE_MAGIC, 4);
+    hdr->version = SAVE_VERSION;
+    hdr->n_rooms = world_hdr->n_rooms;
+    hdr->n_objects = world_hdr->n_objects;
+    hdr->strings_len = world_hdr->strings_len;
+    hdr->where = where - cur->room;
+    hdr->view = *view;
+    (void)memcpy (hdr->flags, cur->player_flags, sizeof (cur->player_flags));
+    for (idx = 0; N_SWAPS > idx; idx++) {
+	hdr->swapped[idx] = (NULL == cur->swapped_into[idx] ? WORLD_NONE : 
+			     cur->swapped_into[idx] - cur->room);
+    }
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	r = cur->known_room[idx]->enter;
+	hdr->enter[idx] = (NULL == r ? WORLD_NONE : r - cur->room);
+    }
+
+    /* Record the objects in rooms, then those in limbo. */
+    rec = (save_object_t*)(hdr + 1);
+    for (idx = 0; world_hdr->n_rooms > idx; idx++) {
+	r = &cur->room[idx];
+	for (slot = r->n_objs; 0 < slot--; rec++) {
+	    rec->obj = r->obj[slot] - cur->object;
+	    rec->room = idx;
+	    rec->x = r->obj_x[slot];
+	    rec->y = r->obj_y[slot];
+	}
+    }
+    for (idx = 0; world_hdr->n_objects > idx; idx++) {
+	if (NULL != cur->object[idx].name && NULL == cur->object[idx].loc) {
+	    rec->obj = idx;
+	    rec->room = WORLD_NONE;
+	    rec->x = rec->y = 0;
+	    rec++;
+	}
+    }
+    hdr->n_saved = rec - (save_object_t*)(hdr + 1);
+    len = (uint8_t*)rec - buf;
+
+    /* Write the block, and replace the file with it. */
+    if (sizeof (tmp) <= snprintf (tmp, sizeof (tmp), "%s.tmp", fname) ||
+	-1 == (fd = open (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644))) {
+	return -1;
+    }
+    if (len != write (fd, buf, len)) {
+	(void)close (fd);
+	(void)unlink (tmp);
+	return -1;
+    }
+    if (0 != close (fd) || 0 != rename (tmp, fname)) {
+	(void)unlink (tmp);
+	return -1;
+    }
+    return 0;
+}
+
+
+/* 
+ * saved_room_ok
+ *   DESCRIPTION: Check a room index read from a saved game.
+ *   INPUTS: idx -- the index
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the index is a room or WORLD_NONE, or 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+saved_room_ok (int32_t idx)
+{
+    return (WORLD_NONE == idx || (0 <= idx && world_hdr->n_rooms > idx));
+}
+
+
+/* 
+ * saved_game_ok
+ *   DESCRIPTION: Check that a saved game was saved with this world file, 
+ *                and that everything in it lies within the world, so that
+ *                it can be restored without failing part way.
+ *   INPUTS: buf -- the saved game
+ *           len -- its length
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the saved game can be restored, or 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+saved_game_ok (const uint8_t* buf, size_t len)
+{
+    const save_header_t* hdr = (const save_header_t*)buf; /* its header   */
+    const save_object_t* rec;    /* index over object records */
+    int32_t              idx;    /* index over saved rooms    */
+
+    if (sizeof (*hdr) > len || 0 != memcmp (hdr->magic, SAVE_MAGIC, 4) ||
+	SAVE_VERSION != hdr->version || 
+	world_hdr->n_rooms != hdr->n_rooms ||
+	world_hdr->n_objects != hdr->n_objects ||
+	world_hdr->strings_len != hdr->strings_len ||
+	world_hdr->n_objects < hdr->n_saved ||
+	sizeof (*hdr) + hdr->n_saved * sizeof (*rec) != len ||
+	WORLD_NONE == hdr->where || !saved_room_ok (hdr->where)) {
+	return 0;
+    }
+    for (idx = 0; N_SWAPS > idx; idx++) {
+	if (!saved_room_ok (hdr->swapped[idx])) {
+	    return 0;
+	}
+    }
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	if (!saved_room_ok (hdr->enter[idx])) {
+	    return 0;
+	}
+    }
+    for (rec = (const save_object_t*)(hdr + 1), idx = 0; 
+	 hdr->n_saved > idx; idx++, rec++) {
+	if (world_hdr->n_objects <= rec->obj || !saved_room_ok (rec->room)) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+
+/* 
+ * reset_objects
+ *   DESCRIPTION: Put every object that has been set up back where it 
+ *                starts (in limbo if its starting room has not been set
+ *                up).  Objects are placed in the same order as by 
+ *                use_room.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: objects placed at random are placed at new positions
+ */
+static void
+reset_objects ()
+{
+    const world_object_t* wo;  /* object in world file        */
+    room_t*               r;   /* its starting room           */
+    int32_t               idx; /* index over rooms, objects   */
+
+    for (idx = 0; world_hdr->n_rooms > idx; idx++) {
+	cur->room[idx].n_objs = 0;
+    }
+    for (idx = 0; world_hdr->n_objects > idx; idx++) {
+	cur->object[idx].loc = NULL;
+    }
+    for (idx = 0; world_hdr->n_objects > idx; idx++) {
+	wo = &world_obj[idx];
+	r = world_link (wo->room);
+	if (NULL == cur->object[idx].name || NULL == r || NULL == r->name) {
+	    continue;
+	}
+	if (WORLD_RANDOM != wo->x) {
+	    insert_object_at (&cur->object[idx], r, wo->x, wo->y);
+	} else {
+	    insert_object (&cur->object[idx], r);
+	}
+    }
+}
+
+
+/* 
+ * restore_game
+ *   DESCRIPTION: Restore the state of the game from a file written by
+ *                save_game.  The file is read with one read and checked
+ *                completely before anything is changed.  Only the rooms 
+ *                and objects named by the saved game are set up, and no 
+ *                photos are loaded (the rooms whose photos change are
+ *                drawn afresh, as the player enters them).
+ *   INPUTS: fname -- name of the file
+ *   OUTPUTS: view -- the state kept by adventure.c
+ *   RETURN VALUE: the player's room, or NULL on failure
+ *   SIDE EFFECTS: moves objects, changes flags and room links
+ */
+room_t*
+restore_game (const char* fname, game_view_t* view)
+{
+    static __thread uint8_t* buf = NULL; /* block read (per thread)    */
+    static __thread size_t   buf_len = 0; /* its size                  */
+    const save_header_t* hdr;         /* its header                     */
+    const save_object_t* rec;         /* object records                 */
+    struct stat          st;          /* saved game file status         */
+    int                  fd;          /* saved game file descriptor     */
+    ssize_t              got;         /* bytes read                     */
+    uint32_t             idx;         /* index over records, rooms      */
+    room_t*              r;           /* room examined                  */
+
+    /* Read the saved game, and check it. */
+    if (-1 == (fd = open (fname, O_RDONLY))) {
+	return NULL;
+    }
+    if (0 != fstat (fd, &st) || sizeof (*hdr) > st.st_size ||
+	sizeof (*hdr) + world_hdr->n_objects * sizeof (*rec) < st.st_size) {
+	(void)close (fd);
+	return NULL;
+    }
+    if (buf_len < st.st_size) {
+	free (buf);
+	if (NULL == (buf = malloc (st.st_size))) {
+	    buf_len = 0;
+	    (void)close (fd);
+	    return NULL;
+	}
+	buf_len = st.st_size;
+    }
+    got = read (fd, buf, st.st_size);
+    (void)close (fd);
+    if (st.st_size != got || !saved_game_ok (buf, got)) {
+	return NULL;
+    }
+    hdr = (const save_header_t*)buf;
+    rec = (const save_object_t*)(hdr + 1);
+
+    /* 
+     * Set up the rooms and objects named, and the rooms in which the 
+     * objects start, and put every object back where it starts.  Setting
+     * up a room places the objects that start there, so if a saved 
+     * object's starting room were set up only when first entered, it 
+     * would take the object back from wherever it was restored.  Then
+     * place the objects saved.
+     */
+    (void)use_room (&cur->room[hdr->where]);
+    for (idx = 0; hdr->n_saved > idx; idx++) {
+	(void)use_object (&cur->object[rec[idx].obj]);
+	(void)use_room (world_link (rec[idx].room));
+	(void)use_room (world_link (world_obj[rec[idx].obj].room));
+    }
+    reset_objects ();
+    for (idx = 0; hdr->n_saved > idx; idx++) {
+	if (WORLD_NONE == rec[idx].room) {
+	    remove_object (&cur->object[rec[idx].obj]);
+	} else {
+	    insert_object_at (&cur->object[rec[idx].obj], 
+			      &cur->room[rec[idx].room], rec[idx].x, rec[idx].y);
+	}
+    }
+
+    /* Restore the flags, swap photos, and links. */
+    (void)memcpy (cur->player_flags, hdr->flags, sizeof (cur->player_flags));
+    for (idx = 0; N_SWAPS > idx; idx++) {
+	if (NULL != cur->swapped_into[idx]) {
+	    do_photo_swap (cur->swapped_into[idx], idx);
+	}
+	if (WORLD_NONE != hdr->swapped[idx]) {
+	    do_photo_swap (use_room (&cur->room[hdr->swapped[idx]]), idx);
+	}
+    }
+    for (idx = 0; N_KNOWN_ROOMS > idx; idx++) {
+	r = cur->known_room[idx];
+	r->enter = use_room (world_link (hdr->enter[idx]));
+    }
+
+    *view = hdr->view;
+    return &cur->room[hdr->where];
 }
 
 
@@ -1009,7 +2009,7 @@ start_in_room ()
 int32_t
 player_has_board ()
 {
-    return (&room[R_INVENTORY] == object[0].loc);
+    return (cur->known_room[R_INVENTORY] == cur->known_obj[O_BOARD]->loc);
 }
 
 
@@ -1024,7 +2024,7 @@ player_has_board ()
 int32_t
 player_has_jetpack ()
 {
-    return (&room[R_INVENTORY] == object[1].loc);
+    return (cur->known_room[R_INVENTORY] == cur->known_obj[O_JETPACK]->loc);
 }
 
 
@@ -1046,16 +2046,16 @@ try_to_move_left (room_t** rptr)
 
     /* If room exists, move into it. */
     if (NULL != r->left) {
-        *rptr = r->left;
+        *rptr = use_room (r->left);
 
 	/* When entering the Boneyard Circle, choose picture randomly. */
-	if (&room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
+	if (cur->known_room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
 	    do_photo_swap (*rptr, SWAP_CIRCLE);
 	}
 	return TC_CHANGE_ROOM;
     }
 
-    if (&room[0] == r) {
+    if (cur->known_room[R_INVENTORY] == r) {
 	/* Give a hint as to how to get out of inventory. */
         show_status ("Push 'home' or type 'inventory'.");
     } else {
@@ -1084,10 +2084,10 @@ try_to_enter (room_t** rptr)
 
     /* If room exists, move into it. */
     if (NULL != r->enter) {
-        *rptr = r->enter;
+        *rptr = use_room (r->enter);
 
 	/* When entering the Boneyard Circle, choose picture randomly. */
-	if (&room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
+	if (cur->known_room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
 	    do_photo_swap (*rptr, SWAP_CIRCLE);
 	}
 	return TC_CHANGE_ROOM;
@@ -1098,46 +2098,46 @@ try_to_enter (room_t** rptr)
      * conditions are met, and give hints when the conditions are 
      * not met. 
      */
-    if (&room[R_BY_CLEANR] == r) {
+    if (cur->known_room[R_BY_CLEANR] == r) {
 	if (player_flag_is_set (FLAG_WEARING_SUIT)) {
-	    *rptr = &room[R_IN_CLEANR];
+	    *rptr = cur->known_room[R_IN_CLEANR];
 	    return TC_CHANGE_ROOM;
 	}
 	show_status ("You're not wearing a bunnysuit!");
 	return TC_ALLOW_EDIT;
     }
-    if (&room[R_BY_395LAB] == r) {
-	if (object[O_ICARD].loc == &room[R_INVENTORY]) {
+    if (cur->known_room[R_BY_395LAB] == r) {
+	if (cur->known_obj[O_ICARD]->loc == cur->known_room[R_INVENTORY]) {
 	    show_status ("You swiped your Icard.");
-	    *rptr = &room[R_IN_395LAB];
+	    *rptr = cur->known_room[R_IN_395LAB];
 	    return TC_CHANGE_ROOM;
 	}
 	show_status ("You need a valid Icard.");
 	return TC_ALLOW_EDIT;
     }
-    if (&room[R_CSL_DOOR] == r) {
-	if (object[O_ICARD].loc == &room[R_INVENTORY]) {
+    if (cur->known_room[R_CSL_DOOR] == r) {
+	if (cur->known_obj[O_ICARD]->loc == cur->known_room[R_INVENTORY]) {
 	    show_status ("You swiped your Icard.");
-	    *rptr = &room[R_CSL_LOBBY];
+	    *rptr = cur->known_room[R_CSL_LOBBY];
 	    return TC_CHANGE_ROOM;
 	}
 	show_status ("You need a valid Icard.");
 	return TC_ALLOW_EDIT;
     }
-    if (&room[R_BECK_DOOR] == r) {
-	if (object[O_ROBOT_LIVE].loc == &room[R_INVENTORY]) {
+    if (cur->known_room[R_BECK_DOOR] == r) {
+	if (cur->known_obj[O_ROBOT_LIVE]->loc == cur->known_room[R_INVENTORY]) {
 	    show_status ("The robot hand picked the lock!");
-	    *rptr = &room[R_BECKLOBBY];
+	    *rptr = cur->known_room[R_BECKLOBBY];
 	    return TC_CHANGE_ROOM;
 	}
-	if (object[O_ROBOT_DEAD].loc == &room[R_INVENTORY]) {
+	if (cur->known_obj[O_ROBOT_DEAD]->loc == cur->known_room[R_INVENTORY]) {
 	    show_status ("Flash the robot's code again.");
 	    return TC_ALLOW_EDIT;
 	}
 	show_status ("Complex lock!  Find a nanotech robot.");
 	return TC_ALLOW_EDIT;
     }
-    if (&room[R_MNTL_LAB1] == r) {
+    if (cur->known_room[R_MNTL_LAB1] == r) {
         /* Get advice from Kevin. */
 	static const char* const advice[8] = {
 	    "Kevin says, \"Andres' board is FAST!\"",
@@ -1152,7 +2152,7 @@ try_to_enter (room_t** rptr)
 	show_status (advice[(rand () % 8)]);
 	return TC_ALLOW_EDIT;
     }
-    if (&room[R_COCKPIT] == r) {
+    if (cur->known_room[R_COCKPIT] == r) {
         show_status ("A MIMO transmitter card is missing!");
 	return TC_ALLOW_EDIT;
     }
@@ -1181,16 +2181,16 @@ try_to_move_right (room_t** rptr)
 
     /* If room exists, move into it. */
     if (NULL != r->right) {
-        *rptr = r->right;
+        *rptr = use_room (r->right);
 
 	/* When entering the Boneyard Circle, choose picture randomly. */
-	if (&room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
+	if (cur->known_room[R_CIRCLE_N] == *rptr && 0 == (rand () % 2)) {
 	    do_photo_swap (*rptr, SWAP_CIRCLE);
 	}
 	return TC_CHANGE_ROOM;
     }
 
-    if (&room[0] == r) {
+    if (cur->known_room[R_INVENTORY] == r) {
 	/* Give a hint as to how to get out of inventory. */
         show_status ("Push 'home' or type 'inventory'.");
     } else {
@@ -1215,34 +2215,36 @@ try_to_move_right (room_t** rptr)
 tc_action_t
 typed_cmd_buy (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Buy a Dew! */
-    if (0 == strcasecmp ("dew", arg)) {
-        if (&room[R_EVRT_VEND] != r) {
+    if (W_DEW == sym) {
+        if (cur->known_room[R_EVRT_VEND] != r) {
 	    show_status ("Great idea!  But ... where?");
 	    return TC_DISCARD_TEXT;
 	} 
-	if (object[O_MTN_DEW].loc == &room[R_INVENTORY] ||
-	    object[O_MTN_DEW].loc == r) {
+	if (cur->known_obj[O_MTN_DEW]->loc == cur->known_room[R_INVENTORY] ||
+	    cur->known_obj[O_MTN_DEW]->loc == r) {
 	    show_status ("Slow down!  One at a time...");
 	    return TC_DISCARD_TEXT;
 	} 
-	if (NULL != object[O_MTN_DEW].loc) {
+	if (NULL != cur->known_obj[O_MTN_DEW]->loc) {
 	    show_status ("Last one get stolen?  Ok...here we go...");
 	} else {
 	    show_status ("You buy a Dew.");
 	}
-	move_object_to_inventory (&object[O_MTN_DEW]);
+	move_object_to_inventory (cur->known_obj[O_MTN_DEW]);
 	return TC_REDRAW_ROOM;
     }
 
     /* Buy some yogurt. */
-    if (0 == strcasecmp ("yogurt", arg)) {
-        if (&room[R_IN_COCOMR] != r) {
+    if (W_YOGURT == sym) {
+        if (cur->known_room[R_IN_COCOMR] != r) {
 	    show_status ("Cocomero doesn't deliver here.");
 	} else if (player_flag_is_set (FLAG_HAS_EATEN)) {
 	    show_status ("You're not hungry.");
@@ -1271,34 +2273,36 @@ typed_cmd_buy (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_charge (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Only the battery can be charged. */
-    if (0 != strcasecmp ("battery", arg)) {
+    if (W_BATTERY != sym) {
         show_status ("Electronic devices aren't (always) toys!");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_BATT_EMPTY].loc != &room[R_INVENTORY] &&
-	object[O_BATT_EMPTY].loc != r &&
-	object[O_BATT_FULL].loc != &room[R_INVENTORY] &&
-	object[O_BATT_FULL].loc != r) {
+    if (cur->known_obj[O_BATT_EMPTY]->loc != cur->known_room[R_INVENTORY] &&
+	cur->known_obj[O_BATT_EMPTY]->loc != r &&
+	cur->known_obj[O_BATT_FULL]->loc != cur->known_room[R_INVENTORY] &&
+	cur->known_obj[O_BATT_FULL]->loc != r) {
 	show_status ("What battery?");
 	return TC_DISCARD_TEXT;
     }
-    if (&room[R_BECK_MRI] != r) {
+    if (cur->known_room[R_BECK_MRI] != r) {
 	show_status ("Find a bigger magnet.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_BATT_FULL].loc == &room[R_INVENTORY] ||
-	object[O_BATT_FULL].loc == r) {
+    if (cur->known_obj[O_BATT_FULL]->loc == cur->known_room[R_INVENTORY] ||
+	cur->known_obj[O_BATT_FULL]->loc == r) {
 	show_status ("Don't overdo it.");
 	return TC_DISCARD_TEXT;
     }
-    remove_object (&object[O_BATT_EMPTY]);
-    move_object_to_inventory (&object[O_BATT_FULL]);
+    remove_object (cur->known_obj[O_BATT_EMPTY]);
+    move_object_to_inventory (cur->known_obj[O_BATT_FULL]);
     show_status ("Wow!  That's a strong magnet!");
     return TC_REDRAW_ROOM;
 }
@@ -1316,29 +2320,31 @@ typed_cmd_charge (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_do (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
-    if (&room[R_IN_391LAB] != r) {
+    if (cur->known_room[R_IN_391LAB] != r) {
         show_status ("You can't 'do' anything here.");
 	return TC_ALLOW_EDIT;
     }
-    if (0 != strcasecmp ("391", arg) &&
-	0 != strcasecmp ("mp2", arg)) {
+    if (W_391 != sym &&
+	W_MP2 != sym) {
         show_status ("Doing the 391 MP2 is more important!");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_BOOK_C].loc != &room[R_INVENTORY]) {
+    if (cur->known_obj[O_BOOK_C]->loc != cur->known_room[R_INVENTORY]) {
         show_status ("You'd better get a book from Grainger.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_MP2].loc != &room[R_INVENTORY]) {
+    if (cur->known_obj[O_MP2]->loc != cur->known_room[R_INVENTORY]) {
         show_status ("Web's down.  Bring your own MP2.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_TUX].loc != &room[R_IN_391LAB]) {
+    if (cur->known_obj[O_TUX]->loc != cur->known_room[R_IN_391LAB]) {
         show_status ("You'd have better luck if Tux were here.");
 	return TC_DISCARD_TEXT;
     }
@@ -1362,22 +2368,24 @@ typed_cmd_do (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_drink (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* All you can drink is Dew... */
-    if (0 != strcasecmp ("dew", arg)) {
+    if (W_DEW != sym) {
         show_status ("That sounds less refreshing than Dew.");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_MTN_DEW].loc != &room[R_INVENTORY] &&
-        object[O_MTN_DEW].loc != r) {
+    if (cur->known_obj[O_MTN_DEW]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_MTN_DEW]->loc != r) {
         show_status ("Uh-oh.  Hadewcinations.  Buy one soon!");
 	return TC_DISCARD_TEXT;
     }
-    remove_object (&object[O_MTN_DEW]);
+    remove_object (cur->known_obj[O_MTN_DEW]);
     show_status ("Ahhhhhhhhhhhhhhhh...........nother?");
     /* NOT a bug.  Sorry, Dew doesn't count as a food. */
     return TC_REDRAW_ROOM;
@@ -1401,12 +2409,14 @@ typed_cmd_drop (room_t** rptr, const char* arg)
     room_t*   r;	/* current room                        */
     object_t* obj;      /* object being dropped                */
     room_t*   dest;	/* destination room for dropped object */
+    int32_t   sym;	/* interned name from argument         */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Search for object to drop--it must be in the player's inventory. */
-    obj = find_in_room (&room[R_INVENTORY], arg);
+    obj = find_in_room (cur->known_room[R_INVENTORY], sym);
 
     /* No luck--say so. */
     if (NULL == obj) {
@@ -1418,8 +2428,10 @@ typed_cmd_drop (room_t** rptr, const char* arg)
      * Issue a warning to player if they seem to be trying to make use
      * of certain objects (as a hint).
      */
-    if ((&object[O_BATT_FULL] == obj && &room[R_CAR_SITE] == r) ||
-	(&object[O_MIMO_CARD] == obj && &room[R_REM_PLANE] == r)) {
+    if ((cur->known_obj[O_BATT_FULL] == obj && 
+	 cur->known_room[R_CAR_SITE] == r) ||
+	(cur->known_obj[O_MIMO_CARD] == obj && 
+	 cur->known_room[R_REM_PLANE] == r)) {
         show_status ("You may want to install it instead.");
     }
 
@@ -1427,7 +2439,8 @@ typed_cmd_drop (room_t** rptr, const char* arg)
      * If player is looking at inventory, object goes into the room in 
      * which they're standing.
      */
-    dest = (&room[R_INVENTORY] == r ? room[R_INVENTORY].enter : r);
+    dest = (cur->known_room[R_INVENTORY] == r ? 
+	    cur->known_room[R_INVENTORY]->enter : r);
     insert_object (obj, dest);
     return TC_REDRAW_ROOM;
 }
@@ -1446,38 +2459,40 @@ typed_cmd_drop (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_fix (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Only the GPS can be fixed. */
-    if (0 != strcasecmp ("gps", arg)) {
+    if (W_GPS != sym) {
         show_status ("In the game, you're not as capable.");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_GPS_GOOD].loc == &room[R_INVENTORY] ||
-        object[O_GPS_GOOD].loc == r) {
+    if (cur->known_obj[O_GPS_GOOD]->loc == cur->known_room[R_INVENTORY] ||
+        cur->known_obj[O_GPS_GOOD]->loc == r) {
         show_status ("It's working fine.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_GPS_BAD].loc != &room[R_INVENTORY] &&
-        object[O_GPS_BAD].loc != r) {
+    if (cur->known_obj[O_GPS_BAD]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_GPS_BAD]->loc != r) {
         show_status ("Do you have a GPS?");
 	return TC_DISCARD_TEXT;
     }
-    if (&room[R_IN_CLEANR] != r) {
+    if (cur->known_room[R_IN_CLEANR] != r) {
         show_status ("You'd better go to the cleanroom.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_GPS_SPEC].loc != &room[R_INVENTORY] &&
-        object[O_GPS_SPEC].loc != r) {
+    if (cur->known_obj[O_GPS_SPEC]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_GPS_SPEC]->loc != r) {
         show_status ("Maybe you'd better get a spec?");
 	return TC_DISCARD_TEXT;
     }
-    remove_object (&object[O_GPS_BAD]);
-    remove_object (&object[O_GPS_SPEC]);
-    move_object_to_inventory (&object[O_GPS_GOOD]);
+    remove_object (cur->known_obj[O_GPS_BAD]);
+    remove_object (cur->known_obj[O_GPS_SPEC]);
+    move_object_to_inventory (cur->known_obj[O_GPS_GOOD]);
     show_status ("All done--wow, you're good!");
     return TC_CHANGE_ROOM;
 }
@@ -1496,34 +2511,36 @@ typed_cmd_fix (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_flash (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Only the robot can be flashed. */
-    if (0 != strcasecmp ("robot", arg)) {
+    if (W_ROBOT != sym) {
         show_status ("Don't waste your time.");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_ROBOT_DEAD].loc != &room[R_INVENTORY] &&
-        object[O_ROBOT_DEAD].loc != r &&
-	object[O_ROBOT_LIVE].loc != &room[R_INVENTORY] &&
-        object[O_ROBOT_LIVE].loc != r) {
+    if (cur->known_obj[O_ROBOT_DEAD]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_ROBOT_DEAD]->loc != r &&
+	cur->known_obj[O_ROBOT_LIVE]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_ROBOT_LIVE]->loc != r) {
         show_status ("Maybe get the robot first?");
 	return TC_DISCARD_TEXT;
     }
-    if (&room[R_IN_395LAB] != r) {
+    if (cur->known_room[R_IN_395LAB] != r) {
         show_status ("With spit and a lemon?  Try the lab.");
 	return TC_DISCARD_TEXT;
     }
-    if (object[O_ROBOT_LIVE].loc == &room[R_INVENTORY] ||
-        object[O_ROBOT_LIVE].loc == r) {
+    if (cur->known_obj[O_ROBOT_LIVE]->loc == cur->known_room[R_INVENTORY] ||
+        cur->known_obj[O_ROBOT_LIVE]->loc == r) {
         show_status ("You flash the robot's ROM again.");
 	return TC_DISCARD_TEXT;
     }
-    remove_object (&object[O_ROBOT_DEAD]);
-    move_object_to_inventory (&object[O_ROBOT_LIVE]);
+    remove_object (cur->known_obj[O_ROBOT_DEAD]);
+    move_object_to_inventory (cur->known_obj[O_ROBOT_LIVE]);
     show_status ("You flash it with a lockpicking code.");
     return TC_REDRAW_ROOM;
 }
@@ -1545,19 +2562,22 @@ typed_cmd_get (room_t** rptr, const char* arg)
     room_t*   r;	/* current room                  */
     room_t*   src;	/* source room for object search */
     object_t* obj;	/* object being sought           */
+    int32_t   sym;	/* interned name from argument   */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* 
      * If player is looking at inventory, source room for object search 
      * is the room in which they're standing.
      */
-    src = (&room[R_INVENTORY] == r ? room[R_INVENTORY].enter : r);
+    src = (cur->known_room[R_INVENTORY] == r ? 
+	   cur->known_room[R_INVENTORY]->enter : r);
 
     /* Try a special effect search followed by a normal search. */
-    if (NULL == (obj = obj_special_get (src, arg))) {
-	obj = find_in_room (src, arg);
+    if (NULL == (obj = obj_special_get (src, sym))) {
+	obj = find_in_room (src, sym);
     } 
     if (NULL == obj) {
 	show_status ("You see no such thing here.");
@@ -1565,7 +2585,7 @@ typed_cmd_get (room_t** rptr, const char* arg)
     }
 
     /* The player can't grab Tux! */
-    if (&object[O_TUX] == obj && !player_flag_is_set (FLAG_LURED_TUX)) {
+    if (cur->known_obj[O_TUX] == obj && !player_flag_is_set (FLAG_LURED_TUX)) {
         show_status ("Tux must choose you!  Try using a fish.");
 	return TC_DISCARD_TEXT;
     }
@@ -1576,10 +2596,82 @@ typed_cmd_get (room_t** rptr, const char* arg)
 }
 
 
+/* 
+ * walk_distance
+ *   DESCRIPTION: Count the rooms walked on a shortest path between two 
+ *                rooms in the session.  The table of paths shared by the
+ *                sessions follows the links in the world file, so the 
+ *                "enter" links that the session's puzzles have opened 
+ *                (the cockpit's) are added here: a path may walk over
+ *                file links from one opened link to the next, so the 
+ *                steps to the far end of each opened link are relaxed
+ *                once per opened link, as in the Bellman-Ford algorithm.
+ *                Puzzles only ever open links, never close them.
+ *   INPUTS: from -- the room in which the path starts
+ *           to -- the destination
+ *   OUTPUTS: none
+ *   RETURN VALUE: the number of rooms walked, or -1 if no path exists
+ *   SIDE EFFECTS: none
+ */
+static int32_t
+walk_distance (int32_t from, int32_t to)
+{
+    int32_t dist = travel_distance (from, to); /* steps over file links */
+    int32_t src[N_KNOWN_ROOMS];	  /* room with each link opened    */
+    int32_t dst[N_KNOWN_ROOMS];	  /* room reached by each link     */
+    int32_t reach[N_KNOWN_ROOMS]; /* steps to dst, or -1           */
+    int32_t n_open;	/* number of links opened                   */
+    int32_t idx;	/* index over puzzle rooms and opened links */
+    int32_t jdx;	/* index over opened links                  */
+    int32_t pass;	/* relaxation pass                          */
+    int32_t d;		/* steps over file links                    */
+
+    /* Find the opened links, and the steps to each over file links. */
+    for (idx = n_open = 0; N_KNOWN_ROOMS > idx; idx++) {
+	src[n_open] = cur->known_room[idx] - cur->room;
+	if (R_INVENTORY == idx || NULL == cur->room[src[n_open]].enter ||
+	    world_room[src[n_open]].enter == 
+	    cur->room[src[n_open]].enter - cur->room) {
+	    continue;
+	}
+	dst[n_open] = cur->room[src[n_open]].enter - cur->room;
+	if (0 <= (reach[n_open] = travel_distance (from, src[n_open]))) {
+	    reach[n_open]++;
+	}
+	n_open++;
+    }
+
+    /* Allow paths through the other opened links on the way. */
+    for (pass = 1; n_open > pass; pass++) {
+	for (idx = 0; n_open > idx; idx++) {
+	    for (jdx = 0; n_open > jdx; jdx++) {
+		if (idx != jdx && 0 <= reach[jdx] &&
+		    0 <= (d = travel_distance (dst[jdx], src[idx])) &&
+		    (0 > reach[idx] || reach[jdx] + d + 1 < reach[idx])) {
+		    reach[idx] = reach[jdx] + d + 1;
+		}
+	    }
+	}
+    }
+
+    /* Finish from the far end of the last opened link used, if any. */
+    for (idx = 0; n_open > idx; idx++) {
+	if (0 <= reach[idx] && 
+	    0 <= (d = travel_distance (dst[idx], to)) &&
+	    (0 > dist || reach[idx] + d < dist)) {
+	    dist = reach[idx] + d;
+	}
+    }
+    return dist;
+}
+
+
 /* 
  * typed_cmd_go
  *   DESCRIPTION: Execute the typed command "go," which allows the player
- *                to go from one place to another using room features.
+ *                to go from one place to another using room features,
+ *                or to walk to the nearest room with a given name by a
+ *                shortest path.
  *   INPUTS: *rptr -- player's current room
  *           arg -- name of location to which to go
  *   OUTPUTS: *rptr -- possibly new room for player
@@ -1589,18 +2681,27 @@ typed_cmd_get (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_go (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
-
-    /* Set current room. */
+    room_t* r;		/* current room                   */
+    int32_t sym;	/* interned name from argument    */
+    int32_t from;	/* room from which player walks   */
+    int32_t dest;	/* index over rooms with the name */
+    int32_t dist;	/* steps to a room with the name  */
+    int32_t best;	/* nearest room with the name     */
+    int32_t best_dist;	/* steps to nearest room          */
+    char    msg[48];	/* status message                 */
+
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Try to go to Allerton Mansion. */
-    if (0 == strcasecmp ("allerton", arg)) {
-        if (&room[R_ALLERTON] == r) {
+    if (W_ALLERTON == sym) {
+        if (cur->known_room[R_ALLERTON] == r) {
 	    show_status ("Kazam!  You're at Allerton!");
 	    return TC_DISCARD_TEXT;
 	}
-        if (&room[R_WILLARD] != r && &room[R_CAR_SITE] != r) {
+        if (cur->known_room[R_WILLARD] != r && 
+	    cur->known_room[R_CAR_SITE] != r) {
 	    show_status ("That's quite a hike.");
 	    return TC_DISCARD_TEXT;
 	}
@@ -1612,8 +2713,8 @@ typed_cmd_go (room_t** rptr, const char* arg)
 	    }
 	    return TC_DISCARD_TEXT;
 	}
-	if (object[O_GPS_GOOD].loc != &room[R_INVENTORY]) {
-	    if (object[O_GPS_BAD].loc == &room[R_INVENTORY]) {
+	if (cur->known_obj[O_GPS_GOOD]->loc != cur->known_room[R_INVENTORY]) {
+	    if (cur->known_obj[O_GPS_BAD]->loc == cur->known_room[R_INVENTORY]) {
 	        show_status ("That's a long road with a broken GPS.");
 	    } else {
 	        show_status ("You'll need a GPS to find that place.");
@@ -1621,18 +2722,19 @@ typed_cmd_go (room_t** rptr, const char* arg)
 	    return TC_DISCARD_TEXT;
 	}
 	show_status ("You drive to Allerton Park.");
-	*rptr = &room[R_ALLERTON];
+	*rptr = cur->known_room[R_ALLERTON];
 	return TC_CHANGE_ROOM;
     }
 
     /* Try to go to Willard Airport. */
-    if (0 == strcasecmp ("willard", arg) ||
-	0 == strcasecmp ("airport", arg)) {
-        if (&room[R_WILLARD] == r) {
+    if (W_WILLARD == sym ||
+	W_AIRPORT == sym) {
+        if (cur->known_room[R_WILLARD] == r) {
 	    show_status ("Kazap!  You're at Willard!");
 	    return TC_DISCARD_TEXT;
 	}
-        if (&room[R_ALLERTON] != r && &room[R_CAR_SITE] != r) {
+        if (cur->known_room[R_ALLERTON] != r && 
+	    cur->known_room[R_CAR_SITE] != r) {
 	    show_status ("That's quite a hike.");
 	    return TC_DISCARD_TEXT;
 	}
@@ -1645,22 +2747,54 @@ typed_cmd_go (room_t** rptr, const char* arg)
 	    return TC_DISCARD_TEXT;
 	}
 	show_status ("You drive to Willard Airport.");
-	*rptr = &room[R_WILLARD];
+	*rptr = cur->known_room[R_WILLARD];
 	return TC_CHANGE_ROOM;
     }
 
     /* Try to go to campus. */
-    if (0 == strcasecmp ("campus", arg)) {
-        if (&room[R_CAR_SITE] == r) {
+    if (W_CAMPUS == sym) {
+        if (cur->known_room[R_CAR_SITE] == r) {
 	    show_status ("Kazar!  You're on campus!");
 	    return TC_DISCARD_TEXT;
 	}
-        if (&room[R_ALLERTON] != r && &room[R_WILLARD] != r) {
+        if (cur->known_room[R_ALLERTON] != r && 
+	    cur->known_room[R_WILLARD] != r) {
 	    show_status ("That's quite a hike.");
 	    return TC_DISCARD_TEXT;
 	}
 	show_status ("You drive back to campus.");
-	*rptr = &room[R_CAR_SITE];
+	*rptr = cur->known_room[R_CAR_SITE];
+	return TC_CHANGE_ROOM;
+    }
+
+    /* 
+     * Walk to the nearest room with the name given (from the inventory,
+     * start in the room in which the player is standing).
+     */
+    if (SYM_NONE != sym && n_room_names > sym && 
+	TRAVEL_NONE != first_room_named[sym]) {
+	from = (cur->known_room[R_INVENTORY] == r ? r->enter : r) - cur->room;
+	best = best_dist = -1;
+	for (dest = first_room_named[sym]; TRAVEL_NONE != dest; 
+	     dest = next_room_named[dest]) {
+	    dist = walk_distance (from, dest);
+	    if (0 <= dist && (0 > best_dist || best_dist > dist)) {
+		best = dest;
+		best_dist = dist;
+	    }
+	}
+	if (0 > best) {
+	    show_status ("You can't find the way there.");
+	    return TC_DISCARD_TEXT;
+	}
+	if (0 == best_dist) {
+	    show_status ("You're already there.");
+	    return TC_DISCARD_TEXT;
+	}
+	(void)snprintf (msg, sizeof (msg), "You walk %d room%s.", 
+			best_dist, (1 == best_dist ? "" : "s"));
+	show_status (msg);
+	*rptr = use_room (&cur->room[best]);
 	return TC_CHANGE_ROOM;
     }
 
@@ -1683,30 +2817,32 @@ typed_cmd_go (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_install (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Try to install a battery. */
-    if (0 == strcasecmp ("battery", arg)) {
-	if (object[O_BATT_EMPTY].loc != &room[R_INVENTORY] &&
-	    object[O_BATT_EMPTY].loc != r &&
-	    object[O_BATT_FULL].loc != &room[R_INVENTORY] &&
-	    object[O_BATT_FULL].loc != r) {
+    if (W_BATTERY == sym) {
+	if (cur->known_obj[O_BATT_EMPTY]->loc != cur->known_room[R_INVENTORY] &&
+	    cur->known_obj[O_BATT_EMPTY]->loc != r &&
+	    cur->known_obj[O_BATT_FULL]->loc != cur->known_room[R_INVENTORY] &&
+	    cur->known_obj[O_BATT_FULL]->loc != r) {
 	    show_status ("What battery?");
 	    return TC_DISCARD_TEXT;
 	}
-	if (&room[R_CAR_SITE] != r) {
+	if (cur->known_room[R_CAR_SITE] != r) {
 	    show_status ("Do you see the car?");
 	    return TC_DISCARD_TEXT;
 	}
-	if (object[O_BATT_EMPTY].loc == &room[R_INVENTORY] ||
-	    object[O_BATT_EMPTY].loc == r) {
+	if (cur->known_obj[O_BATT_EMPTY]->loc == cur->known_room[R_INVENTORY] ||
+	    cur->known_obj[O_BATT_EMPTY]->loc == r) {
 	    show_status ("You want to install a dead battery?");
 	    return TC_DISCARD_TEXT;
         }
-	remove_object (&object[O_BATT_FULL]);
+	remove_object (cur->known_obj[O_BATT_FULL]);
 	player_set_flag (FLAG_CAR_FIXED);
 	do_photo_swap (r, SWAP_CAR);
 	show_status ("Nice work!  Now you can use it!");
@@ -1714,19 +2850,19 @@ typed_cmd_install (room_t** rptr, const char* arg)
     }
 
     /* Try to install a MIMO transmitter card. */
-    if (0 == strcasecmp ("mimo", arg) || 0 == strcasecmp ("card", arg) ||
-	0 == strcasecmp ("transmitter", arg)) {
-	if (object[O_MIMO_CARD].loc != &room[R_INVENTORY] &&
-	    object[O_MIMO_CARD].loc != r) {
+    if (W_MIMO == sym || W_CARD == sym ||
+	W_TRANSMITTER == sym) {
+	if (cur->known_obj[O_MIMO_CARD]->loc != cur->known_room[R_INVENTORY] &&
+	    cur->known_obj[O_MIMO_CARD]->loc != r) {
 	    show_status ("Do you have one of those?");
 	    return TC_DISCARD_TEXT;
 	}
-	if (&room[R_COCKPIT] != r) {
+	if (cur->known_room[R_COCKPIT] != r) {
 	    show_status ("Nothing here needs that.");
 	    return TC_DISCARD_TEXT;
 	}
-	remove_object (&object[O_MIMO_CARD]);
-	room[R_COCKPIT].enter = &room[R_OVER_WILL];
+	remove_object (cur->known_obj[O_MIMO_CARD]);
+	cur->known_room[R_COCKPIT]->enter = cur->known_room[R_OVER_WILL];
 	show_status ("Ready for takeoff, captain!");
 	return TC_REDRAW_ROOM;
     }
@@ -1762,13 +2898,13 @@ typed_cmd_inventory (room_t** rptr, const char* arg)
     /* Set current room. */
     r = *rptr;
 
-    if (&room[R_INVENTORY] == r) {
+    if (cur->known_room[R_INVENTORY] == r) {
 	/* Return from inventory to previous room. */
 	*rptr = r->enter;
     } else {
 	/* Record current room and enter inventory view. */
-	room[R_INVENTORY].enter = r;
-	*rptr = &room[R_INVENTORY];
+	cur->known_room[R_INVENTORY]->enter = r;
+	*rptr = cur->known_room[R_INVENTORY];
     }
     return TC_CHANGE_ROOM;
 }
@@ -1793,7 +2929,7 @@ typed_cmd_sigh (room_t** rptr, const char* arg)
 
     /* Set current room. */
     r = *rptr;
-    if (&room[R_BY_ZAS] != r) {
+    if (cur->known_room[R_BY_ZAS] != r) {
         show_status ("MP2 got you down?  Take a break!");
     } else {
 	show_status ("So sad... you lose your appetite.");
@@ -1816,22 +2952,24 @@ typed_cmd_sigh (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_use (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Try to use a car. */
-    if (0 == strcasecmp ("car", arg)) {
-    	if (&room[R_ALLERTON] == r) {
+    if (W_CAR == sym) {
+    	if (cur->known_room[R_ALLERTON] == r) {
 	    show_status ("Go to campus or Willard Airport?");
 	    return TC_DISCARD_TEXT;
 	}
-    	if (&room[R_WILLARD] == r) {
+    	if (cur->known_room[R_WILLARD] == r) {
 	    show_status ("Go to Allerton or campus?");
 	    return TC_DISCARD_TEXT;
 	}
-	if (&room[R_CAR_SITE] != r) {
+	if (cur->known_room[R_CAR_SITE] != r) {
 	    show_status ("You have a car?");
 	    return TC_DISCARD_TEXT;
 	}
@@ -1843,31 +2981,31 @@ typed_cmd_use (room_t** rptr, const char* arg)
 	    show_status ("You'll have to charge the battery.");
 	    return TC_DISCARD_TEXT;
 	}
-	if (object[O_CAR_KEY].loc != &room[R_INVENTORY]) {
+	if (cur->known_obj[O_CAR_KEY]->loc != cur->known_room[R_INVENTORY]) {
 	    show_status ("Perhaps you can find a key?");
 	    return TC_DISCARD_TEXT;
 	}
 	do_photo_swap (r, SWAP_CAR);
-	remove_object (&object[O_CAR_KEY]);
-	insert_object_at (&object[O_BATT_CAR], r, 265, 122);
+	remove_object (cur->known_obj[O_CAR_KEY]);
+	insert_object_at (cur->known_obj[O_BATT_CAR], r, 265, 122);
 	player_set_flag (FLAG_CAR_OPEN);
 	show_status ("The key works, but the battery's dead.");
 	return TC_CHANGE_ROOM;
     }
 
     /* Try to use a fish. */
-    if (0 == strcasecmp ("fish", arg)) {
-	if (object[O_FISH].loc != &room[R_INVENTORY] &&
-	    object[O_FISH].loc != r) {
+    if (W_FISH == sym) {
+	if (cur->known_obj[O_FISH]->loc != cur->known_room[R_INVENTORY] &&
+	    cur->known_obj[O_FISH]->loc != r) {
 	    show_status ("Using the invisible fish...no effect!");
 	    return TC_DISCARD_TEXT;
 	}
-	if (&room[R_REM_LAB] != r) {
+	if (cur->known_room[R_REM_LAB] != r) {
 	    show_status ("I don't think that's sanitary.");
 	    return TC_DISCARD_TEXT;
 	}
-	remove_object (&object[O_FISH]);
-	move_object_to_inventory (&object[O_TUX]);
+	remove_object (cur->known_obj[O_FISH]);
+	move_object_to_inventory (cur->known_obj[O_TUX]);
 	player_set_flag (FLAG_LURED_TUX);
         show_status ("Tux likes you!");
 	return TC_REDRAW_ROOM;
@@ -1892,22 +3030,24 @@ typed_cmd_use (room_t** rptr, const char* arg)
 tc_action_t
 typed_cmd_wear (room_t** rptr, const char* arg)
 {
-    room_t* r;	/* current room */
+    room_t* r;	/* current room                */
+    int32_t sym;	/* interned name from argument */
 
-    /* Set current room. */
+    /* Set current room, and find the name typed. */
     r = *rptr;
+    sym = find_name (arg);
 
     /* Only the bunnysuit can be worn. */
-    if (0 != strcasecmp ("bunnysuit", arg)) {
+    if (W_BUNNYSUIT != sym) {
         show_status ("Big Brother forbids fashion statements.");
 	return TC_ALLOW_EDIT;
     }
-    if (object[O_BUNNYSUIT].loc != &room[R_INVENTORY] &&
-        object[O_BUNNYSUIT].loc != r) {
+    if (cur->known_obj[O_BUNNYSUIT]->loc != cur->known_room[R_INVENTORY] &&
+        cur->known_obj[O_BUNNYSUIT]->loc != r) {
         show_status ("Do you have a bunnysuit?");
 	return TC_DISCARD_TEXT;
     }
-    remove_object (&object[O_BUNNYSUIT]);
+    remove_object (cur->known_obj[O_BUNNYSUIT]);
     player_set_flag (FLAG_WEARING_SUIT);
     show_status ("You look good in pink!");
     return TC_REDRAW_ROOM;
@@ -43,19 +43,91 @@
 extern uint16_t obj_get_x (const object_t* obj);
 extern uint16_t obj_get_y (const object_t* obj);
 extern image_t* obj_image (const object_t* obj);
+extern const char* obj_name (const object_t* obj);
 extern object_t* obj_next (const object_t* obj);
 extern object_t* room_contents_iterate (const room_t* r);
+
+/* 
+ * The objects in a room as parallel arrays in drawing order: position 
+ * within the room photo, image size, and image of each.  
+ */
+typedef struct room_objs_t room_objs_t;
+struct room_objs_t {
+    int32_t         n;	    /* number of objects */
+    const uint16_t* x;
+    const uint16_t* y;
+    const uint16_t* w;
+    const uint16_t* h;
+    image_t* const* img;
+};
+extern void room_objects (const room_t* r, room_objs_t* objs);
 extern const char* room_name (const room_t* r);
+extern room_t* room_left (const room_t* r);
+extern room_t* room_enter (const room_t* r);
+extern room_t* room_right (const room_t* r);
 extern photo_t* room_photo (const room_t* r);
 extern uint32_t room_photo_height (const room_t* r);
 extern uint32_t room_photo_width (const room_t* r);
 
-/* Build the game world.  Returns 0 on failure, or 1 on success. */
-extern int32_t build_world (void);
+/* the world file compiled from world.txt by mp2world */
+#define WORLD_FILE "world.dat"
+
+/* 
+ * Build the game world from a world file, and start a session played by
+ * the calling thread.  Returns 0 on failure, or 1 on success.
+ */
+extern int32_t build_world (const char* fname);
+
+/*
+ * Game sessions share the world built by build_world (its photos, object
+ * images, and names), but each has its own rooms, objects, and flags.
+ * Each thread plays one session at a time, and the functions in this
+ * header act on the calling thread's session.  new_world_session starts
+ * a session (returning NULL if out of memory); use_world_session makes
+ * a session the calling thread's; and free_world_session ends a session
+ * that no thread is using.  Only the calling thread's session is shown
+ * on the screen, so sessions played by other threads are headless.
+ */
+extern world_session_t* new_world_session (void);
+extern void use_world_session (world_session_t* s);
+extern void free_world_session (world_session_t* s);
+
+/* 
+ * Load the photos of the rooms near the start now or in the background
+ * (background = 1).  Returns 0 on failure, or 1 on success. 
+ */
+extern int32_t load_world_photos (int32_t background);
 
 /* Get pointer to starting room for player. */
 extern room_t* start_in_room (void);
 
+/* 
+ * the part of the game's state kept by adventure.c, saved with the world
+ * (the speeds of motion follow from the inventory, so are not saved)
+ */
+typedef struct game_view_t game_view_t;
+struct game_view_t {
+    uint32_t map_x;	/* upper left display pixel      */
+    uint32_t map_y;
+};
+
+/* file to which the typed commands "save" and "restore" refer */
+#define SAVE_FILE "adventure.sav"
+
+/*
+ * Save the state of the game (with the player in room where) to a file.
+ * Returns 0 on success, or -1 on failure.
+ */
+extern int32_t save_game (const char* fname, const room_t* where,
+			  const game_view_t* view);
+
+/*
+ * Restore the state of the game from a file saved with the same world
+ * file.  Returns the player's room, or NULL on failure (in which case
+ * nothing is changed).
+ */
+extern room_t* restore_game (const char* fname, game_view_t* view);
+
 /*
  * checks for accelerator object ownership; these make horizontal (board)
  * and vertical (jetpack) pixel panning faster
@@ -0,0 +1,87 @@
+/*									tab:8
+ *
+ * world_headers.h - header file defining the binary world file format
+ *
+ * Filename:	    world_headers.h
+ * History:
+ *		1	Moved the rooms, objects, and swap photos out of
+ *			world.c into a world file compiled by mp2world.
+ */
+
+#if !defined(WORLD_HEADERS_H)
+#define WORLD_HEADERS_H
+
+
+#include <stdint.h>
+
+
+#define WORLD_MAGIC   "MP2W"	/* world file magic sequence (in header) */
+#define WORLD_VERSION 1		/* version of the format described here  */
+
+#define WORLD_NONE    (-1)	/* no room (for links and object rooms)  */
+#define WORLD_RANDOM  (-1)	/* object position chosen when placed    */
+
+/*
+ * A world file holds, in order: the header; the rooms; the objects; the
+ * swap photos; the key hash table; and the string table.  Each part
+ * follows the last without padding, and all are in the byte order of the
+ * machine that runs the game.  The file is meant to be mapped into memory
+ * and used in place, so the game reads only the parts of it that it uses.
+ *
+ * Rooms link to other rooms by index.  All names and file names are
+ * offsets into the string table, which holds NUL-terminated strings and
+ * ends with a NUL.  The objects are sorted by starting room, so that the
+ * objects that start in a room can be placed when the room is first used.
+ *
+ * Every room, object, and swap photo has a key: a distinct name by which
+ * the game finds the ones that its puzzles use.  The key hash table has a
+ * power of two number of slots.  A key is found by hashing it (below) and
+ * probing linearly from the slot given by the hash; each used slot holds
+ * an item number plus one (empty slots hold 0), where rooms are numbered
+ * from 0, followed by the objects, and then the swap photos.
+ */
+typedef struct world_header_t world_header_t;
+struct world_header_t {
+    char     magic[4];		/* WORLD_MAGIC (not NUL-terminated) */
+    uint32_t version;		/* WORLD_VERSION                    */
+    uint32_t n_rooms;		/* number of rooms                  */
+    uint32_t n_objects;		/* number of objects                */
+    uint32_t n_swaps;		/* number of swap photos            */
+    uint32_t n_slots;		/* size of the key hash table       */
+    uint32_t strings_len;	/* size of the string table         */
+    uint32_t start;		/* index of the player's first room */
+};
+
+typedef struct world_room_t world_room_t;
+struct world_room_t {
+    uint32_t key;		/* key of room                      */
+    uint32_t name;		/* name of room                     */
+    uint32_t photo;		/* file name of room photo          */
+    int32_t  left;		/* room to the "left" or WORLD_NONE */
+    int32_t  enter;		/* room reached by "enter"          */
+    int32_t  right;		/* room to the "right"              */
+    uint32_t first_obj;		/* first object starting in room    */
+    uint32_t n_objs;		/* number of objects starting there */
+};
+
+typedef struct world_object_t world_object_t;
+struct world_object_t {
+    uint32_t key;		/* key of object                    */
+    uint32_t name;		/* name typed for object            */
+    uint32_t image;		/* file name of object image        */
+    int32_t  room;		/* starting room or WORLD_NONE      */
+    int16_t  x;			/* starting x or WORLD_RANDOM       */
+    int16_t  y;			/* starting y                       */
+};
+
+typedef struct world_swap_t world_swap_t;
+struct world_swap_t {
+    uint32_t key;		/* key of swap photo                */
+    uint32_t photo;		/* file name of photo               */
+};
+
+/* hashing of keys (FNV-1a): start with WORLD_HASH_INIT, step per byte */
+#define WORLD_HASH_INIT 2166136261U
+#define WORLD_HASH_STEP(hash,c) (((hash) ^ (uint8_t)(c)) * 16777619U)
+
+#endif /* WORLD_HEADERS_H */